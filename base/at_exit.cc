@@ -10,6 +10,7 @@
 
 #include "base/bind.h"
 #include "base/callback.h"
+#include "base/location.h"
 #include "base/logging.h"
 
 namespace base {
@@ -25,7 +26,9 @@ static AtExitManager* g_top_manager = nullptr;
 static bool g_disable_managers = false;
 
 AtExitManager::AtExitManager()
-    : processing_callbacks_(false), next_manager_(g_top_manager) {
+    : lock_(FROM_HERE),
+      processing_callbacks_(false),
+      next_manager_(g_top_manager) {
 // If multiple modules instantiate AtExitManagers they'll end up living in this
 // module... they have to coexist.
 #if !defined(COMPONENT_BUILD)
@@ -101,7 +104,9 @@ void AtExitManager::DisableAllAtExitManagers() {
 }
 
 AtExitManager::AtExitManager(bool shadow)
-    : processing_callbacks_(false), next_manager_(g_top_manager) {
+    : lock_(FROM_HERE),
+      processing_callbacks_(false),
+      next_manager_(g_top_manager) {
   DCHECK(shadow || !g_top_manager);
   g_top_manager = this;
 }
@@ -216,10 +216,10 @@ BindOnce(Functor&& functor, Args&&... args) {
   PolymorphicInvoke invoke_func = &Invoker::RunOnce;
 
   using InvokeFuncStorage = internal::BindStateBase::InvokeFuncStorage;
-  return CallbackType(new BindState(
-      reinterpret_cast<InvokeFuncStorage>(invoke_func),
-      std::forward<Functor>(functor),
-      std::forward<Args>(args)...));
+  return CallbackType(internal::InPlaceBindState<BindState>(),
+                      reinterpret_cast<InvokeFuncStorage>(invoke_func),
+                      std::forward<Functor>(functor),
+                      std::forward<Args>(args)...);
 }
 
 // Bind as RepeatingCallback.
@@ -258,6 +258,7 @@ BindRepeating(Functor&& functor, Args&&... args) {
 
   using InvokeFuncStorage = internal::BindStateBase::InvokeFuncStorage;
   return CallbackType(new BindState(
+      internal::BindStateBase::Ownership::kShared,
       reinterpret_cast<InvokeFuncStorage>(invoke_func),
       std::forward<Functor>(functor),
       std::forward<Args>(args)...));
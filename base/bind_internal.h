@@ -7,6 +7,7 @@
 
 #include <stddef.h>
 
+#include <new>
 #include <type_traits>
 #include <utility>
 
@@ -756,14 +757,23 @@ struct BindState final : BindStateBase {
       CallbackCancellationTraits<Functor,
                                  std::tuple<BoundArgs...>>::is_cancellable>;
 
+  // Whether the state can be relocated, as required for
+  // BindStateBase::Ownership::kInline.
+  using IsRelocatable = std::integral_constant<
+      bool,
+      std::is_nothrow_move_constructible<Functor>::value &&
+          std::is_nothrow_move_constructible<std::tuple<BoundArgs...>>::value>;
+
   template <typename ForwardFunctor, typename... ForwardBoundArgs>
-  explicit BindState(BindStateBase::InvokeFuncStorage invoke_func,
+  explicit BindState(BindStateBase::Ownership ownership,
+                     BindStateBase::InvokeFuncStorage invoke_func,
                      ForwardFunctor&& functor,
                      ForwardBoundArgs&&... bound_args)
       // IsCancellable is std::false_type if
       // CallbackCancellationTraits<>::IsCancelled returns always false.
       // Otherwise, it's std::true_type.
       : BindState(IsCancellable{},
+                  ownership,
                   invoke_func,
                   std::forward<ForwardFunctor>(functor),
                   std::forward<ForwardBoundArgs>(bound_args)...) {}
@@ -774,11 +784,13 @@ struct BindState final : BindStateBase {
  private:
   template <typename ForwardFunctor, typename... ForwardBoundArgs>
   explicit BindState(std::true_type,
+                     BindStateBase::Ownership ownership,
                      BindStateBase::InvokeFuncStorage invoke_func,
                      ForwardFunctor&& functor,
                      ForwardBoundArgs&&... bound_args)
-      : BindStateBase(invoke_func,
-                      &Destroy,
+      : BindStateBase(ownership,
+                      invoke_func,
+                      GetManager(ownership),
                       &ApplyCancellationTraits<BindState>),
         functor_(std::forward<ForwardFunctor>(functor)),
         bound_args_(std::forward<ForwardBoundArgs>(bound_args)...) {
@@ -787,20 +799,54 @@ struct BindState final : BindStateBase {
 
   template <typename ForwardFunctor, typename... ForwardBoundArgs>
   explicit BindState(std::false_type,
+                     BindStateBase::Ownership ownership,
                      BindStateBase::InvokeFuncStorage invoke_func,
                      ForwardFunctor&& functor,
                      ForwardBoundArgs&&... bound_args)
-      : BindStateBase(invoke_func, &Destroy),
+      : BindStateBase(ownership, invoke_func, GetManager(ownership)),
         functor_(std::forward<ForwardFunctor>(functor)),
         bound_args_(std::forward<ForwardBoundArgs>(bound_args)...) {
     DCHECK(!IsNull(functor_));
   }
 
+  // Relocation, see RelocateInline().
+  BindState(BindState&& other) noexcept
+      : BindStateBase(other.ownership_,
+                      other.polymorphic_invoke_,
+                      other.manager_,
+                      other.is_cancelled_),
+        functor_(std::move(other.functor_)),
+        bound_args_(std::move(other.bound_args_)) {}
+
   ~BindState() = default;
 
-  static void Destroy(const BindStateBase* self) {
+  static ManagerFunc GetManager(BindStateBase::Ownership ownership) {
+    return ownership == BindStateBase::Ownership::kInline
+               ? GetInlineManager(IsRelocatable())
+               : &Destroy;
+  }
+
+  static ManagerFunc GetInlineManager(std::true_type) {
+    return &ManageInline;
+  }
+
+  static ManagerFunc GetInlineManager(std::false_type) {
+    NOTREACHED();
+    return nullptr;
+  }
+
+  static void Destroy(const BindStateBase* self, void* relocate_to) {
+    DCHECK(!relocate_to);
     delete static_cast<const BindState*>(self);
   }
+
+  static void ManageInline(const BindStateBase* self, void* relocate_to) {
+    BindState* state =
+        static_cast<BindState*>(const_cast<BindStateBase*>(self));
+    if (relocate_to)
+      new (relocate_to) BindState(std::move(*state));
+    state->~BindState();
+  }
 };
 
 // Used to implement MakeBindStateType.
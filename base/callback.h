@@ -10,6 +10,9 @@
 
 #include <stddef.h>
 
+#include <new>
+#include <utility>
+
 #include "base/callback_forward.h"
 #include "base/callback_internal.h"
 
@@ -45,6 +48,10 @@
 // will be a no-op. Note that |is_cancelled()| and |is_null()| are distinct:
 // simply cancelling a callback will not also make it null.
 //
+// A base::OnceCallback created by base::BindOnce() keeps a functor and bound
+// arguments of up to three pointers in size inside itself rather than on the
+// heap. Moving such a callback moves the functor and bound arguments.
+//
 // base::Callback is currently a type alias for base::RepeatingCallback. In the
 // future, we expect to flip this to default to base::OnceCallback.
 //
@@ -65,11 +72,32 @@ class OnceCallback<R(Args...)> : public internal::CallbackBase {
   explicit OnceCallback(internal::BindStateBase* bind_state)
       : internal::CallbackBase(bind_state) {}
 
+  // Constructs a |BindStateType| from |args|, inline if it fits. Used by
+  // BindOnce().
+  template <typename BindStateType, typename... BindStateArgs>
+  explicit OnceCallback(internal::InPlaceBindState<BindStateType>,
+                        BindStateArgs&&... args) {
+    EmplaceBindState<BindStateType>(
+        internal::CanStoreBindStateInline<BindStateType>(),
+        std::forward<BindStateArgs>(args)...);
+  }
+
   OnceCallback(const OnceCallback&) = delete;
   OnceCallback& operator=(const OnceCallback&) = delete;
 
-  OnceCallback(OnceCallback&&) noexcept = default;
-  OnceCallback& operator=(OnceCallback&&) noexcept = default;
+  OnceCallback(OnceCallback&& other) noexcept
+      : internal::CallbackBase(std::move(other)) {
+    RelocateInlineBindState(&other.inline_storage_, &inline_storage_);
+  }
+
+  OnceCallback& operator=(OnceCallback&& other) noexcept {
+    static_cast<internal::CallbackBase&>(*this) = std::move(other);
+    RelocateInlineBindState(&other.inline_storage_, &inline_storage_);
+    return *this;
+  }
+
+  // Destroys an inline state before |inline_storage_| goes away.
+  ~OnceCallback() { Reset(); }
 
   OnceCallback(RepeatingCallback<RunType> other)
       : internal::CallbackBase(std::move(other)) {}
@@ -96,8 +124,25 @@ class OnceCallback<R(Args...)> : public internal::CallbackBase {
     OnceCallback cb = std::move(*this);
     PolymorphicInvoke f =
         reinterpret_cast<PolymorphicInvoke>(cb.polymorphic_invoke());
-    return f(cb.bind_state_.get(), std::forward<Args>(args)...);
+    return f(cb.bind_state_, std::forward<Args>(args)...);
+  }
+
+ private:
+  template <typename BindStateType, typename... BindStateArgs>
+  void EmplaceBindState(std::true_type, BindStateArgs&&... args) {
+    bind_state_ = new (&inline_storage_)
+        BindStateType(internal::BindStateBase::Ownership::kInline,
+                      std::forward<BindStateArgs>(args)...);
   }
+
+  template <typename BindStateType, typename... BindStateArgs>
+  void EmplaceBindState(std::false_type, BindStateArgs&&... args) {
+    bind_state_ =
+        new BindStateType(internal::BindStateBase::Ownership::kUnique,
+                          std::forward<BindStateArgs>(args)...);
+  }
+
+  internal::InlineBindStateStorage inline_storage_;
 };
 
 template <typename R, typename... Args>
@@ -126,7 +171,7 @@ class RepeatingCallback<R(Args...)> : public internal::CallbackBaseCopyable {
   R Run(Args... args) const & {
     PolymorphicInvoke f =
         reinterpret_cast<PolymorphicInvoke>(this->polymorphic_invoke());
-    return f(this->bind_state_.get(), std::forward<Args>(args)...);
+    return f(this->bind_state_, std::forward<Args>(args)...);
   }
 
   R Run(Args... args) && {
@@ -137,7 +182,7 @@ class RepeatingCallback<R(Args...)> : public internal::CallbackBaseCopyable {
     RepeatingCallback cb = std::move(*this);
     PolymorphicInvoke f =
         reinterpret_cast<PolymorphicInvoke>(cb.polymorphic_invoke());
-    return f(cb.bind_state_.get(), std::forward<Args>(args)...);
+    return f(cb.bind_state_, std::forward<Args>(args)...);
   }
 };
 
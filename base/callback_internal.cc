@@ -17,43 +17,75 @@ bool ReturnFalse(const BindStateBase*) {
 
 }  // namespace
 
-void BindStateBaseRefCountTraits::Destruct(const BindStateBase* bind_state) {
-  bind_state->destructor_(bind_state);
+BindStateBase::BindStateBase(Ownership ownership,
+                             InvokeFuncStorage polymorphic_invoke,
+                             ManagerFunc manager)
+    : BindStateBase(ownership, polymorphic_invoke, manager, &ReturnFalse) {}
+
+BindStateBase::BindStateBase(Ownership ownership,
+                             InvokeFuncStorage polymorphic_invoke,
+                             ManagerFunc manager,
+                             bool (*is_cancelled)(const BindStateBase*))
+    : ownership_(ownership),
+      polymorphic_invoke_(polymorphic_invoke),
+      manager_(manager),
+      is_cancelled_(is_cancelled) {}
+
+void BindStateBase::AddRef() const {
+  DCHECK(ownership_ == Ownership::kShared);
+  ref_count_.Increment();
 }
 
-BindStateBase::BindStateBase(InvokeFuncStorage polymorphic_invoke,
-                             void (*destructor)(const BindStateBase*))
-    : BindStateBase(polymorphic_invoke, destructor, &ReturnFalse) {
+void BindStateBase::Release() const {
+  // Unique and inline states have a single owner, which is releasing them:
+  // skip the atomic decrement.
+  if (ownership_ != Ownership::kShared || !ref_count_.Decrement())
+    manager_(this, nullptr);
 }
 
-BindStateBase::BindStateBase(InvokeFuncStorage polymorphic_invoke,
-                             void (*destructor)(const BindStateBase*),
-                             bool (*is_cancelled)(const BindStateBase*))
-    : polymorphic_invoke_(polymorphic_invoke),
-      destructor_(destructor),
-      is_cancelled_(is_cancelled) {}
+CallbackBase& CallbackBase::operator=(CallbackBase&& c) noexcept {
+  if (this == &c)
+    return *this;
+  BindStateBase* previous_bind_state = bind_state_;
+  bind_state_ = c.bind_state_;
+  c.bind_state_ = nullptr;
+  if (previous_bind_state)
+    previous_bind_state->Release();
+  return *this;
+}
 
-CallbackBase& CallbackBase::operator=(CallbackBase&& c) noexcept = default;
 CallbackBase::CallbackBase(const CallbackBaseCopyable& c)
-    : bind_state_(c.bind_state_) {}
+    : bind_state_(c.bind_state_) {
+  if (bind_state_)
+    bind_state_->AddRef();
+}
 
 CallbackBase& CallbackBase::operator=(const CallbackBaseCopyable& c) {
+  if (c.bind_state_)
+    c.bind_state_->AddRef();
+  BindStateBase* previous_bind_state = bind_state_;
   bind_state_ = c.bind_state_;
+  if (previous_bind_state)
+    previous_bind_state->Release();
   return *this;
 }
 
 CallbackBase::CallbackBase(CallbackBaseCopyable&& c) noexcept
-    : bind_state_(std::move(c.bind_state_)) {}
+    : bind_state_(c.bind_state_) {
+  c.bind_state_ = nullptr;
+}
 
 CallbackBase& CallbackBase::operator=(CallbackBaseCopyable&& c) noexcept {
-  bind_state_ = std::move(c.bind_state_);
-  return *this;
+  return *this = static_cast<CallbackBase&&>(c);
 }
 
 void CallbackBase::Reset() {
-  // NULL the bind_state_ last, since it may be holding the last ref to whatever
-  // object owns us, and we may be deleted after that.
+  // NULL the bind_state_ first, since it may be holding the last ref to
+  // whatever object owns us, and we may be deleted after that.
+  BindStateBase* bind_state = bind_state_;
   bind_state_ = nullptr;
+  if (bind_state)
+    bind_state->Release();
 }
 
 bool CallbackBase::IsCancelled() const {
@@ -65,20 +97,38 @@ bool CallbackBase::EqualsInternal(const CallbackBase& other) const {
   return bind_state_ == other.bind_state_;
 }
 
-CallbackBase::~CallbackBase() = default;
+void CallbackBase::RelocateInlineBindState(InlineBindStateStorage* from,
+                                           InlineBindStateStorage* to) {
+  char* const bind_state = reinterpret_cast<char*>(bind_state_);
+  if (from == to || bind_state < from->bytes ||
+      bind_state >= from->bytes + sizeof(from->bytes)) {
+    return;
+  }
+  DCHECK(bind_state_->ownership_ == BindStateBase::Ownership::kInline);
+  bind_state_->manager_(bind_state_, to);
+  bind_state_ =
+      reinterpret_cast<BindStateBase*>(to->bytes + (bind_state - from->bytes));
+}
 
-CallbackBaseCopyable::CallbackBaseCopyable(const CallbackBaseCopyable& c) {
-  bind_state_ = c.bind_state_;
+CallbackBase::~CallbackBase() {
+  if (bind_state_)
+    bind_state_->Release();
 }
 
+CallbackBaseCopyable::CallbackBaseCopyable(const CallbackBaseCopyable& c)
+    : CallbackBase(c) {}
+
 CallbackBaseCopyable& CallbackBaseCopyable::operator=(
     const CallbackBaseCopyable& c) {
-  bind_state_ = c.bind_state_;
+  CallbackBase::operator=(c);
   return *this;
 }
 
 CallbackBaseCopyable& CallbackBaseCopyable::operator=(
-    CallbackBaseCopyable&& c) noexcept = default;
+    CallbackBaseCopyable&& c) noexcept {
+  CallbackBase::operator=(static_cast<CallbackBase&&>(c));
+  return *this;
+}
 
 }  // namespace internal
 }  // namespace base
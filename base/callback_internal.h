@@ -8,10 +8,15 @@
 #ifndef BASE_CALLBACK_INTERNAL_H_
 #define BASE_CALLBACK_INTERNAL_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <type_traits>
+
+#include "base/atomic_ref_count.h"
 #include "base/base_export.h"
 #include "base/callback_forward.h"
 #include "base/macros.h"
-#include "base/memory/ref_counted.h"
 
 namespace base {
 
@@ -27,10 +32,6 @@ class BindStateBase;
 template <typename Functor, typename... BoundArgs>
 struct BindState;
 
-struct BindStateBaseRefCountTraits {
-  static void Destruct(const BindStateBase*);
-};
-
 template <typename T>
 using PassingType = std::conditional_t<std::is_scalar<T>::value, T, T&&>;
 
@@ -40,30 +41,44 @@ using PassingType = std::conditional_t<std::is_scalar<T>::value, T, T&&>;
 // DoInvoke function to perform the function execution.  This allows
 // us to shield the Callback class from the types of the bound argument via
 // "type erasure."
-// At the base level, the only task is to add reference counting data. Don't use
-// RefCountedThreadSafe since it requires the destructor to be a virtual method.
-// Creating a vtable for every BindState template instantiation results in a lot
-// of bloat. Its only task is to call the destructor which can be done with a
-// function pointer.
-class BASE_EXPORT BindStateBase
-    : public RefCountedThreadSafe<BindStateBase, BindStateBaseRefCountTraits> {
+// At the base level, the only task is to manage the lifetime of the state.
+// Don't use RefCountedThreadSafe since it requires the destructor to be a
+// virtual method. Creating a vtable for every BindState template instantiation
+// results in a lot of bloat. Its only task is to call the destructor which can
+// be done with a function pointer.
+class BASE_EXPORT BindStateBase {
  public:
-  REQUIRE_ADOPTION_FOR_REFCOUNTED_TYPE();
-
   using InvokeFuncStorage = void(*)();
 
+  // How the lifetime of a BindState is managed.
+  enum class Ownership : uint8_t {
+    // On the heap and reference counted: RepeatingCallbacks, and the
+    // OnceCallbacks converted from them, share their state, possibly across
+    // threads.
+    kShared,
+    // On the heap and owned by a single OnceCallback, hence never reference
+    // counted.
+    kUnique,
+    // In the InlineBindStateStorage of a single OnceCallback, which relocates
+    // it when moved.
+    kInline,
+  };
+
  private:
-  BindStateBase(InvokeFuncStorage polymorphic_invoke,
-                void (*destructor)(const BindStateBase*));
-  BindStateBase(InvokeFuncStorage polymorphic_invoke,
-                void (*destructor)(const BindStateBase*),
+  // Destroys |self| if |relocate_to| is null. Otherwise moves |self| to
+  // |relocate_to|, which only Ownership::kInline states support.
+  using ManagerFunc = void (*)(const BindStateBase* self, void* relocate_to);
+
+  BindStateBase(Ownership ownership,
+                InvokeFuncStorage polymorphic_invoke,
+                ManagerFunc manager);
+  BindStateBase(Ownership ownership,
+                InvokeFuncStorage polymorphic_invoke,
+                ManagerFunc manager,
                 bool (*is_cancelled)(const BindStateBase*));
 
   ~BindStateBase() = default;
 
-  friend struct BindStateBaseRefCountTraits;
-  friend class RefCountedThreadSafe<BindStateBase, BindStateBaseRefCountTraits>;
-
   friend class CallbackBase;
   friend class CallbackBaseCopyable;
 
@@ -72,23 +87,54 @@ class BASE_EXPORT BindStateBase
   friend struct BindState;
   friend struct ::base::FakeBindState;
 
+  // Only Ownership::kShared states may get more than one reference.
+  void AddRef() const;
+
+  // Destroys the state unless it is shared and other references remain.
+  void Release() const;
+
   bool IsCancelled() const {
     return is_cancelled_(this);
   }
 
+  mutable AtomicRefCount ref_count_{1};
+
+  const Ownership ownership_;
+
   // In C++, it is safe to cast function pointers to function pointers of
   // another type. It is not okay to use void*. We create a InvokeFuncStorage
   // that that can store our function pointer, and then cast it back to
   // the original type on usage.
   InvokeFuncStorage polymorphic_invoke_;
 
-  // Pointer to a function that will properly destroy |this|.
-  void (*destructor_)(const BindStateBase*);
+  // Pointer to a function that will properly destroy or relocate |this|.
+  ManagerFunc manager_;
   bool (*is_cancelled_)(const BindStateBase*);
 
   DISALLOW_COPY_AND_ASSIGN(BindStateBase);
 };
 
+// Storage inside a OnceCallback for a BindState of up to three pointers worth
+// of functor and bound arguments, which then isn't allocated on the heap.
+struct InlineBindStateStorage {
+  alignas(void*) char bytes[sizeof(BindStateBase) + 3 * sizeof(void*)];
+};
+
+// Whether a OnceCallback stores a |BindStateType| in its
+// InlineBindStateStorage. The state must be cheap to relocate without
+// throwing.
+template <typename BindStateType>
+using CanStoreBindStateInline = std::integral_constant<
+    bool,
+    sizeof(BindStateType) <= sizeof(InlineBindStateStorage) &&
+        alignof(BindStateType) <= alignof(InlineBindStateStorage) &&
+        BindStateType::IsRelocatable::value>;
+
+// Tag for OnceCallback's constructor which constructs a |BindStateType| in
+// place.
+template <typename BindStateType>
+struct InPlaceBindState {};
+
 // Holds the Callback methods that don't require specialization to reduce
 // template bloat.
 // CallbackBase<MoveOnly> is a direct base class of MoveOnly callbacks, and
@@ -123,26 +169,35 @@ class BASE_EXPORT CallbackBase {
 
   constexpr inline CallbackBase();
 
-  // Allow initializing of |bind_state_| via the constructor to avoid default
-  // initialization of the scoped_refptr.
+  // Takes over the reference |bind_state| starts out with.
   explicit inline CallbackBase(BindStateBase* bind_state);
 
   InvokeFuncStorage polymorphic_invoke() const {
     return bind_state_->polymorphic_invoke_;
   }
 
+  // Called by OnceCallback after |this| was moved from a callback whose
+  // InlineBindStateStorage is |from|: moves the state to |to| if it was in
+  // |from|.
+  void RelocateInlineBindState(InlineBindStateStorage* from,
+                               InlineBindStateStorage* to);
+
   // Force the destructor to be instantiated inside this translation unit so
   // that our subclasses will not get inlined versions.  Avoids more template
   // bloat.
   ~CallbackBase();
 
-  scoped_refptr<BindStateBase> bind_state_;
+  // Owns one reference to a shared state, or owns a unique or inline state.
+  BindStateBase* bind_state_ = nullptr;
 };
 
 constexpr CallbackBase::CallbackBase() = default;
-CallbackBase::CallbackBase(CallbackBase&&) noexcept = default;
+CallbackBase::CallbackBase(CallbackBase&& c) noexcept
+    : bind_state_(c.bind_state_) {
+  c.bind_state_ = nullptr;
+}
 CallbackBase::CallbackBase(BindStateBase* bind_state)
-    : bind_state_(AdoptRef(bind_state)) {}
+    : bind_state_(bind_state) {}
 
 // CallbackBase<Copyable> is a direct base class of Copyable Callbacks.
 class BASE_EXPORT CallbackBaseCopyable : public CallbackBase {
@@ -0,0 +1,126 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/lock_contention_stats.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "base/format_macros.h"
+#include "base/hash.h"
+#include "base/strings/stringprintf.h"
+
+namespace base {
+namespace debug {
+
+LockSiteStats::LockSiteStats(const Location& location) : location_(location) {}
+
+LockSiteStats::~LockSiteStats() = default;
+
+LockContentionStats::SiteSnapshot::SiteSnapshot() = default;
+
+LockContentionStats::SiteSnapshot::SiteSnapshot(const SiteSnapshot& other) =
+    default;
+
+LockContentionStats::SiteSnapshot& LockContentionStats::SiteSnapshot::
+operator=(const SiteSnapshot& other) = default;
+
+LockContentionStats::SiteSnapshot::~SiteSnapshot() = default;
+
+// static
+LockContentionStats* LockContentionStats::GetInstance() {
+  static NoDestructor<LockContentionStats> instance;
+  return instance.get();
+}
+
+LockSiteStats* LockContentionStats::GetSite(const Location& location) {
+  const void* program_counter = location.program_counter();
+  const size_t start =
+      Hash(&program_counter, sizeof(program_counter)) % kMaxSites;
+
+  // Linear probing, as in TaskLatencyStats::GetPostSite().
+  for (size_t i = 0; i < kMaxSites; ++i) {
+    std::atomic<LockSiteStats*>& slot = sites_[(start + i) % kMaxSites];
+    LockSiteStats* site = slot.load(std::memory_order_acquire);
+    if (!site) {
+      std::unique_ptr<LockSiteStats> new_site =
+          std::make_unique<LockSiteStats>(location);
+      if (slot.compare_exchange_strong(site, new_site.get(),
+                                       std::memory_order_acq_rel,
+                                       std::memory_order_acquire)) {
+        return new_site.release();
+      }
+      // Another thread claimed the slot, possibly for the same site.
+    }
+    if (site->location().program_counter() == program_counter)
+      return site;
+  }
+  return &overflow_site_;
+}
+
+std::vector<LockContentionStats::SiteSnapshot>
+LockContentionStats::GetMostContended(size_t max_sites) const {
+  std::vector<SiteSnapshot> snapshots;
+  auto add_snapshot = [&snapshots](const LockSiteStats& site) {
+    SiteSnapshot snapshot;
+    snapshot.location = site.location();
+    snapshot.wait_time = site.GetSnapshot();
+    if (snapshot.wait_time.count)
+      snapshots.push_back(snapshot);
+  };
+
+  for (const std::atomic<LockSiteStats*>& slot : sites_) {
+    const LockSiteStats* site = slot.load(std::memory_order_acquire);
+    if (site)
+      add_snapshot(*site);
+  }
+  add_snapshot(overflow_site_);
+
+  // Ties, e.g. of sites with few contentions, go to the longest waits.
+  auto more_contended = [](const SiteSnapshot& a, const SiteSnapshot& b) {
+    if (a.wait_time.count != b.wait_time.count)
+      return a.wait_time.count > b.wait_time.count;
+    return a.wait_time.sum_us > b.wait_time.sum_us;
+  };
+  if (snapshots.size() > max_sites) {
+    std::partial_sort(snapshots.begin(), snapshots.begin() + max_sites,
+                      snapshots.end(), more_contended);
+    snapshots.resize(max_sites);
+  } else {
+    std::sort(snapshots.begin(), snapshots.end(), more_contended);
+  }
+  return snapshots;
+}
+
+std::string LockContentionStats::DumpMostContended(size_t max_sites) const {
+  std::string dump;
+  for (const SiteSnapshot& site : GetMostContended(max_sites)) {
+    const TaskLatencyHistogram::Snapshot& wait_time = site.wait_time;
+    StringAppendF(&dump,
+                  "%s: %" PRIu64 " contended, waited %" PRIu64
+                  " us in total, p50 %" PRId64 " us, p99 %" PRId64
+                  " us, max %" PRId64 " us\n",
+                  site.location.ToString().c_str(), wait_time.count,
+                  wait_time.sum_us, wait_time.ValueAtPercentile(50),
+                  wait_time.ValueAtPercentile(99), wait_time.max_us);
+  }
+  return dump;
+}
+
+void LockContentionStats::Reset() {
+  for (std::atomic<LockSiteStats*>& slot : sites_) {
+    LockSiteStats* site = slot.load(std::memory_order_acquire);
+    if (site)
+      site->Reset();
+  }
+  overflow_site_.Reset();
+}
+
+LockContentionStats::LockContentionStats() : overflow_site_(Location()) {}
+
+// Never called: the instance is leaked, and so are the LockSiteStats.
+LockContentionStats::~LockContentionStats() = default;
+
+}  // namespace debug
+}  // namespace base
@@ -0,0 +1,105 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_DEBUG_LOCK_CONTENTION_STATS_H_
+#define BASE_DEBUG_LOCK_CONTENTION_STATS_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/debug/task_latency_stats.h"
+#include "base/location.h"
+#include "base/macros.h"
+#include "base/no_destructor.h"
+#include "base/time/time.h"
+
+namespace base {
+namespace debug {
+
+// How often and how long threads waited for the locks constructed at one
+// Location, e.g. all the |incoming_queue_lock_|s of MessageLoops. Only
+// updated by threads which had to wait, so uncontended locks cost nothing.
+class BASE_EXPORT LockSiteStats {
+ public:
+  explicit LockSiteStats(const Location& location);
+  ~LockSiteStats();
+
+  const Location& location() const { return location_; }
+
+  // Records that a thread waited |wait| for a lock, spinning or sleeping.
+  void RecordContention(TimeDelta wait) { wait_time_.Add(wait); }
+
+  // The count of the histogram is the number of contended acquisitions.
+  TaskLatencyHistogram::Snapshot GetSnapshot() const {
+    return wait_time_.GetSnapshot();
+  }
+  void Reset() { wait_time_.Reset(); }
+
+ private:
+  const Location location_;
+  TaskLatencyHistogram wait_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(LockSiteStats);
+};
+
+// Process-wide registry of the LockSiteStats of the locks constructed with a
+// Location (see Lock::Lock(const Location&)), to find the locks worth
+// splitting or shortening.
+//
+// Sites are keyed by program counter, like Location::operator==. Once
+// kMaxSites sites are known, the others are aggregated under a default
+// constructed Location.
+class BASE_EXPORT LockContentionStats {
+ public:
+  static constexpr size_t kMaxSites = 1024;
+
+  struct BASE_EXPORT SiteSnapshot {
+    SiteSnapshot();
+    SiteSnapshot(const SiteSnapshot& other);
+    SiteSnapshot& operator=(const SiteSnapshot& other);
+    ~SiteSnapshot();
+
+    Location location;
+    TaskLatencyHistogram::Snapshot wait_time;
+  };
+
+  static LockContentionStats* GetInstance();
+
+  // Returns the stats of the locks constructed at |location|, creating them
+  // if needed. The returned pointer is valid forever.
+  LockSiteStats* GetSite(const Location& location);
+
+  // Returns the |max_sites| sites with the most contended acquisitions, most
+  // contended first. Sites without contention are left out.
+  std::vector<SiteSnapshot> GetMostContended(size_t max_sites) const;
+
+  // Returns GetMostContended() as text, one site per line, for logs.
+  std::string DumpMostContended(size_t max_sites) const;
+
+  // Clears all samples. Sites stay known.
+  void Reset();
+
+ private:
+  friend class NoDestructor<LockContentionStats>;
+
+  LockContentionStats();
+  ~LockContentionStats();
+
+  // Open-addressed by program counter. Entries are never removed.
+  std::atomic<LockSiteStats*> sites_[kMaxSites] = {};
+
+  // Catches sites which don't fit in |sites_|.
+  LockSiteStats overflow_site_;
+
+  DISALLOW_COPY_AND_ASSIGN(LockContentionStats);
+};
+
+}  // namespace debug
+}  // namespace base
+
+#endif  // BASE_DEBUG_LOCK_CONTENTION_STATS_H_
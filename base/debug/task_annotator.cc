@@ -8,6 +8,7 @@
 
 //#include "base/debug/activity_tracker.h"
 #include "base/debug/alias.h"
+#include "base/debug/task_latency_stats.h"
 #include "base/no_destructor.h"
 #include "base/pending_task.h"
 #include "base/threading/thread_local.h"
@@ -36,6 +37,8 @@ TaskAnnotator::~TaskAnnotator() = default;
 
 void TaskAnnotator::WillQueueTask(const char* queue_function,
                                   PendingTask* pending_task) {
+  if (TaskLatencyStats::IsEnabled() && pending_task->queue_time.is_null())
+    pending_task->queue_time = TimeTicks::Now();
 
   // TODO(https://crbug.com/826902): Fix callers that invoke WillQueueTask()
   // twice for the same PendingTask.
@@ -85,7 +88,14 @@ void TaskAnnotator::RunTask(const char* queue_function,
 
   if (g_task_annotator_observer)
     g_task_annotator_observer->BeforeRunTask(pending_task);
-  std::move(pending_task->task).Run();
+  if (TaskLatencyStats::IsEnabled()) {
+    const TimeTicks start = TimeTicks::Now();
+    std::move(pending_task->task).Run();
+    TaskLatencyStats::GetInstance()->RecordTask(*pending_task, start,
+                                                TimeTicks::Now());
+  } else {
+    std::move(pending_task->task).Run();
+  }
 
   tls_for_current_pending_task->Set(previous_pending_task);
 }
@@ -37,7 +37,8 @@ class BASE_EXPORT TaskAnnotator {
   void WillQueueTask(const char* queue_function, PendingTask* pending_task);
 
   // Run a previously queued task. |queue_function| should match what was
-  // passed into |DidQueueTask| for this task.
+  // passed into |DidQueueTask| for this task. Records the task's queueing delay
+  // and run duration in TaskLatencyStats if enabled.
   void RunTask(const char* queue_function, PendingTask* pending_task);
 
   // Creates a process-wide unique ID to represent this task in trace events.
@@ -0,0 +1,215 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/task_latency_stats.h"
+
+#include <algorithm>
+
+#include "base/bits.h"
+#include "base/hash.h"
+#include "base/logging.h"
+#include "base/pending_task.h"
+
+namespace base {
+namespace debug {
+
+TaskLatencyHistogram::Snapshot::Snapshot() = default;
+
+TaskLatencyHistogram::Snapshot::Snapshot(const Snapshot& other) = default;
+
+TaskLatencyHistogram::Snapshot& TaskLatencyHistogram::Snapshot::operator=(
+    const Snapshot& other) = default;
+
+TaskLatencyHistogram::Snapshot::~Snapshot() = default;
+
+int64_t TaskLatencyHistogram::Snapshot::ValueAtPercentile(
+    double percentile) const {
+  if (!count)
+    return 0;
+  DCHECK_GE(percentile, 0.0);
+  DCHECK_LE(percentile, 100.0);
+
+  // The rank of the sample at |percentile|, 1-based.
+  const uint64_t rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(percentile / 100.0 * count + 0.5));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    seen += counts[i];
+    if (seen >= rank)
+      return std::min(BucketMin(i), max_us);
+  }
+  // Buckets and |count| raced with a concurrent Add().
+  return max_us;
+}
+
+TaskLatencyHistogram::TaskLatencyHistogram() = default;
+
+TaskLatencyHistogram::~TaskLatencyHistogram() = default;
+
+void TaskLatencyHistogram::Add(TimeDelta sample) {
+  const int64_t sample_us = std::max<int64_t>(0, sample.InMicroseconds());
+  counts_[BucketIndex(sample_us)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_us_.fetch_add(sample_us, std::memory_order_relaxed);
+
+  int64_t max_us = max_us_.load(std::memory_order_relaxed);
+  while (sample_us > max_us &&
+         !max_us_.compare_exchange_weak(max_us, sample_us,
+                                        std::memory_order_relaxed)) {
+  }
+}
+
+TaskLatencyHistogram::Snapshot TaskLatencyHistogram::GetSnapshot() const {
+  Snapshot snapshot;
+  for (size_t i = 0; i < kNumBuckets; ++i)
+    snapshot.counts[i] = counts_[i].load(std::memory_order_relaxed);
+  snapshot.count = count_.load(std::memory_order_relaxed);
+  snapshot.sum_us = sum_us_.load(std::memory_order_relaxed);
+  snapshot.max_us = max_us_.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+void TaskLatencyHistogram::Reset() {
+  for (std::atomic<uint32_t>& count : counts_)
+    count.store(0, std::memory_order_relaxed);
+  count_.store(0, std::memory_order_relaxed);
+  sum_us_.store(0, std::memory_order_relaxed);
+  max_us_.store(0, std::memory_order_relaxed);
+}
+
+// static
+size_t TaskLatencyHistogram::BucketIndex(int64_t sample_us) {
+  DCHECK_GE(sample_us, 0);
+  if (sample_us < kSubBuckets)
+    return static_cast<size_t>(sample_us);
+  if (sample_us >= (int64_t{1} << kMaxBits))
+    return kNumBuckets - 1;
+
+  // Samples in [2^exponent, 2^(exponent + 1)) are spread over kSubBuckets
+  // buckets, indexed by the kSubBucketBits bits following the leading one.
+  const int exponent =
+      63 - bits::CountLeadingZeroBits(static_cast<uint64_t>(sample_us));
+  const int shift = exponent - kSubBucketBits;
+  const size_t sub_bucket = (sample_us >> shift) & (kSubBuckets - 1);
+  return (shift + 1) * kSubBuckets + sub_bucket;
+}
+
+// static
+int64_t TaskLatencyHistogram::BucketMin(size_t index) {
+  DCHECK_LT(index, kNumBuckets);
+  if (index < kSubBuckets)
+    return static_cast<int64_t>(index);
+  const int shift = static_cast<int>(index / kSubBuckets) - 1;
+  const int64_t sub_bucket = index % kSubBuckets;
+  return (kSubBuckets + sub_bucket) << shift;
+}
+
+TaskLatencyStats::PostSiteSnapshot::PostSiteSnapshot() = default;
+
+TaskLatencyStats::PostSiteSnapshot::PostSiteSnapshot(
+    const PostSiteSnapshot& other) = default;
+
+TaskLatencyStats::PostSiteSnapshot& TaskLatencyStats::PostSiteSnapshot::
+operator=(const PostSiteSnapshot& other) = default;
+
+TaskLatencyStats::PostSiteSnapshot::~PostSiteSnapshot() = default;
+
+TaskLatencyStats::PostSite::PostSite(const Location& posted_from)
+    : posted_from(posted_from) {}
+
+TaskLatencyStats::PostSite::~PostSite() = default;
+
+// static
+std::atomic<bool> TaskLatencyStats::enabled_{false};
+
+// static
+TaskLatencyStats* TaskLatencyStats::GetInstance() {
+  static NoDestructor<TaskLatencyStats> instance;
+  return instance.get();
+}
+
+// static
+void TaskLatencyStats::SetEnabled(bool enabled) {
+  enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+void TaskLatencyStats::RecordTask(const PendingTask& pending_task,
+                                  TimeTicks start,
+                                  TimeTicks end) {
+  PostSite* site = GetPostSite(pending_task.posted_from);
+  if (!pending_task.queue_time.is_null()) {
+    const TimeTicks runnable_time =
+        std::max(pending_task.queue_time, pending_task.delayed_run_time);
+    site->queueing_delay.Add(start - runnable_time);
+  }
+  site->run_duration.Add(end - start);
+}
+
+std::vector<TaskLatencyStats::PostSiteSnapshot> TaskLatencyStats::GetSnapshot()
+    const {
+  std::vector<PostSiteSnapshot> snapshots;
+  auto add_snapshot = [&snapshots](const PostSite& site) {
+    PostSiteSnapshot snapshot;
+    snapshot.posted_from = site.posted_from;
+    snapshot.queueing_delay = site.queueing_delay.GetSnapshot();
+    snapshot.run_duration = site.run_duration.GetSnapshot();
+    if (snapshot.run_duration.count)
+      snapshots.push_back(snapshot);
+  };
+
+  for (const std::atomic<PostSite*>& slot : sites_) {
+    const PostSite* site = slot.load(std::memory_order_acquire);
+    if (site)
+      add_snapshot(*site);
+  }
+  add_snapshot(overflow_site_);
+  return snapshots;
+}
+
+void TaskLatencyStats::Reset() {
+  for (std::atomic<PostSite*>& slot : sites_) {
+    PostSite* site = slot.load(std::memory_order_acquire);
+    if (site) {
+      site->queueing_delay.Reset();
+      site->run_duration.Reset();
+    }
+  }
+  overflow_site_.queueing_delay.Reset();
+  overflow_site_.run_duration.Reset();
+}
+
+TaskLatencyStats::TaskLatencyStats() : overflow_site_(Location()) {}
+
+// Never called: the instance is leaked, and so are the PostSites.
+TaskLatencyStats::~TaskLatencyStats() = default;
+
+TaskLatencyStats::PostSite* TaskLatencyStats::GetPostSite(
+    const Location& posted_from) {
+  const void* program_counter = posted_from.program_counter();
+  const size_t start =
+      Hash(&program_counter, sizeof(program_counter)) % kMaxPostSites;
+
+  // Linear probing. A slot, once set, never changes, so the lookup of a known
+  // site is wait-free.
+  for (size_t i = 0; i < kMaxPostSites; ++i) {
+    std::atomic<PostSite*>& slot = sites_[(start + i) % kMaxPostSites];
+    PostSite* site = slot.load(std::memory_order_acquire);
+    if (!site) {
+      std::unique_ptr<PostSite> new_site =
+          std::make_unique<PostSite>(posted_from);
+      if (slot.compare_exchange_strong(site, new_site.get(),
+                                       std::memory_order_acq_rel,
+                                       std::memory_order_acquire)) {
+        return new_site.release();
+      }
+      // Another thread claimed the slot, possibly for the same site.
+    }
+    if (site->posted_from.program_counter() == program_counter)
+      return site;
+  }
+  return &overflow_site_;
+}
+
+}  // namespace debug
+}  // namespace base
@@ -0,0 +1,157 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_DEBUG_TASK_LATENCY_STATS_H_
+#define BASE_DEBUG_TASK_LATENCY_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/location.h"
+#include "base/macros.h"
+#include "base/no_destructor.h"
+#include "base/time/time.h"
+
+namespace base {
+struct PendingTask;
+namespace debug {
+
+// A histogram of durations in microseconds with log-linear buckets: each power
+// of two range is split in kSubBuckets buckets, bounding the relative error of
+// a sample to 1 / kSubBuckets. Add() is lock-free and may race with other
+// Add() calls and with snapshots; a snapshot taken concurrently with Add() may
+// miss or partially reflect it.
+class BASE_EXPORT TaskLatencyHistogram {
+ public:
+  static constexpr int kSubBucketBits = 3;
+  static constexpr int kSubBuckets = 1 << kSubBucketBits;
+  // Samples of 2^kMaxBits us (~12 days) or more land in the last bucket.
+  static constexpr int kMaxBits = 40;
+  static constexpr size_t kNumBuckets =
+      (kMaxBits - kSubBucketBits + 1) * kSubBuckets;
+
+  struct BASE_EXPORT Snapshot {
+    Snapshot();
+    Snapshot(const Snapshot& other);
+    Snapshot& operator=(const Snapshot& other);
+    ~Snapshot();
+
+    // Returns the lower bound in microseconds of the value at |percentile|
+    // (in [0, 100]), or 0 if there are no samples.
+    int64_t ValueAtPercentile(double percentile) const;
+
+    std::array<uint32_t, kNumBuckets> counts = {};
+    uint64_t count = 0;
+    uint64_t sum_us = 0;
+    int64_t max_us = 0;
+  };
+
+  TaskLatencyHistogram();
+  ~TaskLatencyHistogram();
+
+  void Add(TimeDelta sample);
+  Snapshot GetSnapshot() const;
+  void Reset();
+
+  // Returns the index of the bucket holding |sample_us| and the smallest value
+  // held by bucket |index|.
+  static size_t BucketIndex(int64_t sample_us);
+  static int64_t BucketMin(size_t index);
+
+ private:
+  std::atomic<uint32_t> counts_[kNumBuckets] = {};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_us_{0};
+  std::atomic<int64_t> max_us_{0};
+
+  DISALLOW_COPY_AND_ASSIGN(TaskLatencyHistogram);
+};
+
+// Process-wide per post site (posting Location) histograms of the delay
+// between when a task could have run and when it started running (its queueing
+// delay), and of how long it ran. Recorded by TaskAnnotator::RunTask() while
+// enabled, i.e. for tasks of MessageLoops and WorkStealingThreadPools.
+//
+// The queueing delay of a delayed task is counted from its delayed run time,
+// so that it measures lateness rather than the requested delay. Tasks queued
+// while recording was disabled only contribute to the run duration.
+//
+// Sites are keyed by program counter, like Location::operator==. Once
+// kMaxPostSites sites are known, the others are aggregated under a default
+// constructed Location.
+class BASE_EXPORT TaskLatencyStats {
+ public:
+  static constexpr size_t kMaxPostSites = 1024;
+
+  struct BASE_EXPORT PostSiteSnapshot {
+    PostSiteSnapshot();
+    PostSiteSnapshot(const PostSiteSnapshot& other);
+    PostSiteSnapshot& operator=(const PostSiteSnapshot& other);
+    ~PostSiteSnapshot();
+
+    Location posted_from;
+    TaskLatencyHistogram::Snapshot queueing_delay;
+    TaskLatencyHistogram::Snapshot run_duration;
+  };
+
+  static TaskLatencyStats* GetInstance();
+
+  // Recording is disabled by default. It costs two TimeTicks::Now() calls and
+  // a few relaxed atomic increments per task.
+  static void SetEnabled(bool enabled);
+  static bool IsEnabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  // Records that |pending_task| ran from |start| to |end|.
+  void RecordTask(const PendingTask& pending_task,
+                  TimeTicks start,
+                  TimeTicks end);
+
+  // Returns the histograms of all post sites with samples, in no particular
+  // order.
+  std::vector<PostSiteSnapshot> GetSnapshot() const;
+
+  // Clears all samples. Post sites stay known.
+  void Reset();
+
+ private:
+  friend class NoDestructor<TaskLatencyStats>;
+
+  struct PostSite {
+    explicit PostSite(const Location& posted_from);
+    ~PostSite();
+
+    const Location posted_from;
+    TaskLatencyHistogram queueing_delay;
+    TaskLatencyHistogram run_duration;
+  };
+
+  TaskLatencyStats();
+  ~TaskLatencyStats();
+
+  // Returns the PostSite of |posted_from|, creating it if needed.
+  PostSite* GetPostSite(const Location& posted_from);
+
+  static std::atomic<bool> enabled_;
+
+  // Open-addressed by program counter. Entries are never removed.
+  std::atomic<PostSite*> sites_[kMaxPostSites] = {};
+
+  // Catches post sites which don't fit in |sites_|.
+  PostSite overflow_site_;
+
+  DISALLOW_COPY_AND_ASSIGN(TaskLatencyStats);
+};
+
+}  // namespace debug
+}  // namespace base
+
+#endif  // BASE_DEBUG_TASK_LATENCY_STATS_H_
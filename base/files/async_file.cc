@@ -0,0 +1,124 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/async_file.h"
+
+#include <limits>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/files/async_file_backend.h"
+#include "base/logging.h"
+#include "base/threading/sequenced_task_runner_handle.h"
+
+namespace base {
+
+namespace {
+
+void RunStatusCallback(AsyncFile::StatusCallback callback,
+                       File::Error error,
+                       int bytes) {
+  std::move(callback).Run(error);
+}
+
+}  // namespace
+
+AsyncFileBuffer::AsyncFileBuffer(size_t size)
+    : data_(new char[size]), size_(size) {}
+
+// static
+scoped_refptr<AsyncFileBuffer> AsyncFileBuffer::CreateRegistered(
+    size_t size) {
+  scoped_refptr<AsyncFileBuffer> buffer = MakeRefCounted<AsyncFileBuffer>(size);
+  buffer->registered_index_ =
+      internal::AsyncFileBackend::Get()->RegisterBuffer(buffer->data(), size);
+  return buffer;
+}
+
+AsyncFileBuffer::~AsyncFileBuffer() {
+  if (registered_index_ >= 0)
+    internal::AsyncFileBackend::Get()->UnregisterBuffer(registered_index_);
+}
+
+AsyncFile::AsyncFile(File file)
+    : file_(MakeRefCounted<RefCountedData<File>>(std::move(file))) {
+  DCHECK(file_->data.IsValid());
+}
+
+AsyncFile::~AsyncFile() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+}
+
+void AsyncFile::Read(int64_t offset,
+                     scoped_refptr<AsyncFileBuffer> buffer,
+                     int size,
+                     IOCallback callback) {
+  DCHECK_GE(size, 0);
+  DCHECK_LE(static_cast<size_t>(size), buffer->size());
+  std::vector<scoped_refptr<AsyncFileBuffer>> buffers;
+  buffers.push_back(std::move(buffer));
+  Submit(std::make_unique<internal::AsyncFileOperation>(
+             internal::AsyncFileOperation::Type::kRead, offset,
+             std::move(buffers), size),
+         std::move(callback));
+}
+
+void AsyncFile::Write(int64_t offset,
+                      scoped_refptr<AsyncFileBuffer> buffer,
+                      int size,
+                      IOCallback callback) {
+  DCHECK_GE(size, 0);
+  DCHECK_LE(static_cast<size_t>(size), buffer->size());
+  std::vector<scoped_refptr<AsyncFileBuffer>> buffers;
+  buffers.push_back(std::move(buffer));
+  Submit(std::make_unique<internal::AsyncFileOperation>(
+             internal::AsyncFileOperation::Type::kWrite, offset,
+             std::move(buffers), size),
+         std::move(callback));
+}
+
+void AsyncFile::ReadV(int64_t offset,
+                      std::vector<scoped_refptr<AsyncFileBuffer>> buffers,
+                      IOCallback callback) {
+  size_t size = 0;
+  for (const scoped_refptr<AsyncFileBuffer>& buffer : buffers)
+    size += buffer->size();
+  CHECK_LE(size, static_cast<size_t>(std::numeric_limits<int>::max()));
+  Submit(std::make_unique<internal::AsyncFileOperation>(
+             internal::AsyncFileOperation::Type::kRead, offset,
+             std::move(buffers), static_cast<int>(size)),
+         std::move(callback));
+}
+
+void AsyncFile::WriteV(int64_t offset,
+                       std::vector<scoped_refptr<AsyncFileBuffer>> buffers,
+                       IOCallback callback) {
+  size_t size = 0;
+  for (const scoped_refptr<AsyncFileBuffer>& buffer : buffers)
+    size += buffer->size();
+  CHECK_LE(size, static_cast<size_t>(std::numeric_limits<int>::max()));
+  Submit(std::make_unique<internal::AsyncFileOperation>(
+             internal::AsyncFileOperation::Type::kWrite, offset,
+             std::move(buffers), static_cast<int>(size)),
+         std::move(callback));
+}
+
+void AsyncFile::Flush(StatusCallback callback) {
+  Submit(std::make_unique<internal::AsyncFileOperation>(
+             internal::AsyncFileOperation::Type::kFlush, 0,
+             std::vector<scoped_refptr<AsyncFileBuffer>>(), 0),
+         BindOnce(&RunStatusCallback, std::move(callback)));
+}
+
+void AsyncFile::Submit(std::unique_ptr<internal::AsyncFileOperation> operation,
+                       IOCallback callback) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  DCHECK(callback);
+  operation->file = file_;
+  operation->callback = std::move(callback);
+  operation->reply_task_runner = SequencedTaskRunnerHandle::Get();
+  internal::AsyncFileBackend::Get()->Submit(std::move(operation));
+}
+
+}  // namespace base
@@ -0,0 +1,130 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_FILES_ASYNC_FILE_H_
+#define BASE_FILES_ASYNC_FILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/callback.h"
+#include "base/files/file.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/sequence_checker.h"
+
+namespace base {
+
+namespace internal {
+struct AsyncFileOperation;
+}  // namespace internal
+
+// A buffer for AsyncFile operations. Operations keep the buffers they use
+// alive until they complete.
+class BASE_EXPORT AsyncFileBuffer
+    : public RefCountedThreadSafe<AsyncFileBuffer> {
+ public:
+  explicit AsyncFileBuffer(size_t size);
+
+  // Returns a buffer registered with the kernel if the io_uring backend
+  // supports it (Linux 5.19) and fewer than 64 such buffers exist, a regular
+  // buffer otherwise. Read() and Write() on a registered buffer skip mapping
+  // and pinning its pages for every operation.
+  static scoped_refptr<AsyncFileBuffer> CreateRegistered(size_t size);
+
+  char* data() const { return data_.get(); }
+  size_t size() const { return size_; }
+
+  // The index of the buffer in the io_uring backend's registered buffer
+  // table, or -1 if it isn't registered.
+  int registered_index() const { return registered_index_; }
+
+ private:
+  friend class RefCountedThreadSafe<AsyncFileBuffer>;
+
+  ~AsyncFileBuffer();
+
+  const std::unique_ptr<char[]> data_;
+  const size_t size_;
+  int registered_index_ = -1;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncFileBuffer);
+};
+
+// Runs reads, writes and flushes of a File without blocking the calling
+// sequence. Results are posted back to the sequence which started the
+// operation, which must have a SequencedTaskRunnerHandle.
+//
+// On Linux, operations are submitted to a process-wide io_uring instance
+// (Linux 5.5) and completions are reaped by a dedicated thread. Elsewhere, or
+// if io_uring is unavailable, they run on a small internal pool of blocking
+// worker threads.
+//
+// Operations may run concurrently and complete in any order: a Flush() is
+// only guaranteed to cover writes which completed before it was started.
+// Callbacks of operations pending when the AsyncFile is deleted still run,
+// and the file is only closed once they are done.
+//
+// Example:
+//   auto buffer = base::MakeRefCounted<base::AsyncFileBuffer>(4096);
+//   async_file.Read(0, buffer, 4096,
+//                   base::BindOnce(&Parser::OnRead, weak_this, buffer));
+class BASE_EXPORT AsyncFile {
+ public:
+  // |bytes| is the number of bytes transferred, possibly non-zero on error.
+  using IOCallback = OnceCallback<void(File::Error error, int bytes)>;
+  using StatusCallback = OnceCallback<void(File::Error error)>;
+
+  // |file| must be valid.
+  explicit AsyncFile(File file);
+  ~AsyncFile();
+
+  // Reads up to |size| bytes at |offset| into |buffer|. Like
+  // File::ReadNoBestEffort(), fewer bytes may be read than requested; 0 means
+  // end of file. |size| must not exceed the size of |buffer|.
+  void Read(int64_t offset,
+            scoped_refptr<AsyncFileBuffer> buffer,
+            int size,
+            IOCallback callback);
+
+  // Writes the first |size| bytes of |buffer| at |offset|. Like File::Write(),
+  // short writes are resumed, so that fewer bytes are written only on error.
+  void Write(int64_t offset,
+             scoped_refptr<AsyncFileBuffer> buffer,
+             int size,
+             IOCallback callback);
+
+  // Vectored variants: the whole of each of |buffers| is read or written in
+  // order, starting at |offset|, in a single operation.
+  void ReadV(int64_t offset,
+             std::vector<scoped_refptr<AsyncFileBuffer>> buffers,
+             IOCallback callback);
+  void WriteV(int64_t offset,
+              std::vector<scoped_refptr<AsyncFileBuffer>> buffers,
+              IOCallback callback);
+
+  // Like File::Flush().
+  void Flush(StatusCallback callback);
+
+ private:
+  // Fills in the fields of |operation| common to all operations and submits
+  // it.
+  void Submit(std::unique_ptr<internal::AsyncFileOperation> operation,
+              IOCallback callback);
+
+  // Shared with the pending operations.
+  const scoped_refptr<RefCountedData<File>> file_;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncFile);
+};
+
+}  // namespace base
+
+#endif  // BASE_FILES_ASYNC_FILE_H_
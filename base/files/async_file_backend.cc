@@ -0,0 +1,151 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/async_file_backend.h"
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/task_scheduler/work_stealing_thread_pool.h"
+#include "build/build_config.h"
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include "base/files/async_file_io_uring_linux.h"
+#endif
+
+namespace base {
+namespace internal {
+
+AsyncFileOperation::AsyncFileOperation(
+    Type type,
+    int64_t offset,
+    std::vector<scoped_refptr<AsyncFileBuffer>> buffers,
+    int size)
+    : type(type), offset(offset), buffers(std::move(buffers)), size(size) {
+  iovecs.reserve(this->buffers.size());
+  int remaining = size;
+  for (const scoped_refptr<AsyncFileBuffer>& buffer : this->buffers) {
+    const size_t length =
+        std::min(buffer->size(), static_cast<size_t>(remaining));
+    iovecs.push_back({buffer->data(), length});
+    remaining -= static_cast<int>(length);
+  }
+  DCHECK_EQ(0, remaining);
+}
+
+AsyncFileOperation::~AsyncFileOperation() = default;
+
+void AsyncFileOperation::Advance(int bytes) {
+  DCHECK_GE(bytes, 0);
+  DCHECK_LE(bytes, size - transferred);
+  transferred += bytes;
+  size_t remaining = static_cast<size_t>(bytes);
+  auto it = iovecs.begin();
+  while (it != iovecs.end() && remaining >= it->iov_len) {
+    remaining -= it->iov_len;
+    ++it;
+  }
+  iovecs.erase(iovecs.begin(), it);
+  if (remaining) {
+    iovecs.front().iov_base =
+        static_cast<char*>(iovecs.front().iov_base) + remaining;
+    iovecs.front().iov_len -= remaining;
+  }
+}
+
+// static
+void AsyncFileOperation::Complete(
+    std::unique_ptr<AsyncFileOperation> operation,
+    File::Error error) {
+  scoped_refptr<SequencedTaskRunner> reply_task_runner =
+      std::move(operation->reply_task_runner);
+  reply_task_runner->PostTask(
+      FROM_HERE, BindOnce(std::move(operation->callback), error,
+                          operation->transferred));
+}
+
+// static
+AsyncFileBackend* AsyncFileBackend::Get() {
+  // Leaked, like the threads running the operations.
+  static AsyncFileBackend* const backend = []() -> AsyncFileBackend* {
+    AsyncFileBackend* thread_pool_backend = new AsyncFileThreadPoolBackend;
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+    std::unique_ptr<AsyncFileIOUringBackend> io_uring_backend =
+        AsyncFileIOUringBackend::Create(thread_pool_backend);
+    if (io_uring_backend)
+      return io_uring_backend.release();
+#endif
+    return thread_pool_backend;
+  }();
+  return backend;
+}
+
+int AsyncFileBackend::RegisterBuffer(char* data, size_t size) {
+  return -1;
+}
+
+void AsyncFileBackend::UnregisterBuffer(int index) {
+  NOTREACHED();
+}
+
+AsyncFileThreadPoolBackend::AsyncFileThreadPoolBackend()
+    : pool_(MakeRefCounted<WorkStealingThreadPool>("AsyncFileWorker")),
+      task_runner_(pool_->CreateTaskRunner()) {
+  pool_->Start(kNumWorkers);
+}
+
+// Never called: the backend is leaked and so is |pool_|, which can't be shut
+// down from a static destructor.
+AsyncFileThreadPoolBackend::~AsyncFileThreadPoolBackend() = default;
+
+void AsyncFileThreadPoolBackend::Submit(
+    std::unique_ptr<AsyncFileOperation> operation) {
+  task_runner_->PostTask(FROM_HERE, BindOnce(&AsyncFileThreadPoolBackend::Run,
+                                             std::move(operation)));
+}
+
+// static
+void AsyncFileThreadPoolBackend::Run(
+    std::unique_ptr<AsyncFileOperation> operation) {
+  const int fd = operation->file->data.GetPlatformFile();
+  ssize_t result = 0;
+  switch (operation->type) {
+    case AsyncFileOperation::Type::kRead:
+      result = HANDLE_EINTR(preadv(fd, operation->iovecs.data(),
+                                   operation->iovecs.size(),
+                                   operation->offset));
+      if (result > 0)
+        operation->Advance(static_cast<int>(result));
+      break;
+    case AsyncFileOperation::Type::kWrite:
+      while (!operation->done()) {
+        result = HANDLE_EINTR(pwritev(
+            fd, operation->iovecs.data(), operation->iovecs.size(),
+            operation->offset + operation->transferred));
+        if (result <= 0)
+          break;
+        operation->Advance(static_cast<int>(result));
+      }
+      break;
+    case AsyncFileOperation::Type::kFlush:
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+      result = HANDLE_EINTR(fdatasync(fd));
+#else
+      result = HANDLE_EINTR(fsync(fd));
+#endif
+      break;
+  }
+  AsyncFileOperation::Complete(std::move(operation),
+                               result < 0 ? File::GetLastFileError()
+                                          : File::FILE_OK);
+}
+
+}  // namespace internal
+}  // namespace base
@@ -0,0 +1,109 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_FILES_ASYNC_FILE_BACKEND_H_
+#define BASE_FILES_ASYNC_FILE_BACKEND_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include <memory>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/files/async_file.h"
+#include "base/files/file.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/sequenced_task_runner.h"
+
+namespace base {
+
+class WorkStealingThreadPool;
+
+namespace internal {
+
+// A read, write or flush started by AsyncFile, owned by the backend running
+// it until it completes.
+struct BASE_EXPORT AsyncFileOperation {
+  enum class Type { kRead, kWrite, kFlush };
+
+  AsyncFileOperation(Type type,
+                     int64_t offset,
+                     std::vector<scoped_refptr<AsyncFileBuffer>> buffers,
+                     int size);
+  ~AsyncFileOperation();
+
+  // Accounts for |bytes| more bytes transferred, dropping them from the front
+  // of |iovecs|.
+  void Advance(int bytes);
+
+  // Whether the operation transferred everything it was asked for.
+  bool done() const { return transferred == size; }
+
+  // Posts the callback with |error| and |transferred|. |operation| is
+  // deleted.
+  static void Complete(std::unique_ptr<AsyncFileOperation> operation,
+                       File::Error error);
+
+  const Type type;
+  const int64_t offset;
+  // The buffers to read into or write from, and what remains to be
+  // transferred of them.
+  const std::vector<scoped_refptr<AsyncFileBuffer>> buffers;
+  std::vector<iovec> iovecs;
+  const int size;
+  int transferred = 0;
+
+  scoped_refptr<RefCountedData<File>> file;
+  AsyncFile::IOCallback callback;
+  scoped_refptr<SequencedTaskRunner> reply_task_runner;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncFileOperation);
+};
+
+// Runs AsyncFileOperations. Backends are process-wide and never deleted.
+class BASE_EXPORT AsyncFileBackend {
+ public:
+  virtual ~AsyncFileBackend() = default;
+
+  // Returns the backend of the process, creating it if needed.
+  static AsyncFileBackend* Get();
+
+  // Starts |operation|. May be called from any thread.
+  virtual void Submit(std::unique_ptr<AsyncFileOperation> operation) = 0;
+
+  // Registers |size| bytes at |data| as a fixed buffer. Returns its index, or
+  // -1 if unsupported. May be called from any thread.
+  virtual int RegisterBuffer(char* data, size_t size);
+
+  // Unregisters the buffer at |index|, which no pending operation uses.
+  virtual void UnregisterBuffer(int index);
+};
+
+// Runs operations with blocking syscalls on a small pool of worker threads.
+class BASE_EXPORT AsyncFileThreadPoolBackend : public AsyncFileBackend {
+ public:
+  static constexpr int kNumWorkers = 4;
+
+  AsyncFileThreadPoolBackend();
+  ~AsyncFileThreadPoolBackend() override;
+
+  // AsyncFileBackend:
+  void Submit(std::unique_ptr<AsyncFileOperation> operation) override;
+
+ private:
+  static void Run(std::unique_ptr<AsyncFileOperation> operation);
+
+  const scoped_refptr<WorkStealingThreadPool> pool_;
+  const scoped_refptr<TaskRunner> task_runner_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncFileThreadPoolBackend);
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_FILES_ASYNC_FILE_BACKEND_H_
@@ -0,0 +1,187 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/async_file_io_uring_linux.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+
+#include <utility>
+
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/memory/ptr_util.h"
+#include "base/third_party/dynamic_annotations/dynamic_annotations.h"
+
+namespace base {
+namespace internal {
+
+// static
+std::unique_ptr<AsyncFileIOUringBackend> AsyncFileIOUringBackend::Create(
+    AsyncFileBackend* fallback) {
+  std::unique_ptr<AsyncFileIOUringBackend> backend(
+      new AsyncFileIOUringBackend(fallback));
+  if (!backend->Init())
+    return nullptr;
+  return backend;
+}
+
+AsyncFileIOUringBackend::AsyncFileIOUringBackend(AsyncFileBackend* fallback)
+    : fallback_(fallback) {}
+
+// Never called: the backend is leaked, as is its completion thread.
+AsyncFileIOUringBackend::~AsyncFileIOUringBackend() = default;
+
+bool AsyncFileIOUringBackend::Init() {
+  if (!ring_.Init(kSubmissionQueueEntries, kCompletionQueueEntries, 0))
+    return false;
+
+  io_uring_rsrc_register buffers = {};
+  buffers.nr = kMaxRegisteredBuffers;
+  buffers.flags = IORING_RSRC_REGISTER_SPARSE;
+  if (ring_.Register(IORING_REGISTER_BUFFERS2, &buffers, sizeof(buffers)) ==
+      0) {
+    supports_registered_buffers_ = true;
+    registered_buffers_.resize(kMaxRegisteredBuffers);
+  }
+
+  if (!PlatformThread::CreateNonJoinable(0, this)) {
+    DLOG(ERROR) << "failed to start the AsyncFile completion thread";
+    return false;
+  }
+  return true;
+}
+
+void AsyncFileIOUringBackend::Submit(
+    std::unique_ptr<AsyncFileOperation> operation) {
+  {
+    AutoLock auto_lock(submission_lock_);
+    if (SubmitLockRequired(operation.get())) {
+      ignore_result(operation.release());
+      return;
+    }
+  }
+  fallback_->Submit(std::move(operation));
+}
+
+int AsyncFileIOUringBackend::RegisterBuffer(char* data, size_t size) {
+  if (!supports_registered_buffers_)
+    return -1;
+
+  AutoLock auto_lock(registered_buffers_lock_);
+  int index = 0;
+  while (index < kMaxRegisteredBuffers && registered_buffers_[index])
+    ++index;
+  if (index == kMaxRegisteredBuffers)
+    return -1;
+
+  iovec buffer = {data, size};
+  io_uring_rsrc_update2 update = {};
+  update.offset = index;
+  update.data = reinterpret_cast<uint64_t>(&buffer);
+  update.nr = 1;
+  const int result =
+      ring_.Register(IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update));
+  if (result != 1) {
+    // E.g. ENOMEM when exceeding RLIMIT_MEMLOCK before Linux 5.12.
+    DLOG(ERROR) << "registering a buffer failed: " << -result;
+    return -1;
+  }
+  registered_buffers_[index] = true;
+  return index;
+}
+
+void AsyncFileIOUringBackend::UnregisterBuffer(int index) {
+  AutoLock auto_lock(registered_buffers_lock_);
+  DCHECK(registered_buffers_[index]);
+
+  // An empty buffer clears the slot.
+  iovec buffer = {nullptr, 0};
+  io_uring_rsrc_update2 update = {};
+  update.offset = index;
+  update.data = reinterpret_cast<uint64_t>(&buffer);
+  update.nr = 1;
+  const int result =
+      ring_.Register(IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update));
+  DCHECK_EQ(1, result);
+  registered_buffers_[index] = false;
+}
+
+void AsyncFileIOUringBackend::ThreadMain() {
+  PlatformThread::SetName("AsyncFileCompletions");
+  for (;;) {
+    ring_.Wait(1);
+    const uint32_t count = ring_.CompletionsReady();
+    for (uint32_t i = 0; i < count; ++i) {
+      const io_uring_cqe& cqe = ring_.GetCompletion(i);
+      AsyncFileOperation* operation = reinterpret_cast<AsyncFileOperation*>(
+          static_cast<uintptr_t>(cqe.user_data));
+      ANNOTATE_HAPPENS_AFTER(operation);
+      OnCompletion(WrapUnique(operation), cqe.res);
+    }
+    ring_.ConsumeCompletions(count);
+  }
+}
+
+bool AsyncFileIOUringBackend::SubmitLockRequired(
+    AsyncFileOperation* operation) {
+  io_uring_sqe* sqe = ring_.GetSqe();
+  if (!sqe)
+    return false;
+
+  const int fd = operation->file->data.GetPlatformFile();
+  const uint64_t offset = operation->offset + operation->transferred;
+  const bool read = operation->type == AsyncFileOperation::Type::kRead;
+  sqe->fd = fd;
+  sqe->user_data = reinterpret_cast<uintptr_t>(operation);
+  if (operation->type == AsyncFileOperation::Type::kFlush) {
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+  } else if (operation->buffers.size() == 1 &&
+             operation->buffers[0]->registered_index() >= 0) {
+    sqe->opcode = read ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+    sqe->addr = reinterpret_cast<uintptr_t>(operation->iovecs[0].iov_base);
+    sqe->len = static_cast<uint32_t>(operation->iovecs[0].iov_len);
+    sqe->off = offset;
+    sqe->buf_index =
+        static_cast<uint16_t>(operation->buffers[0]->registered_index());
+  } else {
+    sqe->opcode = read ? IORING_OP_READV : IORING_OP_WRITEV;
+    sqe->addr = reinterpret_cast<uintptr_t>(operation->iovecs.data());
+    sqe->len = static_cast<uint32_t>(operation->iovecs.size());
+    sqe->off = offset;
+  }
+  // The kernel hands |operation| over to ThreadMain().
+  ANNOTATE_HAPPENS_BEFORE(operation);
+  ring_.Submit();
+  return true;
+}
+
+void AsyncFileIOUringBackend::OnCompletion(
+    std::unique_ptr<AsyncFileOperation> operation,
+    int32_t result) {
+  if (result == -EINTR || result == -EAGAIN) {
+    Submit(std::move(operation));
+    return;
+  }
+  if (result < 0) {
+    AsyncFileOperation::Complete(std::move(operation),
+                                 File::OSErrorToFileError(-result));
+    return;
+  }
+  if (operation->type != AsyncFileOperation::Type::kFlush) {
+    operation->Advance(result);
+    // Short writes are resumed. Reads are only issued once, like
+    // File::ReadNoBestEffort().
+    if (operation->type == AsyncFileOperation::Type::kWrite && result > 0 &&
+        !operation->done()) {
+      Submit(std::move(operation));
+      return;
+    }
+  }
+  AsyncFileOperation::Complete(std::move(operation), File::FILE_OK);
+}
+
+}  // namespace internal
+}  // namespace base
@@ -0,0 +1,86 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_FILES_ASYNC_FILE_IO_URING_LINUX_H_
+#define BASE_FILES_ASYNC_FILE_IO_URING_LINUX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/files/async_file_backend.h"
+#include "base/macros.h"
+#include "base/posix/io_uring_linux.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+
+namespace base {
+namespace internal {
+
+// Runs AsyncFileOperations as io_uring requests. Any thread submits through a
+// lock-protected submission queue (one io_uring_enter() per operation); a
+// dedicated thread waits for completions, resumes short writes and posts the
+// results. Operations which don't fit in the submission queue are handed to
+// |fallback|.
+class BASE_EXPORT AsyncFileIOUringBackend : public AsyncFileBackend,
+                                            public PlatformThread::Delegate {
+ public:
+  // Maximum number of buffers registered at once.
+  static constexpr int kMaxRegisteredBuffers = 64;
+
+  // Returns null if io_uring is unavailable.
+  static std::unique_ptr<AsyncFileIOUringBackend> Create(
+      AsyncFileBackend* fallback);
+
+  ~AsyncFileIOUringBackend() override;
+
+  // AsyncFileBackend:
+  void Submit(std::unique_ptr<AsyncFileOperation> operation) override;
+  int RegisterBuffer(char* data, size_t size) override;
+  void UnregisterBuffer(int index) override;
+
+  // PlatformThread::Delegate:
+  void ThreadMain() override;
+
+ private:
+  static constexpr uint32_t kSubmissionQueueEntries = 256;
+  static constexpr uint32_t kCompletionQueueEntries = 1024;
+
+  explicit AsyncFileIOUringBackend(AsyncFileBackend* fallback);
+
+  bool Init();
+
+  // Queues |operation|, whose ownership is passed to the ring on success, and
+  // submits it. Returns false if the submission queue is full.
+  bool SubmitLockRequired(AsyncFileOperation* operation);
+
+  // Handles the completion of |operation| with |result|.
+  void OnCompletion(std::unique_ptr<AsyncFileOperation> operation,
+                    int32_t result);
+
+  AsyncFileBackend* const fallback_;
+
+  internal::IOUring ring_;
+
+  // Whether fixed buffers can be registered (sparse buffer tables, Linux
+  // 5.19).
+  bool supports_registered_buffers_ = false;
+
+  // Protects the submission side of |ring_|.
+  Lock submission_lock_;
+
+  Lock registered_buffers_lock_;
+  // Whether each index of the registered buffer table is in use.
+  std::vector<bool> registered_buffers_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncFileIOUringBackend);
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_FILES_ASYNC_FILE_IO_URING_LINUX_H_
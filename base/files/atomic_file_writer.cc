@@ -0,0 +1,203 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/atomic_file_writer.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <set>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_file.h"
+#include "base/logging.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/threading/thread_restrictions.h"
+#include "build/build_config.h"
+
+namespace base {
+
+namespace {
+
+// Syncs the data of |fd|, and the metadata needed to read it back.
+bool SyncFileData(int fd) {
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  return HANDLE_EINTR(fdatasync(fd)) == 0;
+#else
+  return HANDLE_EINTR(fsync(fd)) == 0;
+#endif
+}
+
+// Syncs the directory |path|, making the renames into it durable.
+bool SyncDirectory(const FilePath& path) {
+  ScopedFD fd(HANDLE_EINTR(
+      open(path.value().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)));
+  if (!fd.is_valid()) {
+    DPLOG(ERROR) << "Couldn't open directory " << path.value();
+    return false;
+  }
+  if (HANDLE_EINTR(fsync(fd.get())) != 0) {
+    DPLOG(ERROR) << "Couldn't sync directory " << path.value();
+    return false;
+  }
+  return true;
+}
+
+// A write of a commit, from its temporary file to its target.
+struct TemporaryFile {
+  ScopedFD fd;
+  FilePath path;
+  bool ok = false;
+};
+
+}  // namespace
+
+AtomicFileWriter::PendingWrite::PendingWrite() = default;
+
+AtomicFileWriter::PendingWrite::PendingWrite(PendingWrite&& other) = default;
+
+AtomicFileWriter::PendingWrite::~PendingWrite() = default;
+
+AtomicFileWriter::AtomicFileWriter(
+    scoped_refptr<SequencedTaskRunner> task_runner,
+    TimeDelta commit_interval)
+    : task_runner_(std::move(task_runner)),
+      commit_interval_(commit_interval) {}
+
+AtomicFileWriter::~AtomicFileWriter() {
+  // The Commit() tasks hold a reference, so pending writes are left only if
+  // |task_runner_| dropped them, e.g. when it was shut down before the commit
+  // interval passed. Don't lose them.
+  if (!pending_writes_.empty())
+    CommitAndRunCallbacks(std::move(pending_writes_));
+}
+
+// static
+bool AtomicFileWriter::WriteFileAtomically(const FilePath& path,
+                                           StringPiece data) {
+  PendingWrites writes;
+  writes[path].data = data.as_string();
+  return CommitWrites(writes)[0];
+}
+
+void AtomicFileWriter::ScheduleWrite(const FilePath& path,
+                                     std::string data,
+                                     WriteCallback callback) {
+  AutoLock auto_lock(lock_);
+  PendingWrite& write = pending_writes_[path];
+  write.data = std::move(data);
+  if (callback)
+    write.callbacks.push_back(std::move(callback));
+  if (commit_scheduled_)
+    return;
+  commit_scheduled_ = true;
+  task_runner_->PostDelayedTask(
+      FROM_HERE, BindOnce(&AtomicFileWriter::Commit, this), commit_interval_);
+}
+
+void AtomicFileWriter::CommitPendingWrites() {
+  task_runner_->PostTask(FROM_HERE, BindOnce(&AtomicFileWriter::Commit, this));
+}
+
+bool AtomicFileWriter::HasPendingWrites() const {
+  AutoLock auto_lock(lock_);
+  return !pending_writes_.empty();
+}
+
+void AtomicFileWriter::Commit() {
+  PendingWrites writes;
+  {
+    AutoLock auto_lock(lock_);
+    writes.swap(pending_writes_);
+    commit_scheduled_ = false;
+  }
+  if (!writes.empty())
+    CommitAndRunCallbacks(std::move(writes));
+}
+
+// static
+void AtomicFileWriter::CommitAndRunCallbacks(PendingWrites writes) {
+  const std::vector<bool> results = CommitWrites(writes);
+  size_t i = 0;
+  for (auto& path_and_write : writes) {
+    for (WriteCallback& callback : path_and_write.second.callbacks)
+      std::move(callback).Run(results[i]);
+    ++i;
+  }
+}
+
+// static
+std::vector<bool> AtomicFileWriter::CommitWrites(const PendingWrites& writes) {
+  AssertBlockingAllowed();
+
+  // Write every temporary file and start its writeback, so that the disk
+  // works on all of them while the first one is synced.
+  std::vector<TemporaryFile> files(writes.size());
+  size_t i = 0;
+  for (const auto& path_and_write : writes) {
+    TemporaryFile& file = files[i++];
+    const FilePath& target = path_and_write.first;
+    const std::string& data = path_and_write.second.data;
+    file.fd.reset(
+        CreateAndOpenFdForTemporaryFileInDir(target.DirName(), &file.path));
+    if (!file.fd.is_valid()) {
+      DPLOG(ERROR) << "Couldn't create a temporary file for "
+                   << target.value();
+      continue;
+    }
+    if (!WriteFileDescriptor(file.fd.get(), data.data(),
+                             static_cast<int>(data.size()))) {
+      DPLOG(ERROR) << "Couldn't write " << file.path.value();
+      continue;
+    }
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+    // Only a hint: errors are reported by the fdatasync() below.
+    sync_file_range(file.fd.get(), 0, 0, SYNC_FILE_RANGE_WRITE);
+#endif
+    file.ok = true;
+  }
+
+  // Sync and move each file into place, then make the renames durable by
+  // syncing each directory once.
+  std::set<FilePath> directories;
+  i = 0;
+  for (const auto& path_and_write : writes) {
+    TemporaryFile& file = files[i++];
+    const FilePath& target = path_and_write.first;
+    if (file.ok && !SyncFileData(file.fd.get())) {
+      DPLOG(ERROR) << "Couldn't sync " << file.path.value();
+      file.ok = false;
+    }
+    file.fd.reset();
+    if (file.ok && rename(file.path.value().c_str(), target.value().c_str())) {
+      DPLOG(ERROR) << "Couldn't rename " << file.path.value() << " to "
+                   << target.value();
+      file.ok = false;
+    }
+    if (file.ok)
+      directories.insert(target.DirName());
+    else if (!file.path.empty())
+      unlink(file.path.value().c_str());
+  }
+
+  std::set<FilePath> failed_directories;
+  for (const FilePath& directory : directories) {
+    if (!SyncDirectory(directory))
+      failed_directories.insert(directory);
+  }
+
+  std::vector<bool> results;
+  results.reserve(writes.size());
+  i = 0;
+  for (const auto& path_and_write : writes) {
+    const FilePath directory = path_and_write.first.DirName();
+    results.push_back(files[i++].ok && !failed_directories.count(directory));
+  }
+  return results;
+}
+
+}  // namespace base
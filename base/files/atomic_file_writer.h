@@ -0,0 +1,115 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_FILES_ATOMIC_FILE_WRITER_H_
+#define BASE_FILES_ATOMIC_FILE_WRITER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/callback.h"
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/sequenced_task_runner.h"
+#include "base/strings/string_piece.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+
+namespace base {
+
+// Replaces files atomically and durably: the data is written to a temporary
+// file in the same directory, synced, renamed over the target and the
+// directory is synced, so that after a crash the target holds either the old
+// or the new contents, never a mix or nothing.
+//
+// Besides the blocking WriteFileAtomically(), an AtomicFileWriter batches
+// writes scheduled from any thread: once |commit_interval| has passed since
+// the first pending write, all pending writes are committed together on
+// |task_runner| as one group commit. Writeback of all the files is started
+// at once (sync_file_range() on Linux) before each is fdatasync()ed, and each
+// directory is only fsync()ed once per commit.
+//
+// Writes still pending when the last reference goes away, which only happens
+// if |task_runner| drops the commit task, are committed by the destructor
+// instead, blocking, and their callbacks run on the destroying thread.
+//
+// Example:
+//
+//   scoped_refptr<base::AtomicFileWriter> writer =
+//       base::MakeRefCounted<base::AtomicFileWriter>(
+//           io_task_runner, base::TimeDelta::FromMilliseconds(100));
+//   writer->ScheduleWrite(settings_path, SerializeSettings(),
+//                         base::OnceCallback<void(bool)>());
+class BASE_EXPORT AtomicFileWriter
+    : public RefCountedThreadSafe<AtomicFileWriter> {
+ public:
+  // Runs on the writer's task runner once the write is committed, with
+  // whether it succeeded.
+  using WriteCallback = OnceCallback<void(bool success)>;
+
+  AtomicFileWriter(scoped_refptr<SequencedTaskRunner> task_runner,
+                   TimeDelta commit_interval);
+
+  // Writes |data| to |path| atomically and durably, blocking until done.
+  // Returns false on failure. |path| is then unchanged, unless only syncing
+  // its directory failed.
+  static bool WriteFileAtomically(const FilePath& path, StringPiece data);
+
+  // Schedules writing |data| to |path| with the next commit. A later write to
+  // the same path before the commit replaces this one; |callback| then runs
+  // with the result of the later write. |callback| may be null. May be called
+  // from any thread.
+  void ScheduleWrite(const FilePath& path,
+                     std::string data,
+                     WriteCallback callback);
+
+  // Commits the pending writes without waiting for the commit interval.
+  void CommitPendingWrites();
+
+  // Whether writes are waiting for a commit.
+  bool HasPendingWrites() const;
+
+ private:
+  friend class RefCountedThreadSafe<AtomicFileWriter>;
+
+  struct PendingWrite {
+    PendingWrite();
+    PendingWrite(PendingWrite&& other);
+    ~PendingWrite();
+
+    std::string data;
+    std::vector<WriteCallback> callbacks;
+  };
+  using PendingWrites = std::map<FilePath, PendingWrite>;
+
+  ~AtomicFileWriter();
+
+  // Takes the pending writes and commits them. Runs on |task_runner_|.
+  void Commit();
+
+  // Commits |writes| and runs their callbacks with the results.
+  static void CommitAndRunCallbacks(PendingWrites writes);
+
+  // Writes all of |writes| atomically and durably. Returns the result of each
+  // write, in the order of |writes|.
+  static std::vector<bool> CommitWrites(const PendingWrites& writes);
+
+  const scoped_refptr<SequencedTaskRunner> task_runner_;
+  const TimeDelta commit_interval_;
+
+  mutable Lock lock_;
+  PendingWrites pending_writes_;
+  // Whether a Commit() task was posted and hasn't taken the pending writes
+  // yet.
+  bool commit_scheduled_ = false;
+
+  DISALLOW_COPY_AND_ASSIGN(AtomicFileWriter);
+};
+
+}  // namespace base
+
+#endif  // BASE_FILES_ATOMIC_FILE_WRITER_H_
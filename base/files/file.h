@@ -20,6 +20,7 @@
 
 #if defined(OS_POSIX) || defined(OS_FUCHSIA)
 #include <sys/stat.h>
+#include <sys/uio.h>
 #endif
 
 namespace base {
@@ -33,7 +34,7 @@ typedef struct stat64 stat_wrapper_t;
 
 // Thin wrapper around an OS-level file.
 // Note that this class does not provide any support for asynchronous IO, other
-// than the ability to create asynchronous handles on Windows.
+// than the ability to create asynchronous handles on Windows. See AsyncFile.
 //
 // Note about const: this class does not attempt to determine if the underlying
 // file system object is affected by a particular method in order to consider
@@ -235,6 +236,27 @@ class BASE_EXPORT File {
   // platforms. Returns the number of bytes written, or -1 on error.
   int WriteAtCurrentPosNoBestEffort(const char* data, int size);
 
+#if defined(OS_POSIX) || defined(OS_FUCHSIA)
+  // Vectored versions of the above: |count| buffers described by |buffers|
+  // are filled or written in order, in as few system calls as possible.
+  // Returns the number of bytes transferred, or -1 on error or if the buffers
+  // add up to more than INT_MAX bytes. Like Read() and Write(), these make a
+  // best effort to transfer everything, resuming after partial transfers.
+
+  // Reads into |buffers| from the current position.
+  int ReadV(const iovec* buffers, int count);
+
+  // Writes |buffers| at the current position.
+  int WriteV(const iovec* buffers, int count);
+
+  // Reads into |buffers| starting at |offset|, without seeking.
+  int PreadV(int64_t offset, const iovec* buffers, int count);
+
+  // Writes |buffers| starting at |offset|, without seeking. Ignores |offset|
+  // and writes to the end of the file if it was opened with FLAG_APPEND.
+  int PwriteV(int64_t offset, const iovec* buffers, int count);
+#endif
+
   // Returns the current size of this file, or a negative number on failure.
   int64_t GetLength();
 
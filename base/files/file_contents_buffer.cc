@@ -0,0 +1,48 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/file_contents_buffer.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "base/files/memory_mapped_file.h"
+#include "base/logging.h"
+#include "base/memory/page_size.h"
+
+namespace base {
+
+// static
+scoped_refptr<FileContentsBuffer> FileContentsBuffer::Allocate(
+    size_t capacity) {
+  void* data = nullptr;
+  // posix_memalign() may return null for 0 bytes.
+  if (posix_memalign(&data, GetPageSize(), std::max<size_t>(capacity, 1)))
+    return nullptr;
+  scoped_refptr<FileContentsBuffer> buffer(new FileContentsBuffer);
+  buffer->heap_data_.reset(static_cast<char*>(data));
+  buffer->capacity_ = capacity;
+  buffer->data_ = buffer->heap_data_.get();
+  return buffer;
+}
+
+// static
+scoped_refptr<FileContentsBuffer> FileContentsBuffer::FromMapping(
+    std::unique_ptr<MemoryMappedFile> mapping) {
+  DCHECK(mapping->IsValid());
+  scoped_refptr<FileContentsBuffer> buffer(new FileContentsBuffer);
+  buffer->data_ = reinterpret_cast<const char*>(mapping->data());
+  buffer->size_ = mapping->length();
+  buffer->capacity_ = buffer->size_;
+  buffer->mapping_ = std::move(mapping);
+  return buffer;
+}
+
+FileContentsBuffer::FileContentsBuffer() = default;
+
+FileContentsBuffer::~FileContentsBuffer() = default;
+
+}  // namespace base
@@ -0,0 +1,76 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_FILES_FILE_CONTENTS_BUFFER_H_
+#define BASE_FILES_FILE_CONTENTS_BUFFER_H_
+
+#include <stddef.h>
+
+#include <memory>
+
+#include "base/base_export.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/memory/free_deleter.h"
+#include "base/memory/ref_counted.h"
+#include "base/strings/string_piece.h"
+
+namespace base {
+
+class MemoryMappedFile;
+
+// Read-only contents of a file, as returned by ReadFileToBuffer(): either a
+// page-aligned heap buffer or a read-only mapping of the file. The contents
+// can be handed around and wrapped without copying, e.g. in a StringPiece
+// (see AsStringPiece()) or a read-only Pickle.
+class BASE_EXPORT FileContentsBuffer
+    : public RefCountedThreadSafe<FileContentsBuffer> {
+ public:
+  // Returns an uninitialized page-aligned buffer of |capacity| bytes, to be
+  // filled through mutable_data() before set_size(). Returns null if out of
+  // memory.
+  static scoped_refptr<FileContentsBuffer> Allocate(size_t capacity);
+
+  // Returns a buffer holding the data of |mapping|, which must be valid.
+  static scoped_refptr<FileContentsBuffer> FromMapping(
+      std::unique_ptr<MemoryMappedFile> mapping);
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+  StringPiece AsStringPiece() const { return StringPiece(data_, size_); }
+
+  // Whether the contents are a mapping of the file.
+  bool is_mapped() const { return !!mapping_; }
+
+  // Only for Allocate()d buffers while they are filled.
+  char* mutable_data() {
+    DCHECK(!mapping_);
+    return heap_data_.get();
+  }
+  size_t capacity() const { return capacity_; }
+  void set_size(size_t size) {
+    DCHECK_LE(size, capacity_);
+    size_ = size;
+  }
+
+ private:
+  friend class RefCountedThreadSafe<FileContentsBuffer>;
+
+  FileContentsBuffer();
+  ~FileContentsBuffer();
+
+  std::unique_ptr<char, FreeDeleter> heap_data_;
+  size_t capacity_ = 0;
+  std::unique_ptr<MemoryMappedFile> mapping_;
+
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(FileContentsBuffer);
+};
+
+}  // namespace base
+
+#endif  // BASE_FILES_FILE_CONTENTS_BUFFER_H_
@@ -0,0 +1,74 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_FILES_FILE_PATH_WATCHER_H_
+#define BASE_FILES_FILE_PATH_WATCHER_H_
+
+#include <memory>
+
+#include "base/base_export.h"
+#include "base/callback.h"
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/time/time.h"
+
+namespace base {
+
+// Watches a file or a directory for changes, without polling: on Linux the
+// kernel reports changes through inotify, which is read when the IO message
+// loop of the watching thread finds it readable, so idle files cost nothing.
+// All the watchers of a thread share one inotify instance.
+//
+// The watched path's parent directory must exist. Replacing the path, e.g.
+// by renaming a new version of a file over it, counts as a change and the
+// watch follows the new file or directory.
+//
+// Must be used on a thread running a MessageLoopForIO, on which callbacks
+// run. Deleting the watcher cancels the watch, including pending callbacks.
+class BASE_EXPORT FilePathWatcher {
+ public:
+  // Type of watch, for directories.
+  enum class Type {
+    // Only changes to the path itself, or to the entries of the directory.
+    kNonRecursive,
+    // Also changes anywhere in the tree under the directory, including in
+    // subdirectories created after Watch().
+    kRecursive,
+  };
+
+  // Runs with the watched path when it changed. |error| is true if changes
+  // may have been missed, e.g. when the inotify watch limit was reached for a
+  // new subdirectory.
+  using Callback = RepeatingCallback<void(const FilePath& path, bool error)>;
+
+  FilePathWatcher();
+  ~FilePathWatcher();
+
+  // Returns true if Watch() supports Type::kRecursive.
+  static bool RecursiveWatchAvailable();
+
+  // Starts watching |path|, running |callback| once per |coalesce_window| at
+  // most: the changes made during that window after the first one are
+  // reported by the same callback run. Returns false if |path| can't be
+  // watched. May only be called once.
+  bool Watch(const FilePath& path,
+             Type type,
+             TimeDelta coalesce_window,
+             const Callback& callback);
+
+  // Same as above, reporting each batch of changes read from the kernel
+  // right away.
+  bool Watch(const FilePath& path, Type type, const Callback& callback);
+
+ private:
+  class Impl;
+
+  std::unique_ptr<Impl> impl_;
+
+  DISALLOW_COPY_AND_ASSIGN(FilePathWatcher);
+};
+
+}  // namespace base
+
+#endif  // BASE_FILES_FILE_PATH_WATCHER_H_
@@ -0,0 +1,393 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/file_path_watcher.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/files/file_enumerator.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_file.h"
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+#include "base/memory/weak_ptr.h"
+#include "base/message_loop/message_loop_current.h"
+#include "base/message_loop/message_pump_for_io.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/stl_util.h"
+#include "base/threading/thread_checker.h"
+#include "base/threading/thread_local.h"
+#include "base/threading/thread_task_runner_handle.h"
+
+namespace base {
+
+namespace {
+
+// Events watched on every directory. Files are never watched themselves:
+// the events of a directory's entries are reported on the directory, which
+// also catches a file being replaced by a rename.
+constexpr uint32_t kWatchMask = IN_ATTRIB | IN_CREATE | IN_DELETE |
+                                IN_CLOSE_WRITE | IN_MODIFY | IN_MOVE |
+                                IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+class InotifyReader;
+
+LazyInstance<ThreadLocalPointer<InotifyReader>>::Leaky tls_reader =
+    LAZY_INSTANCE_INITIALIZER;
+
+// The inotify instance of a thread, shared by its FilePathWatchers so that
+// they don't run into the per-user limit of inotify instances. Reads events
+// when the IO message pump finds the instance readable, and dispatches each
+// one to the watchers of its watch descriptor. Deletes itself when its last
+// watcher is removed.
+class InotifyReader : public MessagePumpForIO::FdWatcher {
+ public:
+  class Watcher {
+   public:
+    // Called for each event of a watch descriptor added by the watcher.
+    // IN_IGNORED events mean that the descriptor was removed by the kernel.
+    virtual void OnInotifyEvent(const inotify_event& event) = 0;
+
+    // Called when the kernel dropped events.
+    virtual void OnInotifyOverflow() = 0;
+
+   protected:
+    virtual ~Watcher() = default;
+  };
+
+  // Returns the reader of the current thread, which must run a
+  // MessageLoopForIO, with |watcher| added to it. Returns null on failure.
+  static InotifyReader* AddWatcher(Watcher* watcher) {
+    InotifyReader* reader = tls_reader.Pointer()->Get();
+    if (!reader) {
+      reader = new InotifyReader;
+      if (!reader->Init()) {
+        delete reader;
+        return nullptr;
+      }
+      tls_reader.Pointer()->Set(reader);
+    }
+    reader->watchers_.insert(watcher);
+    return reader;
+  }
+
+  // Removes |watcher| and its watch descriptors. May delete the reader.
+  void RemoveWatcher(Watcher* watcher) {
+    DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+    for (auto it = watch_owners_.begin(); it != watch_owners_.end();) {
+      if (it->second.erase(watcher) && it->second.empty()) {
+        inotify_rm_watch(inotify_fd_.get(), it->first);
+        it = watch_owners_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    watchers_.erase(watcher);
+    if (watchers_.empty()) {
+      tls_reader.Pointer()->Set(nullptr);
+      delete this;
+    }
+  }
+
+  // Watches the directory |path| for |watcher|. Returns the watch descriptor,
+  // or -1 with errno set on failure.
+  int AddWatch(const FilePath& path, Watcher* watcher) {
+    DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+    DCHECK(ContainsKey(watchers_, watcher));
+    const int wd =
+        inotify_add_watch(inotify_fd_.get(), path.value().c_str(), kWatchMask);
+    if (wd >= 0)
+      watch_owners_[wd].insert(watcher);
+    return wd;
+  }
+
+  // Stops watching |wd| for |watcher|.
+  void RemoveWatch(int wd, Watcher* watcher) {
+    DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+    auto it = watch_owners_.find(wd);
+    if (it == watch_owners_.end() || !it->second.erase(watcher) ||
+        !it->second.empty()) {
+      return;
+    }
+    inotify_rm_watch(inotify_fd_.get(), wd);
+    watch_owners_.erase(it);
+  }
+
+  // MessagePumpForIO::FdWatcher:
+  void OnFileCanReadWithoutBlocking(int fd) override {
+    DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+    alignas(inotify_event) char buffer[16 * 1024];
+    while (true) {
+      const ssize_t bytes_read = HANDLE_EINTR(read(fd, buffer, sizeof(buffer)));
+      if (bytes_read <= 0) {
+        DPLOG_IF(ERROR, bytes_read < 0 && errno != EAGAIN) << "read";
+        return;
+      }
+      for (ssize_t offset = 0; offset < bytes_read;) {
+        const inotify_event* event =
+            reinterpret_cast<const inotify_event*>(buffer + offset);
+        offset += sizeof(inotify_event) + event->len;
+        DispatchEvent(*event);
+      }
+    }
+  }
+
+  void OnFileCanWriteWithoutBlocking(int fd) override { NOTREACHED(); }
+
+ private:
+  InotifyReader() : controller_(FROM_HERE) {}
+
+  ~InotifyReader() override { DCHECK(watchers_.empty()); }
+
+  bool Init() {
+    inotify_fd_.reset(inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+    if (!inotify_fd_.is_valid()) {
+      DPLOG(ERROR) << "inotify_init1";
+      return false;
+    }
+    return MessageLoopCurrentForIO::Get()->WatchFileDescriptor(
+        inotify_fd_.get(), true, MessagePumpForIO::WATCH_READ, &controller_,
+        this);
+  }
+
+  void DispatchEvent(const inotify_event& event) {
+    // Watchers add and remove watches while handling the event, but are only
+    // deleted by tasks.
+    if (event.mask & IN_Q_OVERFLOW) {
+      const std::set<Watcher*> watchers = watchers_;
+      for (Watcher* watcher : watchers)
+        watcher->OnInotifyOverflow();
+      return;
+    }
+    auto it = watch_owners_.find(event.wd);
+    if (it == watch_owners_.end())
+      return;
+    const std::set<Watcher*> owners = it->second;
+    if (event.mask & IN_IGNORED)
+      watch_owners_.erase(it);
+    for (Watcher* owner : owners)
+      owner->OnInotifyEvent(event);
+  }
+
+  ScopedFD inotify_fd_;
+  MessagePumpForIO::FdWatchController controller_;
+
+  std::set<Watcher*> watchers_;
+  // The watchers of each watch descriptor. Watching the same directory twice
+  // returns the same descriptor, which is only removed from the kernel along
+  // with its last watcher.
+  std::map<int, std::set<Watcher*>> watch_owners_;
+
+  THREAD_CHECKER(thread_checker_);
+
+  DISALLOW_COPY_AND_ASSIGN(InotifyReader);
+};
+
+}  // namespace
+
+class FilePathWatcher::Impl : public InotifyReader::Watcher {
+ public:
+  Impl(const FilePath& path,
+       Type type,
+       TimeDelta coalesce_window,
+       const Callback& callback)
+      : path_(path),
+        type_(type),
+        coalesce_window_(coalesce_window),
+        callback_(callback),
+        weak_factory_(this) {}
+
+  ~Impl() override {
+    DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+    if (reader_)
+      reader_->RemoveWatcher(this);
+  }
+
+  bool Start() {
+    DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+    reader_ = InotifyReader::AddWatcher(this);
+    if (!reader_)
+      return false;
+    parent_wd_ = reader_->AddWatch(path_.DirName(), this);
+    if (parent_wd_ < 0) {
+      DPLOG(ERROR) << "Couldn't watch " << path_.DirName().value();
+      return false;
+    }
+    return UpdateTargetWatches();
+  }
+
+  // InotifyReader::Watcher:
+  void OnInotifyEvent(const inotify_event& event) override {
+    DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+    if (event.wd == parent_wd_) {
+      OnParentEvent(event);
+      return;
+    }
+    auto it = watched_dirs_.find(event.wd);
+    if (it == watched_dirs_.end())
+      return;
+    if (event.mask & IN_IGNORED) {
+      watched_dirs_.erase(it);
+      return;
+    }
+    bool error = false;
+    if (type_ == Type::kRecursive && event.len && (event.mask & IN_ISDIR)) {
+      const FilePath dir = it->second.Append(event.name);
+      if (event.mask & (IN_CREATE | IN_MOVED_TO))
+        error = !WatchTree(dir);
+      else if (event.mask & IN_MOVED_FROM)
+        UnwatchTree(dir);
+    }
+    NotifyChange(error);
+  }
+
+  void OnInotifyOverflow() override {
+    DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+    NotifyChange(true);
+  }
+
+ private:
+  void OnParentEvent(const inotify_event& event) {
+    if (event.mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+      // The parent is gone, and so is the watched path.
+      if (event.mask & IN_IGNORED)
+        parent_wd_ = -1;
+      NotifyChange(false);
+      return;
+    }
+    if (!event.len || path_.BaseName().value() != event.name)
+      return;
+    bool error = false;
+    if (event.mask & (IN_CREATE | IN_DELETE | IN_MOVE))
+      error = !UpdateTargetWatches();
+    NotifyChange(error);
+  }
+
+  // Watches |path_| again if it's a directory, to follow a replacement.
+  // Returns false if some directory couldn't be watched.
+  bool UpdateTargetWatches() {
+    for (const auto& wd_and_dir : watched_dirs_)
+      reader_->RemoveWatch(wd_and_dir.first, this);
+    watched_dirs_.clear();
+    if (!DirectoryExists(path_))
+      return true;
+    if (type_ == Type::kRecursive)
+      return WatchTree(path_);
+    return WatchDirectory(path_);
+  }
+
+  bool WatchDirectory(const FilePath& dir) {
+    const int wd = reader_->AddWatch(dir, this);
+    if (wd < 0) {
+      // The directory may have been deleted meanwhile.
+      DPLOG_IF(ERROR, errno != ENOENT && errno != ENOTDIR)
+          << "Couldn't watch " << dir.value();
+      return errno == ENOENT || errno == ENOTDIR;
+    }
+    watched_dirs_[wd] = dir;
+    return true;
+  }
+
+  // Watches |dir| and every directory under it.
+  bool WatchTree(const FilePath& dir) {
+    bool success = WatchDirectory(dir);
+    FileEnumerator enumerator(dir, true, FileEnumerator::DIRECTORIES);
+    for (FilePath subdir = enumerator.Next(); !subdir.empty();
+         subdir = enumerator.Next()) {
+      success &= WatchDirectory(subdir);
+    }
+    return success;
+  }
+
+  // Stops watching |dir| and the directories under it, after it was moved
+  // out of the watched tree.
+  void UnwatchTree(const FilePath& dir) {
+    for (auto it = watched_dirs_.begin(); it != watched_dirs_.end();) {
+      if (it->second == dir || dir.IsParent(it->second)) {
+        reader_->RemoveWatch(it->first, this);
+        it = watched_dirs_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  // Schedules the callback, unless it already is.
+  void NotifyChange(bool error) {
+    error_pending_ |= error;
+    if (callback_pending_)
+      return;
+    callback_pending_ = true;
+    ThreadTaskRunnerHandle::Get()->PostDelayedTask(
+        FROM_HERE,
+        BindOnce(&Impl::RunCallback, weak_factory_.GetWeakPtr()),
+        coalesce_window_);
+  }
+
+  void RunCallback() {
+    DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+    callback_pending_ = false;
+    const bool error = error_pending_;
+    error_pending_ = false;
+    // May delete |this|.
+    callback_.Run(path_, error);
+  }
+
+  const FilePath path_;
+  const Type type_;
+  const TimeDelta coalesce_window_;
+  const Callback callback_;
+
+  InotifyReader* reader_ = nullptr;
+  int parent_wd_ = -1;
+  // The watched directories at or under |path_|.
+  std::map<int, FilePath> watched_dirs_;
+
+  bool callback_pending_ = false;
+  bool error_pending_ = false;
+
+  THREAD_CHECKER(thread_checker_);
+
+  WeakPtrFactory<Impl> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(Impl);
+};
+
+FilePathWatcher::FilePathWatcher() = default;
+
+FilePathWatcher::~FilePathWatcher() = default;
+
+// static
+bool FilePathWatcher::RecursiveWatchAvailable() {
+  return true;
+}
+
+bool FilePathWatcher::Watch(const FilePath& path,
+                            Type type,
+                            TimeDelta coalesce_window,
+                            const Callback& callback) {
+  DCHECK(!impl_);
+  DCHECK(path.IsAbsolute());
+  impl_ = std::make_unique<Impl>(path, type, coalesce_window, callback);
+  if (impl_->Start())
+    return true;
+  impl_.reset();
+  return false;
+}
+
+bool FilePathWatcher::Watch(const FilePath& path,
+                            Type type,
+                            const Callback& callback) {
+  return Watch(path, type, TimeDelta(), callback);
+}
+
+}  // namespace base
@@ -6,10 +6,17 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdint.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "base/files/file_util.h"
 #include "base/logging.h"
 //#include "base/metrics/histogram_functions.h"
 #include "base/posix/eintr_wrapper.h"
@@ -109,6 +116,45 @@ File::Error CallFcntlFlock(PlatformFile file, bool do_lock) {
 }
 #endif  // defined(OS_NACL)
 
+// Returns the total size of |count| |buffers|, or -1 if it doesn't fit in an
+// int.
+int GetIOVecSize(const iovec* buffers, int count) {
+  size_t size = 0;
+  for (int i = 0; i < count; ++i) {
+    size += buffers[i].iov_len;
+    if (size > static_cast<size_t>(std::numeric_limits<int>::max()))
+      return -1;
+  }
+  return static_cast<int>(size);
+}
+
+// Calls |transfer|, a readv()-like function which is also given the number of
+// bytes transferred so far, until the |size| bytes of |buffers| have been
+// transferred, EOF is reached or an error occurs. The buffers are only copied
+// when a transfer stops in the middle of one of them. Returns the number of
+// bytes transferred if any, or the result of the last call.
+template <typename TransferFunction>
+int TransferAllV(const iovec* buffers,
+                 int count,
+                 int size,
+                 TransferFunction transfer) {
+  std::vector<iovec> remaining;
+  int bytes_transferred = 0;
+  ssize_t rv = 0;
+  while (bytes_transferred < size) {
+    rv = HANDLE_EINTR(
+        transfer(buffers, std::min(count, IOV_MAX), bytes_transferred));
+    if (rv <= 0)
+      break;
+
+    bytes_transferred += static_cast<int>(rv);
+    internal::AdvanceIOVecs(static_cast<size_t>(rv), &buffers, &count,
+                            &remaining);
+  }
+
+  return bytes_transferred ? bytes_transferred : static_cast<int>(rv);
+}
+
 }  // namespace
 
 void File::Info::FromStat(const stat_wrapper_t& stat_info) {
@@ -329,6 +375,73 @@ int File::WriteAtCurrentPosNoBestEffort(const char* data, int size) {
   return HANDLE_EINTR(write(file_.get(), data, size));
 }
 
+int File::ReadV(const iovec* buffers, int count) {
+  AssertBlockingAllowed();
+  DCHECK(IsValid());
+  const int size = GetIOVecSize(buffers, count);
+  if (size < 0)
+    return -1;
+
+  SCOPED_FILE_TRACE_WITH_SIZE("ReadV", size);
+  const int fd = file_.get();
+  return TransferAllV(buffers, count, size,
+                      [fd](const iovec* iov, int iovcnt, int bytes_read) {
+                        return readv(fd, iov, iovcnt);
+                      });
+}
+
+int File::WriteV(const iovec* buffers, int count) {
+  AssertBlockingAllowed();
+  DCHECK(IsValid());
+  const int size = GetIOVecSize(buffers, count);
+  if (size < 0)
+    return -1;
+
+  SCOPED_FILE_TRACE_WITH_SIZE("WriteV", size);
+  const int fd = file_.get();
+  return TransferAllV(buffers, count, size,
+                      [fd](const iovec* iov, int iovcnt, int bytes_written) {
+                        return writev(fd, iov, iovcnt);
+                      });
+}
+
+int File::PreadV(int64_t offset, const iovec* buffers, int count) {
+  AssertBlockingAllowed();
+  DCHECK(IsValid());
+  const int size = GetIOVecSize(buffers, count);
+  if (size < 0)
+    return -1;
+
+  SCOPED_FILE_TRACE_WITH_SIZE("PreadV", size);
+  const int fd = file_.get();
+  return TransferAllV(buffers, count, size,
+                      [fd, offset](const iovec* iov, int iovcnt,
+                                   int bytes_read) {
+                        return preadv(fd, iov, iovcnt, offset + bytes_read);
+                      });
+}
+
+int File::PwriteV(int64_t offset, const iovec* buffers, int count) {
+  AssertBlockingAllowed();
+
+  if (IsOpenAppend(file_.get()))
+    return WriteV(buffers, count);
+
+  DCHECK(IsValid());
+  const int size = GetIOVecSize(buffers, count);
+  if (size < 0)
+    return -1;
+
+  SCOPED_FILE_TRACE_WITH_SIZE("PwriteV", size);
+  const int fd = file_.get();
+  return TransferAllV(buffers, count, size,
+                      [fd, offset](const iovec* iov, int iovcnt,
+                                   int bytes_written) {
+                        return pwritev(fd, iov, iovcnt,
+                                       offset + bytes_written);
+                      });
+}
+
 int64_t File::GetLength() {
   DCHECK(IsValid());
 
@@ -8,10 +8,13 @@
 #include <io.h>
 #endif
 #include <stdio.h>
+#include <string.h>
 
-#include <fstream>
+#include <algorithm>
 #include <limits>
+#include <memory>
 
+#include "base/bind.h"
 #include "base/files/file_enumerator.h"
 #include "base/files/file_path.h"
 #include "base/logging.h"
@@ -21,6 +24,23 @@
 #include "base/strings/utf_string_conversions.h"
 #include "build/build_config.h"
 
+#if defined(ARCH_CPU_X86_FAMILY) && defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(ARCH_CPU_X86_FAMILY) && defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(ARCH_CPU_ARM64)
+#include <arm_neon.h>
+#endif
+
+#if defined(OS_POSIX) || defined(OS_FUCHSIA)
+#include <sys/stat.h>
+
+#include <atomic>
+#include <vector>
+
+#include "base/files/parallel_file_enumerator.h"
+#endif
+
 namespace base {
 
 #if !defined(OS_NACL_NONSFI)
@@ -33,14 +53,238 @@ namespace {
 // Also used by code that cleans up said files.
 static const int kMaxUniqueFiles = 100;
 
+#if defined(OS_POSIX) || defined(OS_FUCHSIA)
+// Number of threads ComputeDirectorySize() stats files on, to keep several
+// requests in flight on SSDs and network filesystems.
+constexpr int kComputeDirectorySizeThreads = 8;
+#endif
+
+// Upper bound of the blocks ContentsEqual() and TextContentsEqual() read:
+// large reads keep the number of system calls low on big files.
+constexpr int kMaxCompareBlockSize = 1 << 20;
+
+// Returns whether |file1| and |file2| are the same file.
+bool IsSameFile(const File& file1, const File& file2) {
+#if defined(OS_POSIX) || defined(OS_FUCHSIA)
+  struct stat info1;
+  struct stat info2;
+  return fstat(file1.GetPlatformFile(), &info1) == 0 &&
+         fstat(file2.GetPlatformFile(), &info2) == 0 &&
+         info1.st_dev == info2.st_dev && info1.st_ino == info2.st_ino;
+#else
+  return false;
+#endif
+}
+
+// Returns the size of |file| if it's a regular file, whose size is reliable
+// unlike that of e.g. procfs files, or -1.
+int64_t GetRegularFileSize(const File& file) {
+#if defined(OS_POSIX) || defined(OS_FUCHSIA)
+  struct stat info;
+  if (fstat(file.GetPlatformFile(), &info) == 0 && S_ISREG(info.st_mode))
+    return info.st_size;
+#endif
+  return -1;
+}
+
+// Returns the size of the blocks to compare files of |size1| and |size2|
+// bytes in, which are -1 if unknown. Small files get small buffers.
+int GetCompareBlockSize(int64_t size1, int64_t size2) {
+  if (size1 < 0 || size2 < 0)
+    return kMaxCompareBlockSize;
+  // One more byte finds the end of the file with the first read.
+  return static_cast<int>(std::min<int64_t>(std::max(size1, size2) + 1,
+                                            kMaxCompareBlockSize));
+}
+
+// Returns whether the |size| bytes at |data1| and |data2| are equal. Unlike
+// memcmp(), there's no need to find the first difference, so the vector
+// loops merge the differences of 64 bytes and test them with one branch.
+bool BlocksEqual(const char* data1, const char* data2, size_t size) {
+  size_t i = 0;
+#if defined(ARCH_CPU_X86_FAMILY) && defined(__AVX2__)
+  for (; i + 64 <= size; i += 64) {
+    const __m256i* block1 = reinterpret_cast<const __m256i*>(data1 + i);
+    const __m256i* block2 = reinterpret_cast<const __m256i*>(data2 + i);
+    const __m256i diff = _mm256_or_si256(
+        _mm256_xor_si256(_mm256_loadu_si256(block1),
+                         _mm256_loadu_si256(block2)),
+        _mm256_xor_si256(_mm256_loadu_si256(block1 + 1),
+                         _mm256_loadu_si256(block2 + 1)));
+    if (!_mm256_testz_si256(diff, diff))
+      return false;
+  }
+#elif defined(ARCH_CPU_X86_FAMILY) && defined(__SSE2__)
+  for (; i + 64 <= size; i += 64) {
+    const __m128i* block1 = reinterpret_cast<const __m128i*>(data1 + i);
+    const __m128i* block2 = reinterpret_cast<const __m128i*>(data2 + i);
+    __m128i diff = _mm_setzero_si128();
+    for (int j = 0; j < 4; ++j) {
+      diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128(block1 + j),
+                                              _mm_loadu_si128(block2 + j)));
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) !=
+        0xFFFF) {
+      return false;
+    }
+  }
+#elif defined(ARCH_CPU_ARM64)
+  for (; i + 64 <= size; i += 64) {
+    const uint8_t* block1 = reinterpret_cast<const uint8_t*>(data1 + i);
+    const uint8_t* block2 = reinterpret_cast<const uint8_t*>(data2 + i);
+    uint8x16_t diff = vdupq_n_u8(0);
+    for (int j = 0; j < 64; j += 16) {
+      diff = vorrq_u8(diff,
+                      veorq_u8(vld1q_u8(block1 + j), vld1q_u8(block2 + j)));
+    }
+    if (vmaxvq_u8(diff))
+      return false;
+  }
+#endif
+  return memcmp(data1 + i, data2 + i, size - i) == 0;
+}
+
+// Reads a text file for TextContentsEqual(), with the line endings
+// normalized: like trimming the lines read by std::getline(), every run of
+// '\r' ending a line or the file is dropped. Normalizing whole blocks rather
+// than lines avoids allocations, and memchr() skips the stretches without
+// '\r', i.e. usually everything, a vector at a time.
+class NormalizedTextReader {
+ public:
+  NormalizedTextReader(File* file, int block_size)
+      : file_(file),
+        block_size_(block_size),
+        raw_(new char[block_size]),
+        normalized_(new char[block_size]) {}
+
+  // The normalized data not consumed yet.
+  const char* data() const { return normalized_.get() + begin_; }
+  size_t size() const { return end_ - begin_; }
+
+  void Consume(size_t size) {
+    DCHECK_LE(size, this->size());
+    begin_ += size;
+  }
+
+  // Normalizes more data once all of it is consumed. Returns false on read
+  // errors. size() stays 0 at the end of the file.
+  bool Fill() {
+    DCHECK_EQ(begin_, end_);
+    begin_ = end_ = 0;
+    while (!end_) {
+      if (raw_begin_ == raw_end_) {
+        const int bytes_read = file_->ReadAtCurrentPos(raw_.get(), block_size_);
+        if (bytes_read < 0)
+          return false;
+        // A run of '\r' ending the file is dropped.
+        if (bytes_read == 0)
+          return true;
+        raw_begin_ = 0;
+        raw_end_ = bytes_read;
+      }
+      Normalize();
+    }
+    return true;
+  }
+
+ private:
+  // Moves the rest of |raw_| to |normalized_|. A run of '\r' reaching the
+  // end of |raw_| is counted in |pending_cr_| until the next block tells
+  // whether it ends a line.
+  void Normalize() {
+    const char* p = raw_.get() + raw_begin_;
+    const char* const raw_end = raw_.get() + raw_end_;
+    if (pending_cr_) {
+      const char* run_end = SkipCarriageReturns(p, raw_end);
+      pending_cr_ += run_end - p;
+      p = run_end;
+      raw_begin_ = p - raw_.get();
+      if (p == raw_end)
+        return;
+      if (*p == '\n') {
+        pending_cr_ = 0;
+      } else {
+        // The run is data, which may not fit in one block.
+        end_ = std::min<size_t>(pending_cr_, block_size_);
+        memset(normalized_.get(), '\r', end_);
+        pending_cr_ -= end_;
+        return;
+      }
+    }
+
+    char* out = normalized_.get();
+    while (p < raw_end) {
+      const char* cr =
+          static_cast<const char*>(memchr(p, '\r', raw_end - p));
+      if (!cr)
+        cr = raw_end;
+      memcpy(out + end_, p, cr - p);
+      end_ += cr - p;
+      if (cr == raw_end)
+        break;
+      const char* run_end = SkipCarriageReturns(cr, raw_end);
+      if (run_end == raw_end) {
+        pending_cr_ = run_end - cr;
+        break;
+      }
+      if (*run_end != '\n') {
+        memcpy(out + end_, cr, run_end - cr);
+        end_ += run_end - cr;
+      }
+      p = run_end;
+    }
+    raw_begin_ = raw_end_;
+  }
+
+  static const char* SkipCarriageReturns(const char* p, const char* end) {
+    while (p < end && *p == '\r')
+      ++p;
+    return p;
+  }
+
+  File* const file_;
+  const int block_size_;
+
+  // The last block read, of which |raw_begin_| to |raw_end_| isn't
+  // normalized yet.
+  std::unique_ptr<char[]> raw_;
+  size_t raw_begin_ = 0;
+  size_t raw_end_ = 0;
+  // Length of the run of '\r' ending the data normalized so far.
+  uint64_t pending_cr_ = 0;
+
+  std::unique_ptr<char[]> normalized_;
+  size_t begin_ = 0;
+  size_t end_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(NormalizedTextReader);
+};
+
 }  // namespace
 
 int64_t ComputeDirectorySize(const FilePath& root_path) {
+#if defined(OS_POSIX) || defined(OS_FUCHSIA)
+  std::atomic<int64_t> running_size(0);
+  ParallelFileEnumerator enumerator(root_path, FileEnumerator::FILES,
+                                    ParallelFileEnumerator::FIELD_SIZE,
+                                    kComputeDirectorySizeThreads);
+  enumerator.Run(BindRepeating(
+      [](std::atomic<int64_t>* running_size,
+         const std::vector<ParallelFileEnumerator::Entry>& entries) {
+        int64_t size = 0;
+        for (const ParallelFileEnumerator::Entry& entry : entries)
+          size += entry.size;
+        running_size->fetch_add(size, std::memory_order_relaxed);
+      },
+      &running_size));
+  return running_size.load(std::memory_order_relaxed);
+#else
   int64_t running_size = 0;
   FileEnumerator file_iter(root_path, true, FileEnumerator::FILES);
   while (!file_iter.Next().empty())
     running_size += file_iter.GetInfo().GetSize();
   return running_size;
+#endif
 }
 
 bool Move(const FilePath& from_path, const FilePath& to_path) {
@@ -50,77 +294,67 @@ bool Move(const FilePath& from_path, const FilePath& to_path) {
 }
 
 bool ContentsEqual(const FilePath& filename1, const FilePath& filename2) {
-  // We open the file in binary format even if they are text files because
-  // we are just comparing that bytes are exactly same in both files and not
-  // doing anything smart with text formatting.
-  std::ifstream file1(filename1.value().c_str(),
-                      std::ios::in | std::ios::binary);
-  std::ifstream file2(filename2.value().c_str(),
-                      std::ios::in | std::ios::binary);
+  File file1(filename1, File::FLAG_OPEN | File::FLAG_READ);
+  File file2(filename2, File::FLAG_OPEN | File::FLAG_READ);
 
   // Even if both files aren't openable (and thus, in some sense, "equal"),
   // any unusable file yields a result of "false".
-  if (!file1.is_open() || !file2.is_open())
+  if (!file1.IsValid() || !file2.IsValid())
     return false;
 
-  const int BUFFER_SIZE = 2056;
-  char buffer1[BUFFER_SIZE], buffer2[BUFFER_SIZE];
-  do {
-    file1.read(buffer1, BUFFER_SIZE);
-    file2.read(buffer2, BUFFER_SIZE);
-
-    if ((file1.eof() != file2.eof()) ||
-        (file1.gcount() != file2.gcount()) ||
-        (memcmp(buffer1, buffer2, static_cast<size_t>(file1.gcount())))) {
-      file1.close();
-      file2.close();
-      return false;
-    }
-  } while (!file1.eof() || !file2.eof());
+  if (IsSameFile(file1, file2))
+    return true;
+  const int64_t size1 = GetRegularFileSize(file1);
+  const int64_t size2 = GetRegularFileSize(file2);
+  if (size1 >= 0 && size2 >= 0 && size1 != size2)
+    return false;
 
-  file1.close();
-  file2.close();
-  return true;
+  const int block_size = GetCompareBlockSize(size1, size2);
+  std::unique_ptr<char[]> buffer1(new char[block_size]);
+  std::unique_ptr<char[]> buffer2(new char[block_size]);
+  for (;;) {
+    const int bytes_read1 = file1.ReadAtCurrentPos(buffer1.get(), block_size);
+    const int bytes_read2 = file2.ReadAtCurrentPos(buffer2.get(), block_size);
+    if (bytes_read1 < 0 || bytes_read1 != bytes_read2)
+      return false;
+    if (bytes_read1 == 0)
+      return true;
+    if (!BlocksEqual(buffer1.get(), buffer2.get(), bytes_read1))
+      return false;
+  }
 }
 
 bool TextContentsEqual(const FilePath& filename1, const FilePath& filename2) {
-  std::ifstream file1(filename1.value().c_str(), std::ios::in);
-  std::ifstream file2(filename2.value().c_str(), std::ios::in);
+  File file1(filename1, File::FLAG_OPEN | File::FLAG_READ);
+  File file2(filename2, File::FLAG_OPEN | File::FLAG_READ);
 
   // Even if both files aren't openable (and thus, in some sense, "equal"),
   // any unusable file yields a result of "false".
-  if (!file1.is_open() || !file2.is_open())
+  if (!file1.IsValid() || !file2.IsValid())
     return false;
 
-  do {
-    std::string line1, line2;
-    getline(file1, line1);
-    getline(file2, line2);
+  if (IsSameFile(file1, file2))
+    return true;
 
-    // Check for mismatched EOF states, or any error state.
-    if ((file1.eof() != file2.eof()) ||
-        file1.bad() || file2.bad()) {
+  // Line endings make the sizes of equal text files differ, so the data is
+  // compared as far as both readers have normalized it.
+  const int block_size =
+      GetCompareBlockSize(GetRegularFileSize(file1), GetRegularFileSize(file2));
+  NormalizedTextReader reader1(&file1, block_size);
+  NormalizedTextReader reader2(&file2, block_size);
+  for (;;) {
+    if (!reader1.size() && !reader1.Fill())
       return false;
-    }
-
-    // Trim all '\r' and '\n' characters from the end of the line.
-    std::string::size_type end1 = line1.find_last_not_of("\r\n");
-    if (end1 == std::string::npos)
-      line1.clear();
-    else if (end1 + 1 < line1.length())
-      line1.erase(end1 + 1);
-
-    std::string::size_type end2 = line2.find_last_not_of("\r\n");
-    if (end2 == std::string::npos)
-      line2.clear();
-    else if (end2 + 1 < line2.length())
-      line2.erase(end2 + 1);
-
-    if (line1 != line2)
+    if (!reader2.size() && !reader2.Fill())
       return false;
-  } while (!file1.eof() || !file2.eof());
-
-  return true;
+    const size_t size = std::min(reader1.size(), reader2.size());
+    if (!size)
+      return reader1.size() == reader2.size();
+    if (!BlocksEqual(reader1.data(), reader2.data(), size))
+      return false;
+    reader1.Consume(size);
+    reader2.Consume(size);
+  }
 }
 #endif  // !defined(OS_NACL_NONSFI)
 
@@ -131,56 +365,62 @@ bool ReadFileToStringWithMaxSize(const FilePath& path,
     contents->clear();
   if (path.ReferencesParent())
     return false;
-  FILE* file = OpenFile(path, "rb");
-  if (!file) {
+  File file(path, File::FLAG_OPEN | File::FLAG_READ);
+  if (!file.IsValid())
     return false;
-  }
 
   // Many files supplied in |path| have incorrect size (proc files etc).
-  // Hence, the file is read sequentially as opposed to a one-shot read, using
-  // file size as a hint for chunk size if available.
-  constexpr int64_t kDefaultChunkSize = 1 << 16;
-  int64_t chunk_size;
-#if !defined(OS_NACL_NONSFI)
-  if (!GetFileSize(path, &chunk_size) || chunk_size <= 0)
-    chunk_size = kDefaultChunkSize - 1;
-  // We need to attempt to read at EOF for feof flag to be set so here we
-  // use |chunk_size| + 1.
-  chunk_size = std::min<uint64_t>(chunk_size, max_size) + 1;
-#else
-  chunk_size = kDefaultChunkSize;
-#endif  // !defined(OS_NACL_NONSFI)
-  size_t bytes_read_this_pass;
+  // Hence, the file is read until EOF as opposed to a one-shot read, using the
+  // file size as a hint for the size of the first read if available: one
+  // allocation and one large read then get the whole file. One more byte is
+  // asked for to find out whether the file grew.
+  constexpr size_t kDefaultChunkSize = 1 << 16;
+  // Bounds single reads, which take an int.
+  constexpr size_t kMaxChunkSize = 1 << 30;
+  size_t chunk_size = kDefaultChunkSize;
+  File::Info info;
+  if (file.GetInfo(&info) && !info.is_directory && info.size > 0) {
+    chunk_size = std::min<uint64_t>(info.size, max_size) + 1;
+    chunk_size = std::min(chunk_size, kMaxChunkSize);
+  }
+
   size_t bytes_read_so_far = 0;
   bool read_status = true;
-  std::string local_contents;
-  local_contents.resize(chunk_size);
-
-  while ((bytes_read_this_pass = fread(&local_contents[bytes_read_so_far], 1,
-                                       chunk_size, file)) > 0) {
-    if ((max_size - bytes_read_so_far) < bytes_read_this_pass) {
+  bool buffer_grown = false;
+  std::string local_contents(chunk_size, '\0');
+  for (;;) {
+    // Reads into what is left of the buffer first, so that the file read
+    // whole with the size hint only needs a one byte read to find EOF.
+    if (bytes_read_so_far == local_contents.size()) {
+      local_contents.resize(bytes_read_so_far + chunk_size);
+      buffer_grown = true;
+    }
+    const int bytes_read = file.ReadAtCurrentPosNoBestEffort(
+        &local_contents[bytes_read_so_far],
+        static_cast<int>(local_contents.size() - bytes_read_so_far));
+    if (bytes_read < 0) {
+      read_status = false;
+      break;
+    }
+    if (bytes_read == 0)
+      break;
+    if ((max_size - bytes_read_so_far) < static_cast<size_t>(bytes_read)) {
       // Read more than max_size bytes, bail out.
       bytes_read_so_far = max_size;
       read_status = false;
       break;
     }
-    // In case EOF was not reached, iterate again but revert to the default
-    // chunk size.
-    if (bytes_read_so_far == 0)
-      chunk_size = kDefaultChunkSize;
-
-    bytes_read_so_far += bytes_read_this_pass;
-    // Last fread syscall (after EOF) can be avoided via feof, which is just a
-    // flag check.
-    if (feof(file))
-      break;
-    local_contents.resize(bytes_read_so_far + chunk_size);
+    bytes_read_so_far += bytes_read;
+    // Grow geometrically if the file turned out larger than its size hint.
+    chunk_size = std::min(std::max(chunk_size, bytes_read_so_far),
+                          kMaxChunkSize);
   }
-  read_status = read_status && !ferror(file);
-  CloseFile(file);
   if (contents) {
     contents->swap(local_contents);
     contents->resize(bytes_read_so_far);
+    // Only a file which grew past its size hint leaves much unused capacity.
+    if (buffer_grown)
+      contents->shrink_to_fit();
   }
 
   return read_status;
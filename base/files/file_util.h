@@ -18,12 +18,15 @@
 
 #if defined(OS_POSIX) || defined(OS_FUCHSIA)
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #endif
 
 #include "base/base_export.h"
+#include "base/callback.h"
 #include "base/files/file.h"
 #include "base/files/file_path.h"
+#include "base/memory/scoped_refptr.h"
 #include "base/strings/string16.h"
 #include "build/build_config.h"
 
@@ -38,6 +41,7 @@
 namespace base {
 
 class Environment;
+class FileContentsBuffer;
 class Time;
 
 //-----------------------------------------------------------------------------
@@ -51,8 +55,8 @@ BASE_EXPORT FilePath MakeAbsoluteFilePath(const FilePath& input);
 // Returns the total number of bytes used by all the files under |root_path|.
 // If the path does not exist the function returns 0.
 //
-// This function is implemented using the FileEnumerator class so it is not
-// particularly speedy in any platform.
+// On POSIX this walks the tree on several threads with ParallelFileEnumerator.
+// Elsewhere it uses the FileEnumerator class so it is not particularly speedy.
 BASE_EXPORT int64_t ComputeDirectorySize(const FilePath& root_path);
 
 // Deletes the given path, whether it's a file or a directory.
@@ -117,6 +121,36 @@ BASE_EXPORT bool ReplaceFile(const FilePath& from_path,
 //   read permissions. i.e. Always 0644.
 BASE_EXPORT bool CopyFile(const FilePath& from_path, const FilePath& to_path);
 
+#if defined(OS_POSIX) || defined(OS_FUCHSIA)
+// Options for CopyFileWithOptions() and CopyDirectoryWithOptions().
+struct BASE_EXPORT CopyOptions {
+  CopyOptions();
+  CopyOptions(const CopyOptions& other);
+  ~CopyOptions();
+
+  // If set, runs as the copy progresses with the number of bytes copied so
+  // far by the whole operation. With parallel copies it runs on the copying
+  // threads, one call at a time.
+  RepeatingCallback<void(int64_t bytes_copied)> progress_callback;
+
+  // Maximum number of files CopyDirectoryWithOptions() copies concurrently,
+  // each on its own thread. 1 copies everything on the calling thread.
+  int max_parallel_copies = 1;
+};
+#endif
+
+#if (defined(OS_POSIX) || defined(OS_FUCHSIA)) && !defined(OS_MACOSX)
+// Same as CopyFile() with |options|.
+//
+// On Linux and Android the data is copied without going through userspace if
+// possible: by sharing extents on filesystems supporting reflinks (FICLONE),
+// else with copy_file_range() or sendfile(), falling back to read() and
+// write().
+BASE_EXPORT bool CopyFileWithOptions(const FilePath& from_path,
+                                     const FilePath& to_path,
+                                     const CopyOptions& options);
+#endif
+
 // Copies the given path, and optionally all subdirectories and their contents
 // as well.
 //
@@ -130,6 +164,16 @@ BASE_EXPORT bool CopyDirectory(const FilePath& from_path,
                                const FilePath& to_path,
                                bool recursive);
 
+#if defined(OS_POSIX) || defined(OS_FUCHSIA)
+// Same as CopyDirectory() with |options|. Directories are created on the
+// calling thread before the files are copied, in parallel if requested. If a
+// copy fails the remaining ones are skipped.
+BASE_EXPORT bool CopyDirectoryWithOptions(const FilePath& from_path,
+                                          const FilePath& to_path,
+                                          bool recursive,
+                                          const CopyOptions& options);
+#endif
+
 // Like CopyDirectory() except trying to overwrite an existing file will not
 // work and will return false.
 BASE_EXPORT bool CopyDirectoryExcl(const FilePath& from_path,
@@ -180,6 +224,15 @@ BASE_EXPORT bool ReadFileToStringWithMaxSize(const FilePath& path,
 
 #if defined(OS_POSIX) || defined(OS_FUCHSIA)
 
+// Reads the file at |path| into a FileContentsBuffer, to be parsed without
+// copying the data again. Regular files of 1 MiB or more are mapped rather
+// than read; as with any MemoryMappedFile, truncating such a file while the
+// buffer is alive crashes its readers. Other files are read with a single
+// read() into a page-aligned buffer when their size is known. Returns null
+// on error, or if |path| contains path traversal components ('..').
+BASE_EXPORT scoped_refptr<FileContentsBuffer> ReadFileToBuffer(
+    const FilePath& path);
+
 // Read exactly |bytes| bytes from file descriptor |fd|, storing the result
 // in |buffer|. This function is protected against EINTR and partial reads.
 // Returns true iff |bytes| bytes have been successfully read from |fd|.
@@ -375,6 +428,13 @@ BASE_EXPORT int WriteFile(const FilePath& filename, const char* data,
 // Appends |data| to |fd|. Does not close |fd| when done.  Returns true iff
 // |size| bytes of |data| were written to |fd|.
 BASE_EXPORT bool WriteFileDescriptor(const int fd, const char* data, int size);
+
+// Appends the |count| |buffers| to |fd| with as few writev() calls as
+// possible. Does not close |fd| when done. Returns true iff all of the buffers
+// were written to |fd|.
+BASE_EXPORT bool WriteFileDescriptorV(const int fd,
+                                      const iovec* buffers,
+                                      int count);
 #endif
 
 // Appends |data| to |filename|.  Returns true iff |size| bytes of |data| were
@@ -383,6 +443,15 @@ BASE_EXPORT bool AppendToFile(const FilePath& filename,
                               const char* data,
                               int size);
 
+#if defined(OS_POSIX) || defined(OS_FUCHSIA)
+// Appends the |count| |buffers| to |filename|, e.g. a record header, payload
+// and trailer without concatenating them first. Returns true iff all of the
+// buffers were written to |filename|.
+BASE_EXPORT bool AppendToFileV(const FilePath& filename,
+                               const iovec* buffers,
+                               int count);
+#endif
+
 // Gets the current working directory for the process.
 BASE_EXPORT bool GetCurrentDirectory(FilePath* path);
 
@@ -492,6 +561,17 @@ BASE_EXPORT bool CopyAndDeleteDirectory(const FilePath& from_path,
                                         const FilePath& to_path);
 #endif  // defined(OS_WIN)
 
+#if defined(OS_POSIX) || defined(OS_FUCHSIA)
+// Advances |*buffers| and |*count| past the first |bytes| bytes of the
+// buffers, to resume a readv()/writev() which transferred only these. A buffer
+// transferred partially is adjusted in |*remaining|, where the buffers are
+// copied the first time, so that the caller's array is left untouched.
+BASE_EXPORT void AdvanceIOVecs(size_t bytes,
+                               const iovec** buffers,
+                               int* count,
+                               std::vector<iovec>* remaining);
+#endif
+
 }  // namespace internal
 }  // namespace base
 
@@ -13,20 +13,30 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/param.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
 #include "base/base_switches.h"
 #include "base/command_line.h"
 #include "base/containers/stack.h"
 #include "base/environment.h"
+#include "base/files/file_contents_buffer.h"
 #include "base/files/file_enumerator.h"
 #include "base/files/file_path.h"
+#include "base/files/memory_mapped_file.h"
 #include "base/files/scoped_file.h"
 #include "base/logging.h"
 #include "base/macros.h"
@@ -39,7 +49,9 @@
 #include "base/strings/stringprintf.h"
 #include "base/strings/sys_string_conversions.h"
 #include "base/strings/utf_string_conversions.h"
+#include "base/synchronization/lock.h"
 //#include "base/sys_info.h"
+#include "base/threading/platform_thread.h"
 #include "base/threading/thread_restrictions.h"
 #include "base/time/time.h"
 #include "build/build_config.h"
@@ -54,6 +66,12 @@
 #include "base/os_compat_android.h"
 #endif
 
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include <linux/fs.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#endif
+
 #if !defined(OS_IOS)
 #include <grp.h>
 #endif
@@ -151,7 +169,146 @@ bool AdvanceEnumeratorWithStat(FileEnumerator* traversal,
   return true;
 }
 
-bool CopyFileContents(File* infile, File* outfile) {
+// Accumulates the bytes copied by a CopyFileWithOptions() or
+// CopyDirectoryWithOptions() call and reports them to its progress callback.
+class CopyProgress {
+ public:
+  explicit CopyProgress(const CopyOptions& options)
+      : callback_(options.progress_callback) {}
+
+  // Accounts for |bytes| more bytes copied.
+  void Add(int64_t bytes) {
+    if (callback_.is_null() || bytes == 0)
+      return;
+    AutoLock auto_lock(lock_);
+    bytes_copied_ += bytes;
+    callback_.Run(bytes_copied_);
+  }
+
+ private:
+  const RepeatingCallback<void(int64_t)> callback_;
+
+  // Serializes the callback runs of parallel copies.
+  Lock lock_;
+  int64_t bytes_copied_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(CopyProgress);
+};
+
+// Regular files at least this large are mapped by ReadFileToBuffer().
+constexpr int64_t kReadFileToBufferMapThreshold = 1024 * 1024;
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+// Size of the chunks copied by each copy_file_range() or sendfile() call,
+// bounding how long the progress callback stays silent.
+constexpr size_t kKernelCopyChunkSize = 16 * 1024 * 1024;
+
+enum class KernelCopyResult {
+  kDone,
+  kFailed,
+  // The files can't be copied this way. The file positions are left after
+  // what was copied, so that another method can finish the copy.
+  kUnsupported,
+};
+
+// Whether |error| from copy_file_range(), sendfile() or FICLONE means that
+// the files can't be copied this way, rather than an I/O error.
+bool IsUnsupportedKernelCopyError(int error) {
+  return error == ENOSYS || error == EXDEV || error == EINVAL ||
+         error == EOPNOTSUPP || error == ENOTSUP || error == EPERM ||
+         error == EBADF || error == ETXTBSY;
+}
+
+// Makes |outfile|, which must be empty, share the extents of |infile| on
+// filesystems supporting reflinks (e.g. btrfs and XFS). Nothing is copied
+// until either file is modified.
+KernelCopyResult CloneFile(File* infile,
+                           File* outfile,
+                           CopyProgress* progress) {
+  if (ioctl(outfile->GetPlatformFile(), FICLONE, infile->GetPlatformFile()) <
+      0) {
+    return IsUnsupportedKernelCopyError(errno) ? KernelCopyResult::kUnsupported
+                                               : KernelCopyResult::kFailed;
+  }
+  // Like the other methods, leave |outfile| positioned after the data.
+  const int64_t length = outfile->GetLength();
+  if (length < 0 || outfile->Seek(File::FROM_END, 0) < 0)
+    return KernelCopyResult::kFailed;
+  progress->Add(length);
+  return KernelCopyResult::kDone;
+}
+
+// Copies the rest of |infile| to |outfile| with |copy|, a function moving up
+// to |size| bytes from |in_fd| to |out_fd| at their current positions, like
+// copy_file_range() and sendfile(). Kernels return 0 rather than an error for
+// some files they can't copy (e.g. from procfs), so a copy which ends before
+// moving any data is reported as unsupported to retry it with read().
+template <typename CopyFunction>
+KernelCopyResult CopyFileInKernel(File* infile,
+                                  File* outfile,
+                                  CopyProgress* progress,
+                                  CopyFunction copy) {
+  const int in_fd = infile->GetPlatformFile();
+  const int out_fd = outfile->GetPlatformFile();
+  bool copied_any = false;
+  for (;;) {
+    const ssize_t bytes_copied =
+        HANDLE_EINTR(copy(in_fd, out_fd, kKernelCopyChunkSize));
+    if (bytes_copied < 0) {
+      return IsUnsupportedKernelCopyError(errno)
+                 ? KernelCopyResult::kUnsupported
+                 : KernelCopyResult::kFailed;
+    }
+    if (bytes_copied == 0) {
+      return copied_any ? KernelCopyResult::kDone
+                        : KernelCopyResult::kUnsupported;
+    }
+    copied_any = true;
+    progress->Add(bytes_copied);
+  }
+}
+
+// Tries to copy |infile| to |outfile| without going through userspace.
+KernelCopyResult CopyFileContentsInKernel(File* infile,
+                                          File* outfile,
+                                          CopyProgress* progress) {
+  // A reflink is the cheapest by far and fails right away where unsupported,
+  // so it goes first.
+  KernelCopyResult result = CloneFile(infile, outfile, progress);
+  if (result != KernelCopyResult::kUnsupported)
+    return result;
+
+#if defined(__NR_copy_file_range)
+  // Called through syscall() since older C libraries lack a wrapper.
+  result = CopyFileInKernel(
+      infile, outfile, progress, [](int in_fd, int out_fd, size_t size) {
+        return static_cast<ssize_t>(syscall(__NR_copy_file_range, in_fd,
+                                            nullptr, out_fd, nullptr, size,
+                                            0u));
+      });
+  if (result != KernelCopyResult::kUnsupported)
+    return result;
+#endif
+
+  return CopyFileInKernel(infile, outfile, progress,
+                          [](int in_fd, int out_fd, size_t size) {
+                            return sendfile(out_fd, in_fd, nullptr, size);
+                          });
+}
+#endif  // defined(OS_LINUX) || defined(OS_ANDROID)
+
+bool CopyFileContents(File* infile, File* outfile, CopyProgress* progress) {
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  switch (CopyFileContentsInKernel(infile, outfile, progress)) {
+    case KernelCopyResult::kDone:
+      return true;
+    case KernelCopyResult::kFailed:
+      return false;
+    case KernelCopyResult::kUnsupported:
+      break;
+  }
+#endif
+
   static constexpr size_t kBufferSize = 32768;
   std::vector<char> buffer(kBufferSize);
 
@@ -171,16 +328,141 @@ bool CopyFileContents(File* infile, File* outfile) {
 
       bytes_written_per_read += bytes_written_partial;
     } while (bytes_written_per_read < bytes_read);
+    progress->Add(bytes_read);
   }
 
   NOTREACHED();
   return false;
 }
 
+// Copies the regular file |from_path| to |target_path| for DoCopyDirectory().
+// Returns false on failure, or true once copied or skipped because
+// |from_path| turned out not to be a regular file.
+bool CopyDirectoryEntry(const FilePath& from_path,
+                        const FilePath& target_path,
+                        bool open_exclusive,
+                        CopyProgress* progress) {
+  // Add O_NONBLOCK so we can't block opening a pipe.
+  File infile(open(from_path.value().c_str(), O_RDONLY | O_NONBLOCK));
+  if (!infile.IsValid()) {
+    DPLOG(ERROR) << "CopyDirectory() couldn't open file: " << from_path.value();
+    return false;
+  }
+
+  struct stat stat_at_use;
+  if (fstat(infile.GetPlatformFile(), &stat_at_use) < 0) {
+    DPLOG(ERROR) << "CopyDirectory() couldn't stat file: " << from_path.value();
+    return false;
+  }
+
+  if (!S_ISREG(stat_at_use.st_mode)) {
+    DLOG(WARNING) << "CopyDirectory() skipping non-regular file: "
+                  << from_path.value();
+    return true;
+  }
+
+  int open_flags = O_WRONLY | O_CREAT;
+  // If |open_exclusive| is set then we should always create the destination
+  // file, so O_NONBLOCK is not necessary to ensure we don't block on the
+  // open call for the target file below, and since the destination will
+  // always be a regular file it wouldn't affect the behavior of the
+  // subsequent write calls anyway.
+  if (open_exclusive)
+    open_flags |= O_EXCL;
+  else
+    open_flags |= O_TRUNC | O_NONBLOCK;
+  // Each platform has different default file opening modes for CopyFile which
+  // we want to replicate here. On OS X, we use copyfile(3) which takes the
+  // source file's permissions into account. On the other platforms, we just
+  // use the base::File constructor. On Chrome OS, base::File uses a different
+  // set of permissions than it does on other POSIX platforms.
+#if defined(OS_MACOSX)
+  int mode = 0600 | (stat_at_use.st_mode & 0177);
+#elif defined(OS_CHROMEOS)
+  int mode = 0644;
+#else
+  int mode = 0600;
+#endif
+  File outfile(open(target_path.value().c_str(), open_flags, mode));
+  if (!outfile.IsValid()) {
+    DPLOG(ERROR) << "CopyDirectory() couldn't create file: "
+                 << target_path.value();
+    return false;
+  }
+
+  if (!CopyFileContents(&infile, &outfile, progress)) {
+    DLOG(ERROR) << "CopyDirectory() couldn't copy file: " << from_path.value();
+    return false;
+  }
+  return true;
+}
+
+// Copies files collected by DoCopyDirectory() on several threads.
+class ParallelFileCopier : public PlatformThread::Delegate {
+ public:
+  ParallelFileCopier(bool open_exclusive, CopyProgress* progress)
+      : open_exclusive_(open_exclusive), progress_(progress) {}
+  ~ParallelFileCopier() override = default;
+
+  void AddFile(FilePath from_path, FilePath target_path) {
+    files_.emplace_back(std::move(from_path), std::move(target_path));
+  }
+
+  // Copies the added files on up to |max_threads| threads, including the
+  // calling one. Returns false if any copy failed.
+  bool Run(int max_threads) {
+    const size_t num_threads =
+        std::min(files_.size(), static_cast<size_t>(max_threads));
+    std::vector<PlatformThreadHandle> threads;
+    for (size_t i = 1; i < num_threads; ++i) {
+      PlatformThreadHandle handle;
+      if (!PlatformThread::Create(0, this, &handle))
+        break;
+      threads.push_back(handle);
+    }
+    ThreadMain();
+    for (PlatformThreadHandle handle : threads)
+      PlatformThread::Join(handle);
+    return !failed_;
+  }
+
+  // PlatformThread::Delegate:
+  void ThreadMain() override {
+    for (;;) {
+      size_t index;
+      {
+        AutoLock auto_lock(lock_);
+        if (failed_ || next_file_ == files_.size())
+          return;
+        index = next_file_++;
+      }
+      if (!CopyDirectoryEntry(files_[index].first, files_[index].second,
+                              open_exclusive_, progress_)) {
+        AutoLock auto_lock(lock_);
+        failed_ = true;
+      }
+    }
+  }
+
+ private:
+  const bool open_exclusive_;
+  CopyProgress* const progress_;
+
+  // Source and target paths. Not modified once the copies started.
+  std::vector<std::pair<FilePath, FilePath>> files_;
+
+  Lock lock_;
+  size_t next_file_ = 0;
+  bool failed_ = false;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelFileCopier);
+};
+
 bool DoCopyDirectory(const FilePath& from_path,
                      const FilePath& to_path,
                      bool recursive,
-                     bool open_exclusive) {
+                     bool open_exclusive,
+                     const CopyOptions& options) {
   AssertBlockingAllowed();
   // Some old callers of CopyDirectory want it to support wildcards.
   // After some discussion, we decided to fix those callers.
@@ -233,6 +515,11 @@ bool DoCopyDirectory(const FilePath& from_path,
   // TODO(maruel): This is not necessary anymore.
   DCHECK(recursive || S_ISDIR(from_stat.st_mode));
 
+  CopyProgress progress(options);
+  // Files are only collected while walking the tree when copied in parallel.
+  const bool parallel = options.max_parallel_copies > 1;
+  ParallelFileCopier parallel_copier(open_exclusive, &progress);
+
   do {
     // current is the source path, including from_path, so append
     // the suffix after from_path to to_path to create the target_path.
@@ -260,61 +547,15 @@ bool DoCopyDirectory(const FilePath& from_path,
       continue;
     }
 
-    // Add O_NONBLOCK so we can't block opening a pipe.
-    File infile(open(current.value().c_str(), O_RDONLY | O_NONBLOCK));
-    if (!infile.IsValid()) {
-      DPLOG(ERROR) << "CopyDirectory() couldn't open file: " << current.value();
-      return false;
-    }
-
-    struct stat stat_at_use;
-    if (fstat(infile.GetPlatformFile(), &stat_at_use) < 0) {
-      DPLOG(ERROR) << "CopyDirectory() couldn't stat file: " << current.value();
-      return false;
-    }
-
-    if (!S_ISREG(stat_at_use.st_mode)) {
-      DLOG(WARNING) << "CopyDirectory() skipping non-regular file: "
-                    << current.value();
-      continue;
-    }
-
-    int open_flags = O_WRONLY | O_CREAT;
-    // If |open_exclusive| is set then we should always create the destination
-    // file, so O_NONBLOCK is not necessary to ensure we don't block on the
-    // open call for the target file below, and since the destination will
-    // always be a regular file it wouldn't affect the behavior of the
-    // subsequent write calls anyway.
-    if (open_exclusive)
-      open_flags |= O_EXCL;
-    else
-      open_flags |= O_TRUNC | O_NONBLOCK;
-    // Each platform has different default file opening modes for CopyFile which
-    // we want to replicate here. On OS X, we use copyfile(3) which takes the
-    // source file's permissions into account. On the other platforms, we just
-    // use the base::File constructor. On Chrome OS, base::File uses a different
-    // set of permissions than it does on other POSIX platforms.
-#if defined(OS_MACOSX)
-    int mode = 0600 | (stat_at_use.st_mode & 0177);
-#elif defined(OS_CHROMEOS)
-    int mode = 0644;
-#else
-    int mode = 0600;
-#endif
-    File outfile(open(target_path.value().c_str(), open_flags, mode));
-    if (!outfile.IsValid()) {
-      DPLOG(ERROR) << "CopyDirectory() couldn't create file: "
-                   << target_path.value();
-      return false;
-    }
-
-    if (!CopyFileContents(&infile, &outfile)) {
-      DLOG(ERROR) << "CopyDirectory() couldn't copy file: " << current.value();
+    if (parallel) {
+      parallel_copier.AddFile(current, target_path);
+    } else if (!CopyDirectoryEntry(current, target_path, open_exclusive,
+                                   &progress)) {
       return false;
     }
   } while (AdvanceEnumeratorWithStat(&traversal, &current, &from_stat));
 
-  return true;
+  return !parallel || parallel_copier.Run(options.max_parallel_copies);
 }
 #endif  // !defined(OS_NACL_NONSFI)
 
@@ -392,16 +633,29 @@ bool ReplaceFile(const FilePath& from_path,
   return false;
 }
 
+CopyOptions::CopyOptions() = default;
+
+CopyOptions::CopyOptions(const CopyOptions& other) = default;
+
+CopyOptions::~CopyOptions() = default;
+
 bool CopyDirectory(const FilePath& from_path,
                    const FilePath& to_path,
                    bool recursive) {
-  return DoCopyDirectory(from_path, to_path, recursive, false);
+  return DoCopyDirectory(from_path, to_path, recursive, false, CopyOptions());
+}
+
+bool CopyDirectoryWithOptions(const FilePath& from_path,
+                              const FilePath& to_path,
+                              bool recursive,
+                              const CopyOptions& options) {
+  return DoCopyDirectory(from_path, to_path, recursive, false, options);
 }
 
 bool CopyDirectoryExcl(const FilePath& from_path,
                        const FilePath& to_path,
                        bool recursive) {
-  return DoCopyDirectory(from_path, to_path, recursive, true);
+  return DoCopyDirectory(from_path, to_path, recursive, true, CopyOptions());
 }
 #endif  // !defined(OS_NACL_NONSFI)
 
@@ -479,6 +733,60 @@ bool DirectoryExists(const FilePath& path) {
   return S_ISDIR(file_info.st_mode);
 }
 
+scoped_refptr<FileContentsBuffer> ReadFileToBuffer(const FilePath& path) {
+  AssertBlockingAllowed();
+  if (path.ReferencesParent())
+    return nullptr;
+  File file(path, File::FLAG_OPEN | File::FLAG_READ);
+  if (!file.IsValid())
+    return nullptr;
+
+  struct stat file_info;
+  if (fstat(file.GetPlatformFile(), &file_info) < 0)
+    return nullptr;
+  const bool is_regular = S_ISREG(file_info.st_mode);
+  const int64_t size = file_info.st_size;
+
+  if (is_regular && size >= kReadFileToBufferMapThreshold) {
+    auto mapping = std::make_unique<MemoryMappedFile>();
+    if (mapping->Initialize(std::move(file)))
+      return FileContentsBuffer::FromMapping(std::move(mapping));
+    // Not all filesystems support mmap(): read the file instead.
+    file.Initialize(path, File::FLAG_OPEN | File::FLAG_READ);
+    if (!file.IsValid())
+      return nullptr;
+  }
+
+  // One more byte is asked for to find out whether the file grew.
+  if (is_regular && size > 0 && size < std::numeric_limits<int>::max()) {
+    scoped_refptr<FileContentsBuffer> buffer =
+        FileContentsBuffer::Allocate(size + 1);
+    if (!buffer)
+      return nullptr;
+    const int bytes_read =
+        file.Read(0, buffer->mutable_data(), static_cast<int>(size + 1));
+    if (bytes_read < 0)
+      return nullptr;
+    if (bytes_read <= size) {
+      buffer->set_size(bytes_read);
+      return buffer;
+    }
+  }
+
+  // The size is unknown (e.g. proc files and pipes) or changed while reading,
+  // so read the file in chunks first.
+  std::string contents;
+  if (!ReadFileToString(path, &contents))
+    return nullptr;
+  scoped_refptr<FileContentsBuffer> buffer =
+      FileContentsBuffer::Allocate(contents.size());
+  if (!buffer)
+    return nullptr;
+  memcpy(buffer->mutable_data(), contents.data(), contents.size());
+  buffer->set_size(contents.size());
+  return buffer;
+}
+
 bool ReadFromFD(int fd, char* buffer, size_t bytes) {
   size_t total_read = 0;
   while (total_read < bytes) {
@@ -856,6 +1164,49 @@ bool WriteFileDescriptor(const int fd, const char* data, int size) {
   return true;
 }
 
+bool WriteFileDescriptorV(const int fd, const iovec* buffers, int count) {
+  // Allow for partial writes. The buffers are only copied when a write stops
+  // in the middle of one of them.
+  std::vector<iovec> remaining;
+  while (count) {
+    ssize_t bytes_written =
+        HANDLE_EINTR(writev(fd, buffers, std::min(count, IOV_MAX)));
+    if (bytes_written < 0)
+      return false;
+
+    internal::AdvanceIOVecs(static_cast<size_t>(bytes_written), &buffers,
+                            &count, &remaining);
+  }
+
+  return true;
+}
+
+namespace internal {
+
+void AdvanceIOVecs(size_t bytes,
+                   const iovec** buffers,
+                   int* count,
+                   std::vector<iovec>* remaining) {
+  while (*count && bytes >= (*buffers)->iov_len) {
+    bytes -= (*buffers)->iov_len;
+    ++*buffers;
+    --*count;
+  }
+  if (!bytes)
+    return;
+
+  DCHECK(*count);
+  if (remaining->empty()) {
+    remaining->assign(*buffers, *buffers + *count);
+    *buffers = remaining->data();
+  }
+  iovec* partial = &(*remaining)[*buffers - remaining->data()];
+  partial->iov_base = static_cast<char*>(partial->iov_base) + bytes;
+  partial->iov_len -= bytes;
+}
+
+}  // namespace internal
+
 #if !defined(OS_NACL_NONSFI)
 
 bool AppendToFile(const FilePath& filename, const char* data, int size) {
@@ -881,6 +1232,28 @@ bool AppendToFile(const FilePath& filename, const char* data, int size) {
   return ret;
 }
 
+bool AppendToFileV(const FilePath& filename, const iovec* buffers, int count) {
+  AssertBlockingAllowed();
+  bool ret = true;
+  int fd = HANDLE_EINTR(open(filename.value().c_str(), O_WRONLY | O_APPEND));
+  if (fd < 0) {
+    VPLOG(1) << "Unable to create file " << filename.value();
+    return false;
+  }
+
+  if (!WriteFileDescriptorV(fd, buffers, count)) {
+    VPLOG(1) << "Error while writing to file " << filename.value();
+    ret = false;
+  }
+
+  if (IGNORE_EINTR(close(fd)) < 0) {
+    VPLOG(1) << "Error while closing file " << filename.value();
+    return false;
+  }
+
+  return ret;
+}
+
 bool GetCurrentDirectory(FilePath* dir) {
   // getcwd can return ENOENT, which implies it checks against the disk.
   AssertBlockingAllowed();
@@ -1007,6 +1380,12 @@ bool GetShmemTempDir(bool executable, FilePath* path) {
 #if !defined(OS_MACOSX)
 // Mac has its own implementation, this is for all other Posix systems.
 bool CopyFile(const FilePath& from_path, const FilePath& to_path) {
+  return CopyFileWithOptions(from_path, to_path, CopyOptions());
+}
+
+bool CopyFileWithOptions(const FilePath& from_path,
+                         const FilePath& to_path,
+                         const CopyOptions& options) {
   AssertBlockingAllowed();
   File infile;
 #if defined(OS_ANDROID)
@@ -1025,7 +1404,8 @@ bool CopyFile(const FilePath& from_path, const FilePath& to_path) {
   if (!outfile.IsValid())
     return false;
 
-  return CopyFileContents(&infile, &outfile);
+  CopyProgress progress(options);
+  return CopyFileContents(&infile, &outfile, &progress);
 }
 #endif  // !defined(OS_MACOSX)
 
@@ -0,0 +1,162 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_FILES_MEMORY_MAPPED_FILE_H_
+#define BASE_FILES_MEMORY_MAPPED_FILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+
+#include "base/base_export.h"
+#include "base/files/file.h"
+#include "base/macros.h"
+#include "base/strings/string_piece.h"
+#include "build/build_config.h"
+
+namespace base {
+
+class FilePath;
+
+// Maps a file, or a region of it, into memory. The data is paged in by the
+// kernel as it is touched rather than copied onto the heap, and |data()| can
+// be wrapped without copying, e.g. in a StringPiece (see AsStringPiece()) or a
+// read-only Pickle for a PickleIterator.
+class BASE_EXPORT MemoryMappedFile {
+ public:
+  enum Access {
+    // Mapping a file into memory effectively allows for file I/O on any
+    // thread. The accessing thread could be paused while data from the file is
+    // paged into memory. Worse, a corrupted filesystem could cause a SEGV
+    // within the program instead of just an I/O error.
+    READ_ONLY,
+
+    // This provides read/write access to a file and must be used with care
+    // because of the additional subtleties involved in doing so. Though the
+    // OS will do the writing of data on its own time, too many dirty pages
+    // can cause the OS to pause the thread while it writes them out. The
+    // pause can be as much as 1s on some systems. Call Flush() to write the
+    // changes out at a time of the caller's choosing.
+    READ_WRITE,
+  };
+
+  // Usage hints for the kernel, passed to madvise().
+  enum class Advice {
+    // Undoes the other hints.
+    kNormal,
+    // Pages will be read in order: read ahead aggressively and drop them soon
+    // after use.
+    kSequential,
+    // Pages will be read in no particular order: don't read ahead.
+    kRandom,
+    // Pages will be needed soon: start reading them in now, asynchronously.
+    kWillNeed,
+    // Back the mapping with transparent huge pages where the kernel supports
+    // them for files, cutting TLB misses on large random-access tables.
+    kHugePage,
+  };
+
+  // The default constructor sets all members to invalid/null values.
+  MemoryMappedFile();
+  ~MemoryMappedFile();
+
+  // Used to hold information about a region [offset + size] of a file.
+  struct BASE_EXPORT Region {
+    static const Region kWholeFile;
+
+    bool operator==(const Region& other) const;
+    bool operator!=(const Region& other) const;
+
+    // Start of the region (measured in bytes from the beginning of the file).
+    int64_t offset;
+
+    // Length of the region in bytes.
+    size_t size;
+  };
+
+  // Whether Initialize() prefaults the whole mapping (MAP_POPULATE), trading
+  // a longer Initialize() for no page faults when the data is first read.
+  // Must be set before Initialize().
+  void set_prefault(bool prefault) { prefault_ = prefault; }
+
+  // Opens an existing file and maps it into memory. |access| must not be
+  // READ_WRITE if the file is empty. Returns false on failure or if already
+  // initialized.
+  bool Initialize(const FilePath& file_name, Access access);
+  bool Initialize(const FilePath& file_name) {
+    return Initialize(file_name, READ_ONLY);
+  }
+
+  // As above, but works with an already-opened file. |access| must match the
+  // flags |file| was opened with. MemoryMappedFile takes ownership of |file|
+  // and closes it when done.
+  bool Initialize(File file, Access access);
+  bool Initialize(File file) { return Initialize(std::move(file), READ_ONLY); }
+
+  // As above, but works with a region of an already-opened file.
+  bool Initialize(File file, const Region& region, Access access);
+  bool Initialize(File file, const Region& region) {
+    return Initialize(std::move(file), region, READ_ONLY);
+  }
+
+  const uint8_t* data() const { return data_; }
+  uint8_t* data() { return data_; }
+  size_t length() const { return length_; }
+
+  // Returns the mapped data, without copying it.
+  StringPiece AsStringPiece() const {
+    return StringPiece(reinterpret_cast<const char*>(data_), length_);
+  }
+
+  // Is file_ a valid file handle that points to an open, memory mapped file?
+  bool IsValid() const;
+
+#if defined(OS_POSIX) || defined(OS_FUCHSIA)
+  // Passes |advice| about the whole mapping to the kernel. Returns false if
+  // the hint was rejected, e.g. kHugePage on a kernel or filesystem without
+  // support for huge page file mappings.
+  bool Advise(Advice advice);
+
+  // Writes the pages modified through a READ_WRITE mapping back to the file,
+  // blocking until done (msync() with MS_SYNC). Returns false on failure.
+  bool Flush();
+#endif
+
+ private:
+  // Given the arbitrarily aligned memory region [start, size], returns the
+  // boundaries of the region aligned to the granularity specified by the OS,
+  // (a page on Linux, ~32k on Windows) as follows:
+  // - |aligned_start| is page aligned and <= |start|.
+  // - |aligned_size| is a multiple of the VM granularity and >= |size|.
+  // - |offset| is the displacement of |start| w.r.t |aligned_start|.
+  static void CalculateVMAlignedBoundaries(int64_t start,
+                                           size_t size,
+                                           int64_t* aligned_start,
+                                           size_t* aligned_size,
+                                           int32_t* offset);
+
+  // Maps the file into memory, on success returns true and sets |data_| and
+  // |length_| to the mapped region of the file.
+  bool MapFileRegionToMemory(const Region& region, Access access);
+
+  // Closes all open handles.
+  void CloseHandles();
+
+  File file_;
+  uint8_t* data_ = nullptr;
+  size_t length_ = 0;
+
+  // The page-aligned mapping holding |data_|.
+  void* mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+
+  bool prefault_ = false;
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryMappedFile);
+};
+
+}  // namespace base
+
+#endif  // BASE_FILES_MEMORY_MAPPED_FILE_H_
@@ -0,0 +1,145 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/memory_mapped_file.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include "base/logging.h"
+#include "base/numerics/safe_conversions.h"
+#include "base/threading/thread_restrictions.h"
+#include "build/build_config.h"
+
+namespace base {
+
+MemoryMappedFile::MemoryMappedFile() = default;
+
+bool MemoryMappedFile::MapFileRegionToMemory(
+    const MemoryMappedFile::Region& region,
+    Access access) {
+  AssertBlockingAllowed();
+
+  off_t map_start = 0;
+  size_t map_size = 0;
+  int32_t data_offset = 0;
+
+  if (region == MemoryMappedFile::Region::kWholeFile) {
+    int64_t file_len = file_.GetLength();
+    if (file_len < 0) {
+      DPLOG(ERROR) << "fstat " << file_.GetPlatformFile();
+      return false;
+    }
+    if (!IsValueInRangeForNumericType<size_t>(file_len))
+      return false;
+    map_size = static_cast<size_t>(file_len);
+    length_ = map_size;
+  } else {
+    // The region can be arbitrarily aligned. mmap, instead, requires both the
+    // start and size to be page-aligned. Hence, we map here the page-aligned
+    // outer region [|aligned_start|, |aligned_start| + |size|] which contains
+    // |region| and then add up the |data_offset| displacement.
+    int64_t aligned_start = 0;
+    size_t aligned_size = 0;
+    CalculateVMAlignedBoundaries(region.offset, region.size, &aligned_start,
+                                 &aligned_size, &data_offset);
+
+    // Ensure that the casts in the mmap call below are sane.
+    if (aligned_start < 0 ||
+        !IsValueInRangeForNumericType<off_t>(aligned_start)) {
+      DLOG(ERROR) << "Region bounds are not valid for mmap";
+      return false;
+    }
+
+    map_start = static_cast<off_t>(aligned_start);
+    map_size = aligned_size;
+    length_ = region.size;
+  }
+
+  // mmap() fails with EINVAL on empty mappings, and there is nothing to map.
+  if (map_size == 0) {
+    DLOG(ERROR) << "Can't map an empty region";
+    length_ = 0;
+    return false;
+  }
+
+  int prot = PROT_READ;
+  if (access == READ_WRITE)
+    prot |= PROT_WRITE;
+  int flags = MAP_SHARED;
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  if (prefault_)
+    flags |= MAP_POPULATE;
+#endif
+
+  void* mapping =
+      mmap(nullptr, map_size, prot, flags, file_.GetPlatformFile(), map_start);
+  if (mapping == MAP_FAILED) {
+    DPLOG(ERROR) << "mmap " << file_.GetPlatformFile();
+    length_ = 0;
+    return false;
+  }
+
+  mapping_ = mapping;
+  mapping_size_ = map_size;
+  data_ = static_cast<uint8_t*>(mapping) + data_offset;
+  return true;
+}
+
+bool MemoryMappedFile::Advise(Advice advice) {
+  DCHECK(IsValid());
+  int posix_advice = MADV_NORMAL;
+  switch (advice) {
+    case Advice::kNormal:
+      posix_advice = MADV_NORMAL;
+      break;
+    case Advice::kSequential:
+      posix_advice = MADV_SEQUENTIAL;
+      break;
+    case Advice::kRandom:
+      posix_advice = MADV_RANDOM;
+      break;
+    case Advice::kWillNeed:
+      posix_advice = MADV_WILLNEED;
+      break;
+    case Advice::kHugePage:
+#if defined(MADV_HUGEPAGE)
+      posix_advice = MADV_HUGEPAGE;
+      break;
+#else
+      return false;
+#endif
+  }
+  if (madvise(mapping_, mapping_size_, posix_advice) != 0) {
+    DPLOG(ERROR) << "madvise";
+    return false;
+  }
+  return true;
+}
+
+bool MemoryMappedFile::Flush() {
+  AssertBlockingAllowed();
+  DCHECK(IsValid());
+  if (msync(mapping_, mapping_size_, MS_SYNC) != 0) {
+    DPLOG(ERROR) << "msync";
+    return false;
+  }
+  return true;
+}
+
+void MemoryMappedFile::CloseHandles() {
+  AssertBlockingAllowed();
+
+  if (mapping_)
+    munmap(mapping_, mapping_size_);
+  file_.Close();
+
+  data_ = nullptr;
+  length_ = 0;
+  mapping_ = nullptr;
+  mapping_size_ = 0;
+}
+
+}  // namespace base
@@ -0,0 +1,131 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_FILES_PARALLEL_FILE_ENUMERATOR_H_
+#define BASE_FILES_PARALLEL_FILE_ENUMERATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/callback.h"
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+
+namespace base {
+
+// Recursively enumerates a directory tree on several threads, for scanning
+// trees too large for FileEnumerator. Subdirectories are fanned out to the
+// threads as they are found. On Linux each directory is read with a few large
+// getdents64() calls, and entries are only stat()ed (with statx() and just the
+// needed fields where available) when their directory entry type isn't
+// enough.
+//
+// This is blocking. Do not use on critical threads.
+//
+// Example:
+//
+//   std::atomic<int64_t> count(0);
+//   base::ParallelFileEnumerator enumerator(
+//       dir, base::FileEnumerator::FILES, 0, 8);
+//   enumerator.Run(base::BindRepeating(
+//       [](std::atomic<int64_t>* count,
+//          const std::vector<base::ParallelFileEnumerator::Entry>& entries) {
+//         *count += entries.size();
+//       },
+//       &count));
+class BASE_EXPORT ParallelFileEnumerator : public PlatformThread::Delegate {
+ public:
+  // What is known about each enumerated file.
+  struct BASE_EXPORT Entry {
+    Entry();
+    Entry(const Entry& other);
+    Entry(Entry&& other);
+    ~Entry();
+
+    // |root_path| joined with the path of the file under it.
+    FilePath path;
+    bool is_directory = false;
+    // Only set when requested with FIELD_SIZE or FIELD_LAST_MODIFIED_TIME,
+    // and for symbolic links with SHOW_SYM_LINKS, describe the link itself.
+    int64_t size = 0;
+    Time last_modified;
+  };
+
+  // The optional fields of Entry to fill in, each of which costs a stat() per
+  // entry.
+  enum Field {
+    FIELD_SIZE = 1 << 0,
+    FIELD_LAST_MODIFIED_TIME = 1 << 1,
+  };
+
+  // Runs with batches of entries, from the enumerating threads and possibly
+  // concurrently. Each batch holds entries from a single directory.
+  using EntriesCallback =
+      RepeatingCallback<void(const std::vector<Entry>& entries)>;
+
+  // |file_type| is a mask of FileEnumerator::FILES, DIRECTORIES and
+  // SHOW_SYM_LINKS, as for FileEnumerator. Without SHOW_SYM_LINKS symbolic
+  // links are followed, including to directories. |fields| is a mask of
+  // Field. At most |max_threads| threads enumerate, including the one calling
+  // Run().
+  ParallelFileEnumerator(const FilePath& root_path,
+                         int file_type,
+                         int fields,
+                         int max_threads);
+  ~ParallelFileEnumerator() override;
+
+  // Enumerates everything under the root path, in no particular order, and
+  // returns once done. Directories which can't be read are skipped. May only
+  // be called once.
+  void Run(const EntriesCallback& callback);
+
+  // PlatformThread::Delegate:
+  void ThreadMain() override;
+
+ private:
+  // Enumerates the entries of |directory|, appending its subdirectories to
+  // |subdirectories|. |buffer| is scratch space for directory entries.
+  void EnumerateDirectory(const FilePath& directory,
+                          std::vector<char>* buffer,
+                          std::vector<FilePath>* subdirectories);
+
+  // Handles the entry |name| of |directory|, open as |directory_fd|. |d_type|
+  // is its type from the directory entry, possibly DT_UNKNOWN.
+  void AddEntry(const FilePath& directory,
+                int directory_fd,
+                const char* name,
+                unsigned char d_type,
+                std::vector<Entry>* entries,
+                std::vector<FilePath>* subdirectories);
+
+  const FilePath root_path_;
+  const int file_type_;
+  const int fields_;
+  const int max_threads_;
+
+  const EntriesCallback* callback_ = nullptr;
+
+  Lock lock_;
+  // Signaled when directories are added to |pending_directories_| or the
+  // enumeration is done.
+  ConditionVariable work_available_;
+  // Directories waiting to be enumerated, taken from the back to favor depth
+  // and keep the list short.
+  std::vector<FilePath> pending_directories_;
+  // Number of threads enumerating a directory, which may add more.
+  int busy_threads_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelFileEnumerator);
+};
+
+}  // namespace base
+
+#endif  // BASE_FILES_PARALLEL_FILE_ENUMERATOR_H_
@@ -0,0 +1,276 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/parallel_file_enumerator.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include "base/files/file_enumerator.h"
+#include "base/logging.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/threading/thread_restrictions.h"
+#include "build/build_config.h"
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include <sys/syscall.h>
+#endif
+
+namespace base {
+
+namespace {
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+// Size of the buffer each thread reads directory entries into: a few hundred
+// kilobytes read thousands of entries per getdents64() call.
+constexpr size_t kDirectoryBufferSize = 256 * 1024;
+
+// The layout of the records returned by getdents64(), which has no C library
+// wrapper before glibc 2.30. |d_name| is actually only as long as |d_reclen|
+// allows.
+struct KernelDirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[256];
+};
+#else
+// Number of entries passed to the callback at once.
+constexpr size_t kBatchSize = 1024;
+#endif
+
+bool IsDotOrDotDot(const char* name) {
+  return name[0] == '.' &&
+         (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+// What a stat() of a directory entry found out.
+struct EntryStat {
+  bool is_directory;
+  int64_t size;
+  Time last_modified;
+};
+
+// Stats |name| in |directory_fd|, only asking for the fields in |fields|
+// (plus the type) where statx() is supported. Returns false if the entry
+// disappeared or can't be stat()ed.
+bool StatEntry(int directory_fd,
+               const char* name,
+               bool follow_links,
+               int fields,
+               EntryStat* entry_stat) {
+#if defined(STATX_TYPE) && !(defined(OS_ANDROID) && __ANDROID_API__ < 30)
+  unsigned int mask = STATX_TYPE;
+  if (fields & ParallelFileEnumerator::FIELD_SIZE)
+    mask |= STATX_SIZE;
+  if (fields & ParallelFileEnumerator::FIELD_LAST_MODIFIED_TIME)
+    mask |= STATX_MTIME;
+  // Don't wait for network filesystems to revalidate cached attributes.
+  int flags = AT_STATX_DONT_SYNC;
+  if (!follow_links)
+    flags |= AT_SYMLINK_NOFOLLOW;
+  struct statx stx;
+  if (statx(directory_fd, name, flags, mask, &stx) == 0) {
+    entry_stat->is_directory = S_ISDIR(stx.stx_mode);
+    entry_stat->size = static_cast<int64_t>(stx.stx_size);
+    const timespec mtime = {static_cast<time_t>(stx.stx_mtime.tv_sec),
+                            static_cast<long>(stx.stx_mtime.tv_nsec)};
+    entry_stat->last_modified = Time::FromTimeSpec(mtime);
+    return true;
+  }
+  // Old kernels, and sandboxes which don't know about statx().
+  if (errno != ENOSYS && errno != EPERM)
+    return false;
+#endif
+
+  struct stat st;
+  if (fstatat(directory_fd, name, &st, follow_links ? 0 : AT_SYMLINK_NOFOLLOW))
+    return false;
+  entry_stat->is_directory = S_ISDIR(st.st_mode);
+  entry_stat->size = st.st_size;
+  entry_stat->last_modified = Time::FromTimeT(st.st_mtime);
+  return true;
+}
+
+}  // namespace
+
+ParallelFileEnumerator::Entry::Entry() = default;
+
+ParallelFileEnumerator::Entry::Entry(const Entry& other) = default;
+
+ParallelFileEnumerator::Entry::Entry(Entry&& other) = default;
+
+ParallelFileEnumerator::Entry::~Entry() = default;
+
+ParallelFileEnumerator::ParallelFileEnumerator(const FilePath& root_path,
+                                               int file_type,
+                                               int fields,
+                                               int max_threads)
+    : root_path_(root_path.StripTrailingSeparators()),
+      file_type_(file_type),
+      fields_(fields),
+      max_threads_(max_threads),
+      work_available_(&lock_) {
+  DCHECK_GE(max_threads_, 1);
+  // INCLUDE_DOT_DOT is meaningless for a recursive enumeration.
+  DCHECK(!(file_type_ & FileEnumerator::INCLUDE_DOT_DOT));
+}
+
+ParallelFileEnumerator::~ParallelFileEnumerator() = default;
+
+void ParallelFileEnumerator::Run(const EntriesCallback& callback) {
+  AssertBlockingAllowed();
+  DCHECK(!callback_);
+  callback_ = &callback;
+  pending_directories_.push_back(root_path_);
+
+  std::vector<PlatformThreadHandle> threads;
+  for (int i = 1; i < max_threads_; ++i) {
+    PlatformThreadHandle handle;
+    if (!PlatformThread::Create(0, this, &handle))
+      break;
+    threads.push_back(handle);
+  }
+  ThreadMain();
+  for (PlatformThreadHandle handle : threads)
+    PlatformThread::Join(handle);
+}
+
+void ParallelFileEnumerator::ThreadMain() {
+  std::vector<char> buffer;
+  std::vector<FilePath> subdirectories;
+
+  AutoLock auto_lock(lock_);
+  for (;;) {
+    while (pending_directories_.empty() && busy_threads_ > 0)
+      work_available_.Wait();
+    // Nothing left and nobody enumerating to find more: done.
+    if (pending_directories_.empty())
+      return;
+
+    FilePath directory = std::move(pending_directories_.back());
+    pending_directories_.pop_back();
+    ++busy_threads_;
+    {
+      AutoUnlock auto_unlock(lock_);
+      subdirectories.clear();
+      EnumerateDirectory(directory, &buffer, &subdirectories);
+    }
+    --busy_threads_;
+
+    for (FilePath& subdirectory : subdirectories)
+      pending_directories_.push_back(std::move(subdirectory));
+    // Wake the waiting threads to share the new directories, or to return if
+    // this was the last busy thread.
+    if (!subdirectories.empty() || busy_threads_ == 0)
+      work_available_.Broadcast();
+  }
+}
+
+void ParallelFileEnumerator::EnumerateDirectory(
+    const FilePath& directory,
+    std::vector<char>* buffer,
+    std::vector<FilePath>* subdirectories) {
+  const int fd = HANDLE_EINTR(
+      open(directory.value().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+  if (fd < 0)
+    return;
+
+  std::vector<Entry> entries;
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  buffer->resize(kDirectoryBufferSize);
+  for (;;) {
+    const long bytes_read = HANDLE_EINTR(
+        syscall(SYS_getdents64, fd, buffer->data(), buffer->size()));
+    if (bytes_read <= 0)
+      break;
+    for (long offset = 0; offset < bytes_read;) {
+      const KernelDirent64* dirent =
+          reinterpret_cast<const KernelDirent64*>(buffer->data() + offset);
+      offset += dirent->d_reclen;
+      AddEntry(directory, fd, dirent->d_name, dirent->d_type, &entries,
+               subdirectories);
+    }
+    if (!entries.empty()) {
+      callback_->Run(entries);
+      entries.clear();
+    }
+  }
+  IGNORE_EINTR(close(fd));
+#else
+  DIR* dir = fdopendir(fd);
+  if (!dir) {
+    IGNORE_EINTR(close(fd));
+    return;
+  }
+  while (const struct dirent* dent = readdir(dir)) {
+    AddEntry(directory, fd, dent->d_name, dent->d_type, &entries,
+             subdirectories);
+    if (entries.size() >= kBatchSize) {
+      callback_->Run(entries);
+      entries.clear();
+    }
+  }
+  if (!entries.empty())
+    callback_->Run(entries);
+  closedir(dir);
+#endif
+}
+
+void ParallelFileEnumerator::AddEntry(const FilePath& directory,
+                                      int directory_fd,
+                                      const char* name,
+                                      unsigned char d_type,
+                                      std::vector<Entry>* entries,
+                                      std::vector<FilePath>* subdirectories) {
+  if (IsDotOrDotDot(name))
+    return;
+
+  const bool follow_links = !(file_type_ & FileEnumerator::SHOW_SYM_LINKS);
+  bool is_directory = d_type == DT_DIR;
+  // Whether the type is only known after a stat().
+  const bool type_unknown =
+      d_type == DT_UNKNOWN || (d_type == DT_LNK && follow_links);
+  const bool wanted =
+      type_unknown ||
+      (file_type_ & (is_directory ? FileEnumerator::DIRECTORIES
+                                  : FileEnumerator::FILES));
+  // Directories are needed anyway to recurse into them.
+  if (!wanted && !is_directory)
+    return;
+
+  EntryStat entry_stat = {is_directory, 0, Time()};
+  if (type_unknown || (wanted && fields_)) {
+    if (!StatEntry(directory_fd, name, follow_links, fields_, &entry_stat)) {
+      // Broken links are still listed, like FileEnumerator does.
+      if (d_type != DT_LNK)
+        return;
+      entry_stat = {false, 0, Time()};
+    }
+    is_directory = entry_stat.is_directory;
+  }
+
+  FilePath path = directory.Append(name);
+  if (is_directory)
+    subdirectories->push_back(path);
+  if (!(file_type_ & (is_directory ? FileEnumerator::DIRECTORIES
+                                   : FileEnumerator::FILES))) {
+    return;
+  }
+
+  Entry entry;
+  entry.path = std::move(path);
+  entry.is_directory = is_directory;
+  entry.size = entry_stat.size;
+  entry.last_modified = entry_stat.last_modified;
+  entries->push_back(std::move(entry));
+}
+
+}  // namespace base
@@ -0,0 +1,333 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop/delayed_task_wheel.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "base/bits.h"
+#include "base/logging.h"
+
+namespace base {
+namespace internal {
+
+struct DelayedTaskWheel::Node {
+  explicit Node(PendingTask pending_task)
+      : pending_task(std::move(pending_task)) {}
+
+  PendingTask pending_task;
+  Node* next = nullptr;
+};
+
+DelayedTaskWheel::DelayedTaskWheel() = default;
+
+DelayedTaskWheel::~DelayedTaskWheel() {
+  Clear();
+}
+
+void DelayedTaskWheel::Push(PendingTask pending_task) {
+  DCHECK(!pending_task.delayed_run_time.is_null());
+  Node* node = new Node(std::move(pending_task));
+  ++size_;
+
+  if (!wheel_size_) {
+    // Nothing constrains the wheel's position. Move it up to now, so that
+    // only tasks which are already due go to |ready_tasks_|.
+    const int64_t level0_mask = (int64_t{1} << kLevel0Bits) - 1;
+    MoveWheelTimeTo(ToWheelTime(TimeTicks::Now()) & ~level0_mask);
+  }
+  Place(node);
+}
+
+const PendingTask& DelayedTaskWheel::Peek() {
+  DCHECK(!empty());
+  const PendingTask* next =
+      ready_tasks_.empty() ? nullptr : &ready_tasks_.top();
+  if (wheel_size_) {
+    if (!earliest_)
+      FindEarliest();
+    // PendingTask::operator< is inverted for the heaps.
+    if (!next || *next < earliest_->pending_task)
+      next = &earliest_->pending_task;
+  }
+  // Tasks of |far_tasks_| run after all the others.
+  if (!next)
+    next = &far_tasks_.top();
+  return *next;
+}
+
+PendingTask DelayedTaskWheel::Pop() {
+  const PendingTask* next = &Peek();
+  if (earliest_ && next == &earliest_->pending_task) {
+    // Sort the tasks which are due, which most likely include |next|.
+    const int64_t run_time = ToWheelTime(next->delayed_run_time);
+    CascadeUntil(std::min(run_time, ToWheelTime(TimeTicks::Now())));
+    next = &Peek();
+    // A task popped ahead of its run time, e.g. to be deleted, is taken out of
+    // its slot rather than moving the wheel ahead of time.
+    if (earliest_ && next == &earliest_->pending_task)
+      return TakeEarliest();
+  }
+
+  DelayedTaskQueue* queue =
+      !ready_tasks_.empty() && next == &ready_tasks_.top() ? &ready_tasks_
+                                                            : &far_tasks_;
+  PendingTask pending_task = std::move(const_cast<PendingTask&>(queue->top()));
+  queue->pop();
+  --size_;
+  return pending_task;
+}
+
+int DelayedTaskWheel::SweepCancelledTasks(size_t budget) {
+  int high_res_tasks_deleted = 0;
+  while (budget > 0 && wheel_size_ > 0) {
+    const int level = sweep_slot_ / kSlotsPerLevel;
+    const int index = sweep_slot_ % kSlotsPerLevel;
+    if (!sweep_link_)
+      sweep_link_ = &slots_[level][index];
+
+    Node* node = *sweep_link_;
+    if (!node) {
+      sweep_slot_ = NextOccupiedSlot(sweep_slot_ + 1);
+      sweep_link_ = nullptr;
+      continue;
+    }
+
+    --budget;
+    if (!node->pending_task.task.IsCancelled()) {
+      sweep_link_ = &node->next;
+      continue;
+    }
+
+    *sweep_link_ = node->next;
+    if (!slots_[level][index])
+      occupied_slots_[level] &= ~(uint64_t{1} << index);
+    if (node == earliest_)
+      earliest_ = nullptr;
+    if (node->pending_task.is_high_res)
+      ++high_res_tasks_deleted;
+    delete node;
+    --wheel_size_;
+    --size_;
+  }
+  return high_res_tasks_deleted;
+}
+
+void DelayedTaskWheel::Clear() {
+  for (int level = 0; level < kLevels; ++level) {
+    for (Node*& head : slots_[level]) {
+      while (head) {
+        Node* next = head->next;
+        delete head;
+        head = next;
+      }
+    }
+    occupied_slots_[level] = 0;
+  }
+  ready_tasks_ = DelayedTaskQueue();
+  far_tasks_ = DelayedTaskQueue();
+  wheel_size_ = 0;
+  size_ = 0;
+  earliest_ = nullptr;
+  sweep_slot_ = 0;
+  sweep_link_ = nullptr;
+}
+
+// static
+int64_t DelayedTaskWheel::ToWheelTime(TimeTicks time) {
+  // TimeTicks::Max() is what TimeDelta::Max() delays saturate to.
+  if (time.is_max())
+    return std::numeric_limits<int64_t>::max();
+  return (time - TimeTicks()).InMicroseconds();
+}
+
+bool DelayedTaskWheel::FitsInWheel(int64_t run_time) const {
+  DCHECK_GE(run_time, wheel_time_);
+  // Leaves a slot of the top level out, as the one covering |wheel_time_|
+  // already started. Can't overflow: both are positive.
+  constexpr int64_t kWheelSpan = int64_t{kSlotsPerLevel - 1}
+                                 << LevelShift(kLevels - 1);
+  return run_time - wheel_time_ < kWheelSpan;
+}
+
+void DelayedTaskWheel::MoveWheelTimeTo(int64_t wheel_time) {
+  if (wheel_time <= wheel_time_)
+    return;
+  wheel_time_ = wheel_time;
+  while (!far_tasks_.empty() &&
+         FitsInWheel(ToWheelTime(far_tasks_.top().delayed_run_time))) {
+    Node* node =
+        new Node(std::move(const_cast<PendingTask&>(far_tasks_.top())));
+    far_tasks_.pop();
+    Place(node);
+  }
+}
+
+void DelayedTaskWheel::Place(Node* node) {
+  const int64_t run_time = ToWheelTime(node->pending_task.delayed_run_time);
+  if (run_time < wheel_time_) {
+    ready_tasks_.push(std::move(node->pending_task));
+    delete node;
+    return;
+  }
+  if (!FitsInWheel(run_time)) {
+    far_tasks_.push(std::move(node->pending_task));
+    delete node;
+    return;
+  }
+
+  // Find the finest level whose slots, counted from the one covering
+  // |wheel_time_|, reach |run_time|.
+  int level = 0;
+  int64_t slot = run_time >> LevelShift(0);
+  while (slot - (wheel_time_ >> LevelShift(level)) >= kSlotsPerLevel) {
+    ++level;
+    DCHECK_LT(level, kLevels);
+    slot = run_time >> LevelShift(level);
+  }
+
+  const int index = static_cast<int>(slot & (kSlotsPerLevel - 1));
+  node->next = slots_[level][index];
+  slots_[level][index] = node;
+  occupied_slots_[level] |= uint64_t{1} << index;
+  ++wheel_size_;
+
+  if (earliest_ && earliest_->pending_task < node->pending_task) {
+    earliest_ = node;
+    earliest_level_ = level;
+    earliest_index_ = index;
+  }
+}
+
+bool DelayedTaskWheel::FindFirstSlot(int level, int64_t* slot) const {
+  uint64_t occupied = occupied_slots_[level];
+  if (!occupied)
+    return false;
+
+  // Rotate |occupied| so that bit 0 stands for the slot covering
+  // |wheel_time_|. Slots never hold tasks due before that slot.
+  const int64_t current_slot = wheel_time_ >> LevelShift(level);
+  const int offset = static_cast<int>(current_slot & (kSlotsPerLevel - 1));
+  if (offset)
+    occupied = (occupied >> offset) | (occupied << (kSlotsPerLevel - offset));
+  *slot = current_slot + bits::CountTrailingZeroBits(occupied);
+  return true;
+}
+
+bool DelayedTaskWheel::FindNextSlot(int* level, int64_t* start) const {
+  bool found = false;
+  for (int i = 0; i < kLevels; ++i) {
+    int64_t slot;
+    if (!FindFirstSlot(i, &slot))
+      continue;
+    const int64_t slot_start = slot << LevelShift(i);
+    if (!found || slot_start <= *start) {
+      *level = i;
+      *start = slot_start;
+      found = true;
+    }
+  }
+  return found;
+}
+
+void DelayedTaskWheel::FindEarliest() {
+  DCHECK(wheel_size_);
+  earliest_ = nullptr;
+  for (int level = 0; level < kLevels; ++level) {
+    // Slots of a level don't overlap, so the first one holds its earliest
+    // task. It can only beat |earliest_| if it starts before.
+    int64_t slot;
+    if (!FindFirstSlot(level, &slot))
+      continue;
+    if (earliest_ &&
+        ToWheelTime(earliest_->pending_task.delayed_run_time) <
+            slot << LevelShift(level)) {
+      continue;
+    }
+    const int index = static_cast<int>(slot & (kSlotsPerLevel - 1));
+    for (Node* node = slots_[level][index]; node; node = node->next) {
+      if (!earliest_ || earliest_->pending_task < node->pending_task) {
+        earliest_ = node;
+        earliest_level_ = level;
+        earliest_index_ = index;
+      }
+    }
+  }
+}
+
+void DelayedTaskWheel::CascadeUntil(int64_t time) {
+  int level;
+  int64_t start;
+  while (FindNextSlot(&level, &start) && start <= time)
+    CascadeSlot(level, start);
+}
+
+PendingTask DelayedTaskWheel::TakeEarliest() {
+  Node* node = earliest_;
+  earliest_ = nullptr;
+  Node** link = &slots_[earliest_level_][earliest_index_];
+  while (*link != node)
+    link = &(*link)->next;
+  if (sweep_link_ == &node->next)
+    sweep_link_ = link;
+  *link = node->next;
+  if (!slots_[earliest_level_][earliest_index_])
+    occupied_slots_[earliest_level_] &= ~(uint64_t{1} << earliest_index_);
+
+  PendingTask pending_task = std::move(node->pending_task);
+  delete node;
+  --wheel_size_;
+  --size_;
+  return pending_task;
+}
+
+int DelayedTaskWheel::NextOccupiedSlot(int from) const {
+  DCHECK(wheel_size_);
+  from %= kLevels * kSlotsPerLevel;
+  // Visits the rest of |from|'s level, the other levels, then wraps around to
+  // the beginning of |from|'s level.
+  for (int i = 0; i <= kLevels; ++i) {
+    const int level = (from / kSlotsPerLevel + i) % kLevels;
+    uint64_t occupied = occupied_slots_[level];
+    if (i == 0)
+      occupied &= ~uint64_t{0} << (from % kSlotsPerLevel);
+    if (occupied) {
+      return level * kSlotsPerLevel +
+             static_cast<int>(bits::CountTrailingZeroBits(occupied));
+    }
+  }
+  NOTREACHED();
+  return 0;
+}
+
+void DelayedTaskWheel::CascadeSlot(int level, int64_t start) {
+  const int index =
+      static_cast<int>((start >> LevelShift(level)) & (kSlotsPerLevel - 1));
+  Node* node = slots_[level][index];
+  slots_[level][index] = nullptr;
+  occupied_slots_[level] &= ~(uint64_t{1} << index);
+  if (sweep_slot_ == level * kSlotsPerLevel + index)
+    sweep_link_ = nullptr;
+  earliest_ = nullptr;
+
+  // A level 0 slot isn't subdivided any further, all of its tasks are ready.
+  // Tasks of higher level slots end up in finer slots relative to |start|.
+  // Slots start before |wheel_time_| plus the wheel's span, far from
+  // overflowing.
+  if (level == 0)
+    start += int64_t{1} << kLevel0Bits;
+  MoveWheelTimeTo(start);
+
+  while (node) {
+    Node* next = node->next;
+    --wheel_size_;
+    Place(node);
+    node = next;
+  }
+}
+
+}  // namespace internal
+}  // namespace base
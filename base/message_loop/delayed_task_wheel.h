@@ -0,0 +1,158 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MESSAGE_LOOP_DELAYED_TASK_WHEEL_H_
+#define BASE_MESSAGE_LOOP_DELAYED_TASK_WHEEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "base/base_export.h"
+#include "base/macros.h"
+#include "base/pending_task.h"
+
+namespace base {
+namespace internal {
+
+// A hierarchical timing wheel of delayed PendingTasks, handing them out in the
+// same order as a DelayedTaskQueue would (delayed_run_time, then
+// sequence_num).
+//
+// Tasks are bucketed by delayed_run_time into kLevels levels of kSlotsPerLevel
+// slots each, a slot of level N spanning kSlotsPerLevel slots of level N - 1.
+// The wheel is positioned at the current time when tasks are added to it
+// empty, and only moves on as tasks become due. Push() is O(1): the task is
+// linked into the slot covering its run time at the finest level that reaches
+// that far. Tasks are only sorted once due: Pop() then redistributes the
+// tasks of the expired slots to finer levels or, at level 0, moves them to a
+// small heap from which they are served. Until then, Peek() finds the next
+// task by scanning the first occupied slot of each level, and remembers it.
+// Hence a task cancelled well ahead of its run time is never sorted, and
+// SweepCancelledTasks() deletes it before it gets there.
+//
+// Tasks due further ahead than the wheel reaches, such as those posted with
+// TimeDelta::Max(), wait in a heap until the wheel gets close enough.
+//
+// Not thread-safe.
+class BASE_EXPORT DelayedTaskWheel {
+ public:
+  DelayedTaskWheel();
+  ~DelayedTaskWheel();
+
+  // Adds |pending_task|, whose |delayed_run_time| must be set.
+  void Push(PendingTask pending_task);
+
+  // Returns the task that runs first. !empty() is assumed.
+  const PendingTask& Peek();
+
+  // Removes and returns the task that runs first. !empty() is assumed.
+  PendingTask Pop();
+
+  // Deletes the cancelled tasks among the next |budget| tasks still waiting in
+  // the wheel, resuming where the previous call left off so that repeated calls
+  // eventually visit every task. Returns the number of deleted tasks which had
+  // |is_high_res| set.
+  int SweepCancelledTasks(size_t budget);
+
+  // Deletes all tasks.
+  void Clear();
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+
+ private:
+  struct Node;
+
+  static constexpr int kLevels = 6;
+  static constexpr int kSlotBits = 6;
+  static constexpr int kSlotsPerLevel = 1 << kSlotBits;
+  // Slots of level 0 span 2^10us (~1ms), the top level spans ~2 years. Tasks
+  // beyond that wait in |far_tasks_|.
+  static constexpr int kLevel0Bits = 10;
+
+  static int64_t ToWheelTime(TimeTicks time);
+  static constexpr int LevelShift(int level) {
+    return kLevel0Bits + level * kSlotBits;
+  }
+
+  // Whether a task due at |run_time|, not before |wheel_time_|, fits in the
+  // slots of the top level.
+  bool FitsInWheel(int64_t run_time) const;
+
+  // Moves |wheel_time_| forward to |wheel_time|, which no slot may start
+  // before, then brings the tasks of |far_tasks_| which now fit into the
+  // wheel.
+  void MoveWheelTimeTo(int64_t wheel_time);
+
+  // Links |node| into the slot covering its run time or, if that time is
+  // behind |wheel_time_|, moves its task to |ready_tasks_|. Tasks too far
+  // ahead go to |far_tasks_|.
+  void Place(Node* node);
+
+  // Returns in |slot| the first non-empty slot of |level|, counted in slots of
+  // that level from TimeTicks(). Returns false if all are empty.
+  bool FindFirstSlot(int level, int64_t* slot) const;
+
+  // Finds the non-empty slot with the earliest start time. Ties go to the
+  // highest level. Returns false if all slots are empty.
+  bool FindNextSlot(int* level, int64_t* start) const;
+
+  // Sets |earliest_| to the task of |slots_| that runs first, which is in the
+  // first non-empty slot of some level. |wheel_size_| must not be 0.
+  void FindEarliest();
+
+  // Cascades all the slots starting at or before |time|.
+  void CascadeUntil(int64_t time);
+
+  // Unlinks |earliest_| from its slot and returns its task.
+  PendingTask TakeEarliest();
+
+  // Returns the first non-empty slot at or after |from| in sweep order,
+  // wrapping around. Some slot must be non-empty.
+  int NextOccupiedSlot(int from) const;
+
+  // Empties the slot of |level| starting at |start| and places its tasks anew.
+  void CascadeSlot(int level, int64_t start);
+
+  // Tasks ordered as in DelayedTaskQueue, due before |wheel_time_|.
+  DelayedTaskQueue ready_tasks_;
+
+  // Tasks due too far after |wheel_time_| to fit in |slots_|.
+  DelayedTaskQueue far_tasks_;
+
+  // Singly-linked lists of tasks, most recently added first.
+  Node* slots_[kLevels][kSlotsPerLevel] = {};
+
+  // Bit N of |occupied_slots_[level]| is set iff |slots_[level][N]| is
+  // non-empty.
+  uint64_t occupied_slots_[kLevels] = {};
+
+  // In ToWheelTime() units. Slots only hold tasks due at or after this time,
+  // the position of each slot is interpreted relative to it.
+  int64_t wheel_time_ = 0;
+
+  // Number of tasks in |slots_|.
+  size_t wheel_size_ = 0;
+
+  // Number of tasks in |slots_|, |ready_tasks_| and |far_tasks_|.
+  size_t size_ = 0;
+
+  // The task of |slots_| that runs first and the slot holding it, or null if
+  // not known.
+  Node* earliest_ = nullptr;
+  int earliest_level_ = 0;
+  int earliest_index_ = 0;
+
+  // SweepCancelledTasks() resumes at |*sweep_link_| if non-null, at the head of
+  // slot |sweep_slot_| (|level| * kSlotsPerLevel + |index|) otherwise.
+  int sweep_slot_ = 0;
+  Node** sweep_link_ = nullptr;
+
+  DISALLOW_COPY_AND_ASSIGN(DelayedTaskWheel);
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_MESSAGE_LOOP_DELAYED_TASK_WHEEL_H_
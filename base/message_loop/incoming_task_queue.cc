@@ -5,6 +5,7 @@
 #include "base/message_loop/incoming_task_queue.h"
 
 #include <limits>
+#include <memory>
 #include <utility>
 
 #include "base/bind.h"
@@ -37,21 +38,31 @@ TimeTicks CalculateDelayedRuntime(TimeDelta delay) {
 
 }  // namespace
 
+IncomingTaskQueue::Options::Options() = default;
+
 IncomingTaskQueue::IncomingTaskQueue(
-    std::unique_ptr<Observer> task_queue_observer)
+    std::unique_ptr<Observer> task_queue_observer,
+    const Options& options)
     : task_queue_observer_(std::move(task_queue_observer)),
-      triage_tasks_(this) {
+      mode_(options.mode),
+      triage_tasks_(this),
+      delayed_tasks_(options.delayed_queue_backend),
+      incoming_queue_lock_(FROM_HERE),
+      lock_free_incoming_queue_(&pending_task_pool_) {
   // The constructing sequence is not necessarily the running sequence, e.g. in
   // the case of a MessageLoop created unbound.
   DETACH_FROM_SEQUENCE(sequence_checker_);
 }
 
-IncomingTaskQueue::~IncomingTaskQueue() = default;
+IncomingTaskQueue::~IncomingTaskQueue() {
+  incoming_queue_.Clear(&pending_task_pool_);
+}
 
 bool IncomingTaskQueue::AddToIncomingQueue(const Location& from_here,
                                            OnceClosure task,
                                            TimeDelta delay,
-                                           Nestable nestable) {
+                                           Nestable nestable,
+                                           TaskPriority priority) {
   // Use CHECK instead of DCHECK to crash earlier. See http://crbug.com/711167
   // for details.
   CHECK(task);
@@ -61,6 +72,7 @@ bool IncomingTaskQueue::AddToIncomingQueue(const Location& from_here,
 
   PendingTask pending_task(from_here, std::move(task),
                            CalculateDelayedRuntime(delay), nestable);
+  pending_task.priority = priority;
 #if defined(OS_WIN)
   // We consider the task needs a high resolution timer if the delay is
   // more than 0 and less than 32ms. This caps the relative error to
@@ -80,7 +92,7 @@ bool IncomingTaskQueue::AddToIncomingQueue(const Location& from_here,
 
 void IncomingTaskQueue::Shutdown() {
   AutoLock auto_lock(incoming_queue_lock_);
-  accept_new_tasks_ = false;
+  accept_new_tasks_.store(false, std::memory_order_release);
 }
 
 void IncomingTaskQueue::ReportMetricsOnIdle() const {
@@ -92,28 +104,43 @@ void IncomingTaskQueue::ReportMetricsOnIdle() const {
 IncomingTaskQueue::TriageQueue::TriageQueue(IncomingTaskQueue* outer)
     : outer_(outer) {}
 
-IncomingTaskQueue::TriageQueue::~TriageQueue() = default;
+IncomingTaskQueue::TriageQueue::~TriageQueue() {
+  for (PendingTaskList& lane : lanes_)
+    lane.Clear(&outer_->pending_task_pool_);
+}
 
 const PendingTask& IncomingTaskQueue::TriageQueue::Peek() {
   DCHECK_CALLED_ON_VALID_SEQUENCE(outer_->sequence_checker_);
-  ReloadFromIncomingQueueIfEmpty();
-  DCHECK(!queue_.empty());
-  return queue_.front();
+  ReloadFromIncomingQueueIfNeeded();
+  const int lane = SelectLane();
+  DCHECK_GE(lane, 0);
+  return lanes_[lane].front()->pending_task;
 }
 
 PendingTask IncomingTaskQueue::TriageQueue::Pop() {
   DCHECK_CALLED_ON_VALID_SEQUENCE(outer_->sequence_checker_);
-  ReloadFromIncomingQueueIfEmpty();
-  DCHECK(!queue_.empty());
-  PendingTask pending_task = std::move(queue_.front());
-  queue_.pop();
+  // Only reload if empty so that this returns the task a preceding Peek() or
+  // HasTasks() call was about.
+  if (HighestNonEmptyLane() < 0)
+    ReloadFromIncomingQueue();
+  const int lane = SelectLane();
+  DCHECK_GE(lane, 0);
+  PendingTaskNode* node = lanes_[lane].PopFront();
+  PendingTask pending_task = std::move(node->pending_task);
+  outer_->pending_task_pool_.Delete(node);
+
+  tasks_since_served_[lane] = 0;
+  for (int i = 0; i < lane; ++i) {
+    if (!lanes_[i].empty())
+      ++tasks_since_served_[i];
+  }
   return pending_task;
 }
 
 bool IncomingTaskQueue::TriageQueue::HasTasks() {
   DCHECK_CALLED_ON_VALID_SEQUENCE(outer_->sequence_checker_);
-  ReloadFromIncomingQueueIfEmpty();
-  return !queue_.empty();
+  ReloadFromIncomingQueueIfNeeded();
+  return HighestNonEmptyLane() >= 0;
 }
 
 void IncomingTaskQueue::TriageQueue::Clear() {
@@ -124,40 +151,65 @@ void IncomingTaskQueue::TriageQueue::Clear() {
 
   // Delete all currently pending tasks but not tasks potentially posted from
   // their destructors. See ~MessageLoop() for the full logic mitigating against
-  // infite loops when clearing pending tasks. The ScopedClosureRunner below
-  // will be bound to a task posted at the end of the queue. After it is posted,
-  // tasks will be deleted one by one, when the bound ScopedClosureRunner is
-  // deleted and sets |deleted_all_originally_pending|, we know we've deleted
-  // all originally pending tasks.
-  bool deleted_all_originally_pending = false;
-  ScopedClosureRunner capture_deleted_all_originally_pending(BindOnce(
-      [](bool* deleted_all_originally_pending) {
-        *deleted_all_originally_pending = true;
-      },
-      Unretained(&deleted_all_originally_pending)));
-  outer_->AddToIncomingQueue(
-      FROM_HERE,
-      BindOnce([](ScopedClosureRunner) {},
-               std::move(capture_deleted_all_originally_pending)),
-      TimeDelta(), Nestable::kNestable);
-
-  while (!deleted_all_originally_pending) {
-    PendingTask pending_task = Pop();
-
-    if (!pending_task.delayed_run_time.is_null()) {
-      outer_->delayed_tasks().Push(std::move(pending_task));
+  // infite loops when clearing pending tasks. The latter land in the incoming
+  // queue, which isn't reloaded again below.
+  ReloadFromIncomingQueue();
+  for (PendingTaskList& lane : lanes_) {
+    while (!lane.empty()) {
+      PendingTaskNode* node = lane.PopFront();
+      if (!node->pending_task.delayed_run_time.is_null())
+        outer_->delayed_tasks().Push(std::move(node->pending_task));
+      outer_->pending_task_pool_.Delete(node);
     }
   }
 }
 
-void IncomingTaskQueue::TriageQueue::ReloadFromIncomingQueueIfEmpty() {
+void IncomingTaskQueue::TriageQueue::ReloadFromIncomingQueueIfNeeded() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(outer_->sequence_checker_);
+  const int lane = HighestNonEmptyLane();
+  if (lane < 0 || outer_->HasIncomingTasksAbovePriority(
+                      static_cast<TaskPriority>(lane))) {
+    ReloadFromIncomingQueue();
+  }
+}
+
+void IncomingTaskQueue::TriageQueue::ReloadFromIncomingQueue() {
   DCHECK_CALLED_ON_VALID_SEQUENCE(outer_->sequence_checker_);
-  if (queue_.empty()) {
-    outer_->ReloadWorkQueue(&queue_);
+  PendingTaskList incoming_tasks;
+  outer_->ReloadWorkQueue(&incoming_tasks, HighestNonEmptyLane() >= 0);
+  while (!incoming_tasks.empty()) {
+    PendingTaskNode* node = incoming_tasks.PopFront();
+    const int lane = static_cast<int>(node->pending_task.priority);
+    DCHECK_LT(lane, kNumLanes);
+    if (lanes_[lane].empty())
+      tasks_since_served_[lane] = 0;
+    lanes_[lane].Push(node);
   }
 }
 
-IncomingTaskQueue::DelayedQueue::DelayedQueue() {
+int IncomingTaskQueue::TriageQueue::SelectLane() const {
+  const int highest_lane = HighestNonEmptyLane();
+  // Serve the lowest priority lane which waited for too long, if any.
+  for (int lane = 0; lane < highest_lane; ++lane) {
+    if (!lanes_[lane].empty() &&
+        tasks_since_served_[lane] >= kMaxTasksBeforeServingStarvedLane) {
+      return lane;
+    }
+  }
+  return highest_lane;
+}
+
+int IncomingTaskQueue::TriageQueue::HighestNonEmptyLane() const {
+  for (int lane = kNumLanes - 1; lane >= 0; --lane) {
+    if (!lanes_[lane].empty())
+      return lane;
+  }
+  return -1;
+}
+
+IncomingTaskQueue::DelayedQueue::DelayedQueue(DelayedQueueBackend backend) {
+  if (backend == DelayedQueueBackend::kTimerWheel)
+    wheel_ = std::make_unique<DelayedTaskWheel>();
   DETACH_FROM_SEQUENCE(sequence_checker_);
 }
 
@@ -169,20 +221,34 @@ void IncomingTaskQueue::DelayedQueue::Push(PendingTask pending_task) {
   if (pending_task.is_high_res)
     ++pending_high_res_tasks_;
 
+  if (wheel_) {
+    wheel_->Push(std::move(pending_task));
+    // Amortizes the deletion of cancelled tasks over insertions so that they
+    // don't pile up until their run time.
+    pending_high_res_tasks_ -= wheel_->SweepCancelledTasks(kSweepBudgetPerPush);
+    DCHECK_GE(pending_high_res_tasks_, 0);
+    return;
+  }
+
   queue_.push(std::move(pending_task));
 }
 
 const PendingTask& IncomingTaskQueue::DelayedQueue::Peek() {
   DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  if (wheel_)
+    return wheel_->Peek();
   DCHECK(!queue_.empty());
   return queue_.top();
 }
 
 PendingTask IncomingTaskQueue::DelayedQueue::Pop() {
   DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
-  DCHECK(!queue_.empty());
-  PendingTask delayed_task = std::move(const_cast<PendingTask&>(queue_.top()));
-  queue_.pop();
+  DCHECK(wheel_ || !queue_.empty());
+  PendingTask delayed_task =
+      wheel_ ? wheel_->Pop()
+             : std::move(const_cast<PendingTask&>(queue_.top()));
+  if (!wheel_)
+    queue_.pop();
 
   if (delayed_task.is_high_res)
     --pending_high_res_tasks_;
@@ -194,20 +260,22 @@ PendingTask IncomingTaskQueue::DelayedQueue::Pop() {
 bool IncomingTaskQueue::DelayedQueue::HasTasks() {
   DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
   // TODO(robliao): The other queues don't check for IsCancelled(). Should they?
-  while (!queue_.empty() && Peek().task.IsCancelled())
+  while (Size() > 0 && Peek().task.IsCancelled())
     Pop();
 
-  return !queue_.empty();
+  return Size() > 0;
 }
 
 void IncomingTaskQueue::DelayedQueue::Clear() {
   DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
-  while (!queue_.empty())
+  while (Size() > 0)
     Pop();
 }
 
 size_t IncomingTaskQueue::DelayedQueue::Size() const {
   DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  if (wheel_)
+    return wheel_->size();
   return queue_.size();
 }
 
@@ -248,6 +316,9 @@ void IncomingTaskQueue::DeferredQueue::Clear() {
 }
 
 bool IncomingTaskQueue::PostPendingTask(PendingTask* pending_task) {
+  if (mode_ == Mode::kLockFree)
+    return PostPendingTaskLockFree(pending_task);
+
   // Warning: Don't try to short-circuit, and handle this thread's tasks more
   // directly, as it could starve handling of foreign threads.  Put every task
   // into this queue.
@@ -255,10 +326,10 @@ bool IncomingTaskQueue::PostPendingTask(PendingTask* pending_task) {
   bool was_empty = false;
   {
     AutoLock auto_lock(incoming_queue_lock_);
-    accept_new_tasks = accept_new_tasks_;
+    accept_new_tasks = accept_new_tasks_.load(std::memory_order_relaxed);
     if (accept_new_tasks) {
-      was_empty =
-          PostPendingTaskLockRequired(pending_task) && triage_queue_empty_;
+      was_empty = PostPendingTaskLockRequired(pending_task) &&
+                  triage_queue_empty_.load(std::memory_order_relaxed);
     }
   }
 
@@ -284,25 +355,104 @@ bool IncomingTaskQueue::PostPendingTaskLockRequired(PendingTask* pending_task) {
   // Initialize the sequence number. The sequence number is used for delayed
   // tasks (to facilitate FIFO sorting when two tasks have the same
   // delayed_run_time value) and for identifying the task in about:tracing.
-  pending_task->sequence_num = next_sequence_num_++;
+  pending_task->sequence_num =
+      next_sequence_num_.fetch_add(1, std::memory_order_relaxed);
 
   task_queue_observer_->WillQueueTask(pending_task);
 
+  const uint32_t priority_bit = 1u << static_cast<int>(pending_task->priority);
   bool was_empty = incoming_queue_.empty();
-  incoming_queue_.push(std::move(*pending_task));
+  incoming_queue_.Push(pending_task_pool_.New(std::move(*pending_task)));
+  incoming_priorities_.fetch_or(priority_bit, std::memory_order_release);
   return was_empty;
 }
 
-void IncomingTaskQueue::ReloadWorkQueue(TaskQueue* work_queue) {
+bool IncomingTaskQueue::PostPendingTaskLockFree(PendingTask* pending_task) {
+  DCHECK_EQ(Mode::kLockFree, mode_);
+
+  // As in Mode::kLocked, a task racing with Shutdown() may still make it in;
+  // it is then deleted along with |lock_free_incoming_queue_|.
+  if (!accept_new_tasks_.load(std::memory_order_acquire)) {
+    pending_task->task.Reset();
+    return false;
+  }
+
+  // Concurrent posters may enqueue in a different order than they draw
+  // sequence numbers; tasks posted from the same thread are still ordered.
+  pending_task->sequence_num =
+      next_sequence_num_.fetch_add(1, std::memory_order_relaxed);
+
+  task_queue_observer_->WillQueueTask(pending_task);
+
+  const uint32_t priority_bit = 1u << static_cast<int>(pending_task->priority);
+  lock_free_incoming_queue_.Push(
+      pending_task_pool_.New(std::move(*pending_task)));
+
+  // The sequentially consistent increment and load below pair with the store
+  // and re-check in ReloadWorkQueueLockFree(): either this task is claimed by
+  // the reload that found the triage queue empty, or this load observes
+  // |triage_queue_empty_| and reports |was_empty|. No wakeup can be lost.
+  const bool incoming_was_empty =
+      lock_free_incoming_queue_size_.fetch_add(1) == 0;
+  // Set once the task is counted: a reload clearing the bit then claims the
+  // task, and a reload which doesn't claim it comes before and leaves the bit
+  // set. The bit may outlive a task claimed meanwhile, which is allowed.
+  incoming_priorities_.fetch_or(priority_bit, std::memory_order_release);
+  const bool was_empty = incoming_was_empty && triage_queue_empty_.load();
+
+  task_queue_observer_->DidQueueTask(was_empty);
+
+  return true;
+}
+
+void IncomingTaskQueue::ReloadWorkQueue(PendingTaskList* work_queue,
+                                        bool triage_queue_has_tasks) {
   DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
 
   // Make sure no tasks are lost.
   DCHECK(work_queue->empty());
 
+  // Cleared before taking tasks so that a bit set concurrently stays set if
+  // its task isn't taken below. Bits are set once their task can be taken.
+  incoming_priorities_.exchange(0, std::memory_order_acq_rel);
+
+  if (mode_ == Mode::kLockFree) {
+    ReloadWorkQueueLockFree(work_queue, triage_queue_has_tasks);
+    return;
+  }
+
   // Acquire all we can from the inter-thread queue with one lock acquisition.
   AutoLock lock(incoming_queue_lock_);
-  incoming_queue_.swap(*work_queue);
-  triage_queue_empty_ = work_queue->empty();
+  work_queue->Append(&incoming_queue_);
+  triage_queue_empty_.store(work_queue->empty() && !triage_queue_has_tasks,
+                            std::memory_order_relaxed);
+}
+
+void IncomingTaskQueue::ReloadWorkQueueLockFree(PendingTaskList* work_queue,
+                                                bool triage_queue_has_tasks) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  DCHECK_EQ(Mode::kLockFree, mode_);
+
+  int available = lock_free_incoming_queue_size_.load();
+  if (available == 0) {
+    // |triage_queue_empty_| is already false if the triage queue has tasks.
+    if (triage_queue_has_tasks)
+      return;
+
+    // Announce that the triage queue is empty *before* checking one last time
+    // for incoming tasks. A poster that missed the announcement incremented
+    // the size before it, and hence is seen by the re-check.
+    triage_queue_empty_.store(true);
+    available = lock_free_incoming_queue_size_.load();
+    if (available == 0)
+      return;
+  }
+
+  // Claim all tasks counted so far; later ones are left for the next reload.
+  for (int i = 0; i < available; ++i)
+    work_queue->Push(lock_free_incoming_queue_.Pop());
+  lock_free_incoming_queue_size_.fetch_sub(available);
+  triage_queue_empty_.store(false);
 }
 
 }  // namespace internal
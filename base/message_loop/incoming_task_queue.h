@@ -5,10 +5,15 @@
 #ifndef BASE_MESSAGE_LOOP_INCOMING_TASK_QUEUE_H_
 #define BASE_MESSAGE_LOOP_INCOMING_TASK_QUEUE_H_
 
+#include <atomic>
+
 #include "base/base_export.h"
 #include "base/callback.h"
 #include "base/macros.h"
 #include "base/memory/ref_counted.h"
+#include "base/message_loop/delayed_task_wheel.h"
+#include "base/message_loop/lock_free_task_queue.h"
+#include "base/message_loop/pending_task_pool.h"
 #include "base/pending_task.h"
 #include "base/sequence_checker.h"
 #include "base/synchronization/lock.h"
@@ -80,13 +85,44 @@ class BASE_EXPORT IncomingTaskQueue
     DISALLOW_COPY_AND_ASSIGN(Queue);
   };
 
+  // How tasks posted from other threads are handed over to the sequence
+  // processing them.
+  enum class Mode {
+    // Posting appends to a queue guarded by |incoming_queue_lock_| which the
+    // processing sequence swaps out wholesale when it runs out of work.
+    kLocked,
+    // Posting appends to a lock-free multi-producer/single-consumer queue.
+    // Avoids contention between posting threads and the processing sequence
+    // on loops receiving many cross-thread posts.
+    kLockFree,
+  };
+
+  // The data structure holding delayed_tasks().
+  enum class DelayedQueueBackend {
+    // A binary heap. Cancelled tasks are only deleted once they reach the
+    // front.
+    kHeap,
+    // A DelayedTaskWheel. Cancelled tasks are swept as new tasks come in.
+    // Suited to loops with many pending delayed tasks, e.g. timeouts that
+    // mostly get cancelled.
+    kTimerWheel,
+  };
+
+  struct BASE_EXPORT Options {
+    Options();
+
+    Mode mode = Mode::kLocked;
+    DelayedQueueBackend delayed_queue_backend = DelayedQueueBackend::kHeap;
+  };
+
   // Constructs an IncomingTaskQueue which will invoke |task_queue_observer|
   // when tasks are queued. |task_queue_observer| will be bound to this
   // IncomingTaskQueue's lifetime. Ownership is required as opposed to a raw
   // pointer since IncomingTaskQueue is ref-counted. For the same reasons,
   // |task_queue_observer| needs to support being invoked racily during
   // shutdown).
-  explicit IncomingTaskQueue(std::unique_ptr<Observer> task_queue_observer);
+  explicit IncomingTaskQueue(std::unique_ptr<Observer> task_queue_observer,
+                             const Options& options = Options());
 
   // Appends a task to the incoming queue. Posting of all tasks is routed though
   // AddToIncomingQueue() or TryAddToIncomingQueue() to make sure that posting
@@ -95,10 +131,12 @@ class BASE_EXPORT IncomingTaskQueue
   // Returns true if the task was successfully added to the queue, otherwise
   // returns false. In all cases, the ownership of |task| is transferred to the
   // called method.
-  bool AddToIncomingQueue(const Location& from_here,
-                          OnceClosure task,
-                          TimeDelta delay,
-                          Nestable nestable);
+  bool AddToIncomingQueue(
+      const Location& from_here,
+      OnceClosure task,
+      TimeDelta delay,
+      Nestable nestable,
+      TaskPriority priority = TaskPriority::USER_VISIBLE);
 
   // Instructs this IncomingTaskQueue to stop accepting tasks, this cannot be
   // undone. Note that the registered IncomingTaskQueue::Observer may still
@@ -131,7 +169,8 @@ class BASE_EXPORT IncomingTaskQueue
   // TriageQueue
   // The first queue to receive all tasks for the processing sequence (when
   // reloading from the thread-safe |incoming_queue_|). Tasks are generally
-  // either dispatched immediately or sent to the queues below.
+  // either dispatched immediately or sent to the queues below. Tasks come out
+  // by priority, then in posting order.
   //
   // DelayedQueue
   // The queue for holding tasks that should be run later and sorted by expected
@@ -153,8 +192,9 @@ class BASE_EXPORT IncomingTaskQueue
 
     // ReadAndRemoveOnlyQueue:
     // The methods below will attempt to reload from the incoming queue if the
-    // queue itself is empty (Clear() has special logic to reload only once
-    // should destructors post more tasks).
+    // queue itself is empty or if the incoming queue has tasks of higher
+    // priority than the next one (Clear() reloads only once should destructors
+    // post more tasks).
     const PendingTask& Peek() override;
     PendingTask Pop() override;
     // Whether this queue has tasks after reloading from the incoming queue.
@@ -162,17 +202,39 @@ class BASE_EXPORT IncomingTaskQueue
     void Clear() override;
 
    private:
-    void ReloadFromIncomingQueueIfEmpty();
+    static constexpr int kNumLanes =
+        static_cast<int>(TaskPriority::HIGHEST) + 1;
+
+    // Number of tasks which may be taken from higher priority lanes while a
+    // lane has tasks, before that lane is served regardless of priority.
+    static constexpr int kMaxTasksBeforeServingStarvedLane = 16;
+
+    void ReloadFromIncomingQueueIfNeeded();
+
+    // Moves the tasks of the incoming queue to their lanes.
+    void ReloadFromIncomingQueue();
+
+    // Returns the lane to take the next task from, or -1 if all are empty.
+    int SelectLane() const;
+
+    // Returns the index of the highest priority non-empty lane, or -1.
+    int HighestNonEmptyLane() const;
 
     IncomingTaskQueue* const outer_;
-    TaskQueue queue_;
+
+    // Tasks by priority, in posting order.
+    PendingTaskList lanes_[kNumLanes];
+
+    // Number of tasks taken from higher priority lanes since each lane was
+    // last served (or became non-empty).
+    int tasks_since_served_[kNumLanes] = {};
 
     DISALLOW_COPY_AND_ASSIGN(TriageQueue);
   };
 
   class DelayedQueue : public Queue {
    public:
-    DelayedQueue();
+    explicit DelayedQueue(DelayedQueueBackend backend);
     ~DelayedQueue() override;
 
     // Queue:
@@ -189,9 +251,16 @@ class BASE_EXPORT IncomingTaskQueue
     }
 
    private:
+    // Number of cancelled tasks SweepCancelledTasks() looks at per Push() with
+    // DelayedQueueBackend::kTimerWheel. Above 1 so that the wheel shrinks even
+    // if most tasks get cancelled.
+    static constexpr size_t kSweepBudgetPerPush = 4;
+
+    // Exactly one of these holds the tasks, per the DelayedQueueBackend.
     DelayedTaskQueue queue_;
+    std::unique_ptr<DelayedTaskWheel> wheel_;
 
-    // Number of high resolution tasks in |queue_|.
+    // Number of high resolution tasks in |queue_| or |wheel_|.
     int pending_high_res_tasks_ = 0;
 
     SEQUENCE_CHECKER(sequence_checker_);
@@ -231,15 +300,39 @@ class BASE_EXPORT IncomingTaskQueue
   // |incoming_queue_| was empty before |pending_task| was posted.
   bool PostPendingTaskLockRequired(PendingTask* pending_task);
 
+  // PostPendingTask() implementation for Mode::kLockFree.
+  bool PostPendingTaskLockFree(PendingTask* pending_task);
+
   // Loads tasks from the |incoming_queue_| into |*work_queue|. Must be called
-  // from the sequence processing the tasks.
-  void ReloadWorkQueue(TaskQueue* work_queue);
+  // from the sequence processing the tasks. |triage_queue_has_tasks| tells
+  // whether |triage_tasks_| still has tasks besides |*work_queue|.
+  void ReloadWorkQueue(PendingTaskList* work_queue,
+                       bool triage_queue_has_tasks);
+
+  // ReloadWorkQueue() implementation for Mode::kLockFree.
+  void ReloadWorkQueueLockFree(PendingTaskList* work_queue,
+                               bool triage_queue_has_tasks);
+
+  // Returns true if tasks of priority higher than |priority| were posted since
+  // the last ReloadWorkQueue(). May return true spuriously.
+  bool HasIncomingTasksAbovePriority(TaskPriority priority) const {
+    return incoming_priorities_.load(std::memory_order_relaxed) >>
+           (static_cast<int>(priority) + 1);
+  }
 
   // Checks calls made only on the MessageLoop thread.
   SEQUENCE_CHECKER(sequence_checker_);
 
   const std::unique_ptr<Observer> task_queue_observer_;
 
+  const Mode mode_;
+
+  // Allocates the nodes holding the tasks of |incoming_queue_|,
+  // |lock_free_incoming_queue_| and |triage_tasks_|, so that tasks are linked
+  // from one queue to the next without being moved. Declared before these
+  // queues, which delete their nodes into it.
+  PendingTaskPool pending_task_pool_;
+
   // Queue for initial triaging of tasks on the |sequence_checker_| sequence.
   TriageQueue triage_tasks_;
 
@@ -249,26 +342,39 @@ class BASE_EXPORT IncomingTaskQueue
   // Queue for non-nestable deferred tasks on the |sequence_checker_| sequence.
   DeferredQueue deferred_tasks_;
 
-  // Synchronizes access to all members below this line.
+  // In Mode::kLocked, synchronizes access to all members below this line. In
+  // Mode::kLockFree, only Shutdown() acquires it and the atomic members below
+  // are used without it.
   base::Lock incoming_queue_lock_;
 
   // An incoming queue of tasks that are acquired under a mutex for processing
   // on this instance's thread. These tasks have not yet been been pushed to
-  // |triage_tasks_|.
-  TaskQueue incoming_queue_;
+  // |triage_tasks_|. Only used in Mode::kLocked.
+  PendingTaskList incoming_queue_;
+
+  // The Mode::kLockFree counterpart of |incoming_queue_|.
+  LockFreeTaskQueue lock_free_incoming_queue_;
+
+  // Number of tasks pushed to |lock_free_incoming_queue_| and not yet claimed
+  // by ReloadWorkQueueLockFree(). Incremented after the push completes, so it
+  // may transiently lag behind the actual queue content but never leads it.
+  std::atomic<int> lock_free_incoming_queue_size_{0};
 
   // True if new tasks should be accepted.
-  bool accept_new_tasks_ = true;
+  std::atomic<bool> accept_new_tasks_{true};
+
+  // Bit N is set if a task of priority N may have been posted since the last
+  // ReloadWorkQueue(). Lets |triage_tasks_| know when to reload early.
+  std::atomic<uint32_t> incoming_priorities_{0};
 
   // The next sequence number to use for delayed tasks.
-  int next_sequence_num_ = 0;
-
-  // True if the outgoing queue (|triage_tasks_|) is empty. Toggled under
-  // |incoming_queue_lock_| in ReloadWorkQueue() so that
-  // PostPendingTaskLockRequired() can tell, without accessing the thread unsafe
-  // |triage_tasks_|, if the IncomingTaskQueue has been made non-empty by a
-  // PostTask() (and needs to inform its Observer).
-  bool triage_queue_empty_ = true;
+  std::atomic<int> next_sequence_num_{0};
+
+  // True if the outgoing queue (|triage_tasks_|) is empty. Toggled in
+  // ReloadWorkQueue() so that PostPendingTaskLockRequired() can tell, without
+  // accessing the thread unsafe |triage_tasks_|, if the IncomingTaskQueue has
+  // been made non-empty by a PostTask() (and needs to inform its Observer).
+  std::atomic<bool> triage_queue_empty_{true};
 
   DISALLOW_COPY_AND_ASSIGN(IncomingTaskQueue);
 };
@@ -0,0 +1,67 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop/lock_free_task_queue.h"
+
+#include "base/logging.h"
+#include "base/threading/platform_thread.h"
+
+namespace base {
+namespace internal {
+
+LockFreeTaskQueue::LockFreeTaskQueue(PendingTaskPool* pool)
+    : pool_(pool), newest_(&stub_), oldest_(&stub_) {}
+
+LockFreeTaskQueue::~LockFreeTaskQueue() {
+  PendingTaskNode* node = oldest_;
+  while (node) {
+    PendingTaskNode* next = node->next.load(std::memory_order_acquire);
+    if (node != &stub_)
+      pool_->Delete(node);
+    node = next;
+  }
+}
+
+void LockFreeTaskQueue::Push(PendingTaskNode* node) {
+  node->next.store(nullptr, std::memory_order_relaxed);
+  PendingTaskNode* previous = newest_.exchange(node, std::memory_order_acq_rel);
+  // |node| is now in the queue but only becomes visible to Pop() once linked.
+  previous->next.store(node, std::memory_order_release);
+}
+
+PendingTaskNode* LockFreeTaskQueue::Pop() {
+  PendingTaskNode* oldest = oldest_;
+  if (oldest == &stub_) {
+    // The caller knows that a node follows.
+    oldest = WaitForNext(&stub_);
+    oldest_ = oldest;
+  }
+
+  PendingTaskNode* next = oldest->next.load(std::memory_order_acquire);
+  if (!next) {
+    // |oldest| is the last linked node. If no producer is past it, put the
+    // stub back behind it so that |oldest| can be handed out without leaving
+    // the queue without nodes. Either way, a successor shows up.
+    if (oldest == newest_.load(std::memory_order_acquire))
+      Push(&stub_);
+    next = WaitForNext(oldest);
+  }
+  oldest_ = next;
+  return oldest;
+}
+
+// static
+PendingTaskNode* LockFreeTaskQueue::WaitForNext(PendingTaskNode* node) {
+  PendingTaskNode* next = node->next.load(std::memory_order_acquire);
+  while (!next) {
+    // A producer swapped itself in as |newest_| but was preempted before
+    // linking its predecessor. This window is a couple of instructions long.
+    PlatformThread::YieldCurrentThread();
+    next = node->next.load(std::memory_order_acquire);
+  }
+  return next;
+}
+
+}  // namespace internal
+}  // namespace base
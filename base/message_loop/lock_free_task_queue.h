@@ -0,0 +1,68 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MESSAGE_LOOP_LOCK_FREE_TASK_QUEUE_H_
+#define BASE_MESSAGE_LOOP_LOCK_FREE_TASK_QUEUE_H_
+
+#include <atomic>
+
+#include "base/base_export.h"
+#include "base/macros.h"
+#include "base/message_loop/pending_task_pool.h"
+
+namespace base {
+namespace internal {
+
+// An intrusive, unbounded, multi-producer/single-consumer queue of
+// PendingTaskNodes. Push() may be called concurrently from any number of
+// threads and never blocks; Pop() may only be called from a single consumer
+// sequence.
+//
+// This is the classic intrusive Vyukov MPSC linked queue: producers atomically
+// swap themselves in as the newest node and then link the previous newest node
+// to it. Between those two steps a node is part of the queue but not yet
+// reachable from the consumer side, Pop() waits out that (short) window. A stub
+// node is re-inserted when the queue would otherwise become empty, so that
+// nodes are handed to the consumer themselves rather than having their task
+// moved out.
+class BASE_EXPORT LockFreeTaskQueue {
+ public:
+  // Nodes left in the queue on destruction are deleted into |pool|.
+  explicit LockFreeTaskQueue(PendingTaskPool* pool);
+
+  // Deletes all tasks still in the queue. No Push() may be racing with the
+  // destruction of this queue.
+  ~LockFreeTaskQueue();
+
+  // Appends |node| to the queue. May be called from any thread.
+  void Push(PendingTaskNode* node);
+
+  // Removes and returns the oldest node. The caller must know that at least
+  // one Push() has started since the last Pop() (e.g. via a counter
+  // incremented after Push()). Must only be called from the consumer sequence.
+  PendingTaskNode* Pop();
+
+ private:
+  // Returns the successor of |node|, waiting for a producer to link it.
+  static PendingTaskNode* WaitForNext(PendingTaskNode* node);
+
+  PendingTaskPool* const pool_;
+
+  // The most recently pushed node. Exchanged by producers.
+  std::atomic<PendingTaskNode*> newest_;
+
+  // The next node to pop (or |stub_|, followed by the next node to pop). Only
+  // accessed by the consumer.
+  PendingTaskNode* oldest_;
+
+  // Sentinel node the queue starts out with. Never holds a task.
+  PendingTaskNode stub_;
+
+  DISALLOW_COPY_AND_ASSIGN(LockFreeTaskQueue);
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_MESSAGE_LOOP_LOCK_FREE_TASK_QUEUE_H_
@@ -8,6 +8,7 @@
 #include <utility>
 
 #include "base/bind.h"
+#include "base/bits.h"
 #include "base/compiler_specific.h"
 #include "base/debug/task_annotator.h"
 #include "base/logging.h"
@@ -26,6 +27,10 @@
 #include "base/message_loop/message_pump_mac.h"
 #endif
 
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include "base/message_loop/message_pump_io_uring.h"
+#endif
+
 namespace base {
 
 namespace {
@@ -165,6 +170,13 @@ MessageLoop::MessageLoop(Type type)
   BindToCurrentThread();
 }
 
+MessageLoop::MessageLoop(
+    Type type,
+    const internal::IncomingTaskQueue::Options& incoming_queue_options)
+    : MessageLoop(type, MessagePumpFactoryCallback(), incoming_queue_options) {
+  BindToCurrentThread();
+}
+
 MessageLoop::MessageLoop(std::unique_ptr<MessagePump> pump)
     : MessageLoop(TYPE_CUSTOM, BindOnce(&ReturnPump, std::move(pump))) {
   BindToCurrentThread();
@@ -260,8 +272,15 @@ std::unique_ptr<MessagePump> MessageLoop::CreateMessagePumpForType(Type type) {
   }
 #endif
 
-  if (type == MessageLoop::TYPE_IO)
+  if (type == MessageLoop::TYPE_IO) {
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+    // Falls back to epoll where io_uring is unavailable.
+    std::unique_ptr<MessagePump> io_uring_pump = MessagePumpIOUring::Create();
+    if (io_uring_pump)
+      return io_uring_pump;
+#endif
     return std::unique_ptr<MessagePump>(new MessagePumpForIO());
+  }
 
 #if defined(OS_ANDROID) && 0
   if (type == MessageLoop::TYPE_JAVA)
@@ -294,6 +313,25 @@ void MessageLoop::RemoveTaskObserver(TaskObserver* task_observer) {
   task_observers_.RemoveObserver(task_observer);
 }
 
+MessageLoop::WorkBatchStats::WorkBatchStats() = default;
+
+void MessageLoop::SetWorkBatchSize(int work_batch_size) {
+  DCHECK_CALLED_ON_VALID_THREAD(bound_thread_checker_);
+  DCHECK_GE(work_batch_size, 1);
+  work_batch_size_ = work_batch_size;
+}
+
+void MessageLoop::SetWorkBatchTimeBudget(TimeDelta time_budget) {
+  DCHECK_CALLED_ON_VALID_THREAD(bound_thread_checker_);
+  DCHECK_GE(time_budget, TimeDelta());
+  work_batch_time_budget_ = time_budget;
+}
+
+const MessageLoop::WorkBatchStats& MessageLoop::work_batch_stats() const {
+  DCHECK_CALLED_ON_VALID_THREAD(bound_thread_checker_);
+  return work_batch_stats_;
+}
+
 bool MessageLoop::IsIdleForTesting() {
   // Have unprocessed tasks? (this reloads the work queue if necessary)
   if (incoming_task_queue_->triage_tasks().HasTasks())
@@ -320,13 +358,17 @@ std::unique_ptr<MessageLoop> MessageLoop::CreateUnbound(
 // TODO(gab): Avoid bare new + WrapUnique below when introducing
 // SequencedTaskSource in follow-up @
 // https://chromium-review.googlesource.com/c/chromium/src/+/1088762.
-MessageLoop::MessageLoop(Type type, MessagePumpFactoryCallback pump_factory)
+MessageLoop::MessageLoop(Type type,
+                         MessagePumpFactoryCallback pump_factory,
+                         const internal::IncomingTaskQueue::Options&
+                             incoming_queue_options)
     : MessageLoopCurrent(this),
       type_(type),
       pump_factory_(std::move(pump_factory)),
       message_loop_controller_(new Controller(this)),
       incoming_task_queue_(MakeRefCounted<internal::IncomingTaskQueue>(
-          WrapUnique(message_loop_controller_))),
+          WrapUnique(message_loop_controller_),
+          incoming_queue_options)),
       unbound_task_runner_(MakeRefCounted<internal::MessageLoopTaskRunner>(
           incoming_task_queue_)),
       task_runner_(unbound_task_runner_) {
@@ -410,6 +452,7 @@ void MessageLoop::Run(bool application_tasks_allowed) {
 
 void MessageLoop::Quit() {
   DCHECK_CALLED_ON_VALID_THREAD(bound_thread_checker_);
+  quit_requested_ = true;
   pump_->Quit();
 }
 
@@ -492,7 +535,13 @@ bool MessageLoop::DoWork() {
   if (!task_execution_allowed_)
     return false;
 
-  // Execute oldest task.
+  int tasks_run = 0;
+  TimeTicks batch_start;
+  if (!work_batch_time_budget_.is_zero())
+    batch_start = TimeTicks::Now();
+  quit_requested_ = false;
+
+  // Execute oldest tasks.
   while (incoming_task_queue_->triage_tasks().HasTasks()) {
     if (!scheduled_wakeup_.next_run_time.is_null()) {
       // While the frontmost task may racily be ripe. The MessageLoop was awaken
@@ -522,12 +571,29 @@ bool MessageLoop::DoWork() {
         pump_->ScheduleDelayedWork(delayed_run_time);
       }
     } else if (DeferOrRunPendingTask(std::move(pending_task))) {
-      return true;
+      ++tasks_run;
+      // Hand control back to the pump as soon as the task quit the run level
+      // rather than after the batch.
+      if (tasks_run >= work_batch_size_ || quit_requested_)
+        break;
+      if (!batch_start.is_null() &&
+          TimeTicks::Now() - batch_start >= work_batch_time_budget_) {
+        ++work_batch_stats_.time_budget_exhausted;
+        break;
+      }
     }
   }
 
-  // Nothing happened.
-  return false;
+  if (!tasks_run) {
+    // Nothing happened.
+    return false;
+  }
+
+  ++work_batch_stats_.batches;
+  work_batch_stats_.tasks += tasks_run;
+  ++work_batch_stats_.batch_size_buckets[std::min(
+      bits::Log2Floor(tasks_run), WorkBatchStats::kNumBatchSizeBuckets - 1)];
+  return true;
 }
 
 bool MessageLoop::DoDelayedWork(TimeTicks* next_delayed_work_time) {
@@ -5,6 +5,8 @@
 #ifndef BASE_MESSAGE_LOOP_MESSAGE_LOOP_H_
 #define BASE_MESSAGE_LOOP_MESSAGE_LOOP_H_
 
+#include <stdint.h>
+
 #include <memory>
 #include <queue>
 #include <string>
@@ -127,6 +129,13 @@ class BASE_EXPORT MessageLoop : public MessagePump::Delegate,
   // Normally, it is not necessary to instantiate a MessageLoop.  Instead, it
   // is typical to make use of the current thread's MessageLoop instance.
   explicit MessageLoop(Type type = TYPE_DEFAULT);
+  // Creates a MessageLoop of |type| whose task queues are configured as per
+  // |incoming_queue_options|. Loops receiving many cross-thread posts benefit
+  // from IncomingTaskQueue::Mode::kLockFree, loops with many pending delayed
+  // tasks from IncomingTaskQueue::DelayedQueueBackend::kTimerWheel.
+  MessageLoop(
+      Type type,
+      const internal::IncomingTaskQueue::Options& incoming_queue_options);
   // Creates a TYPE_CUSTOM MessageLoop with the supplied MessagePump, which must
   // be non-NULL.
   explicit MessageLoop(std::unique_ptr<MessagePump> pump);
@@ -190,6 +199,40 @@ class BASE_EXPORT MessageLoop : public MessagePump::Delegate,
   void AddTaskObserver(TaskObserver* task_observer);
   void RemoveTaskObserver(TaskObserver* task_observer);
 
+  // Counters describing the batches of immediate tasks run by DoWork(). See
+  // SetWorkBatchSize().
+  struct BASE_EXPORT WorkBatchStats {
+    static constexpr int kNumBatchSizeBuckets = 8;
+
+    WorkBatchStats();
+
+    // Number of DoWork() calls which ran at least one task.
+    uint64_t batches = 0;
+    // Number of tasks run by these batches.
+    uint64_t tasks = 0;
+    // Number of batches cut short by the time budget.
+    uint64_t time_budget_exhausted = 0;
+    // Bucket N counts the batches which ran [2^N, 2^(N+1)) tasks, the last
+    // bucket also counts larger batches.
+    uint64_t batch_size_buckets[kNumBatchSizeBuckets] = {};
+  };
+
+  // Lets each DoWork() run up to |work_batch_size| immediate tasks before
+  // control returns to the MessagePump, which then gets a chance to process
+  // native events and delayed tasks. Larger batches remove most of the
+  // per-task pump overhead of throughput-bound loops at the expense of IO and
+  // delayed task latency. Defaults to 1. Must be called on the thread to which
+  // the message loop is bound.
+  void SetWorkBatchSize(int work_batch_size);
+
+  // Ends a batch early once it has run for at least |time_budget|, checked
+  // after each task. A zero |time_budget| (the default) disables the check.
+  // Must be called on the thread to which the message loop is bound.
+  void SetWorkBatchTimeBudget(TimeDelta time_budget);
+
+  // Must be called on the thread to which the message loop is bound.
+  const WorkBatchStats& work_batch_stats() const;
+
   // Returns true if the message loop is idle (ignoring delayed tasks). This is
   // the same condition which triggers DoWork() to return false: i.e.
   // out of tasks which can be processed at the current run-level -- there might
@@ -213,7 +256,11 @@ class BASE_EXPORT MessageLoop : public MessagePump::Delegate,
   // specific type with a custom loop. The implementation does not call
   // BindToCurrentThread. If this constructor is invoked directly by a subclass,
   // then the subclass must subsequently bind the message loop.
-  MessageLoop(Type type, MessagePumpFactoryCallback pump_factory);
+  MessageLoop(Type type,
+              MessagePumpFactoryCallback pump_factory,
+              const internal::IncomingTaskQueue::Options&
+                  incoming_queue_options =
+                      internal::IncomingTaskQueue::Options());
 
   // Configure various members and bind this message loop to the current thread.
   void BindToCurrentThread();
@@ -286,6 +333,15 @@ class BASE_EXPORT MessageLoop : public MessagePump::Delegate,
   // A recent snapshot of Time::Now(), used to check delayed_work_queue_.
   TimeTicks recent_time_;
 
+  // See SetWorkBatchSize() and SetWorkBatchTimeBudget().
+  int work_batch_size_ = 1;
+  TimeDelta work_batch_time_budget_;
+  WorkBatchStats work_batch_stats_;
+
+  // Set by Quit(). Lets DoWork() end its batch as soon as the task which quit
+  // the current run level returns.
+  bool quit_requested_ = false;
+
   // Non-null when the last thing this MessageLoop did is become idle with
   // pending delayed tasks. Used to report metrics on the following wake up.
   struct ScheduledWakeup {
@@ -41,6 +41,16 @@ bool MessageLoopTaskRunner::PostNonNestableDelayedTask(
                                              Nestable::kNonNestable);
 }
 
+bool MessageLoopTaskRunner::PostDelayedTaskWithPriority(
+    const Location& from_here,
+    TaskPriority priority,
+    OnceClosure task,
+    base::TimeDelta delay) {
+  DCHECK(!task.is_null()) << from_here.ToString();
+  return incoming_queue_->AddToIncomingQueue(from_here, std::move(task), delay,
+                                             Nestable::kNestable, priority);
+}
+
 bool MessageLoopTaskRunner::RunsTasksInCurrentSequence() const {
   AutoLock lock(valid_thread_id_lock_);
   return valid_thread_id_ == PlatformThread::CurrentId();
@@ -37,6 +37,10 @@ class BASE_EXPORT MessageLoopTaskRunner : public SingleThreadTaskRunner {
   bool PostNonNestableDelayedTask(const Location& from_here,
                                   OnceClosure task,
                                   TimeDelta delay) override;
+  bool PostDelayedTaskWithPriority(const Location& from_here,
+                                   TaskPriority priority,
+                                   OnceClosure task,
+                                   TimeDelta delay) override;
   bool RunsTasksInCurrentSequence() const override;
 
  private:
@@ -0,0 +1,394 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop/message_pump_epoll.h"
+
+#include <errno.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+#include <tuple>
+#include <utility>
+
+#include "base/auto_reset.h"
+#include "base/logging.h"
+
+namespace base {
+
+MessagePumpEpoll::FdWatchController::FdWatchController(
+    const Location& from_here,
+    Trigger trigger)
+    : FdWatchControllerInterface(from_here), trigger_(trigger) {}
+
+MessagePumpEpoll::FdWatchController::~FdWatchController() {
+  if (pump_)
+    StopWatchingFileDescriptor();
+  if (was_destroyed_) {
+    DCHECK(!*was_destroyed_);
+    *was_destroyed_ = true;
+  }
+}
+
+bool MessagePumpEpoll::FdWatchController::StopWatchingFileDescriptor() {
+  if (!pump_)
+    return true;
+  return pump_->Unregister(this);
+}
+
+MessagePumpEpoll::FdEntry::FdEntry(int fd) : fd(fd) {}
+
+MessagePumpEpoll::FdEntry::~FdEntry() = default;
+
+MessagePumpEpoll::MessagePumpEpoll() {
+  if (!Init())
+    NOTREACHED();
+}
+
+MessagePumpEpoll::MessagePumpEpoll(CustomBackend) {
+  if (!wakeup_fd_.Init())
+    NOTREACHED();
+}
+
+MessagePumpEpoll::~MessagePumpEpoll() {
+  // Detach controllers that outlive this pump so that their destructors don't
+  // reach back into it.
+  for (auto& fd_and_entry : entries_) {
+    for (FdWatchController* controller : fd_and_entry.second.controllers) {
+      controller->pump_ = nullptr;
+      controller->watcher_ = nullptr;
+    }
+  }
+}
+
+bool MessagePumpEpoll::Init() {
+  epoll_fd_.reset(epoll_create1(EPOLL_CLOEXEC));
+  if (!epoll_fd_.is_valid()) {
+    DPLOG(ERROR) << "epoll_create1";
+    return false;
+  }
+
+  if (!wakeup_fd_.Init())
+    return false;
+
+  // A null |data.ptr| identifies the wakeup fd in WaitForEpollEvents().
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.ptr = nullptr;
+  if (epoll_ctl(epoll_fd_.get(), EPOLL_CTL_ADD, wakeup_fd_.fd(), &event)) {
+    DPLOG(ERROR) << "epoll_ctl(wakeup fd)";
+    return false;
+  }
+  return true;
+}
+
+bool MessagePumpEpoll::WatchFileDescriptor(int fd,
+                                           bool persistent,
+                                           int mode,
+                                           FdWatchController* controller,
+                                           FdWatcher* delegate) {
+  DCHECK_GE(fd, 0);
+  DCHECK(controller);
+  DCHECK(delegate);
+  DCHECK(mode == WATCH_READ || mode == WATCH_WRITE || mode == WATCH_READ_WRITE);
+  // WatchFileDescriptor should be called on the pump thread. It is not
+  // threadsafe, and your watcher may never be registered.
+  DCHECK(watch_file_descriptor_caller_checker_.CalledOnValidThread());
+
+  if (controller->pump_) {
+    DCHECK_EQ(this, controller->pump_);
+    // It's illegal to use this function to listen on 2 separate fds with the
+    // same |controller|.
+    if (controller->fd_ != fd) {
+      NOTREACHED() << "FDs don't match" << controller->fd_ << "!=" << fd;
+      return false;
+    }
+    // Combine old/new interests.
+    mode |= controller->mode_;
+    persistent |= controller->persistent_;
+  }
+
+  FdEntry* entry =
+      &entries_
+           .emplace(std::piecewise_construct, std::forward_as_tuple(fd),
+                    std::forward_as_tuple(fd))
+           .first->second;
+  if (!controller->pump_) {
+    entry->controllers.push_back(controller);
+    // Dispatches under way when the watch started aren't for it.
+    controller->dispatch_sequence_ = dispatch_sequence_;
+  }
+
+  controller->pump_ = this;
+  controller->watcher_ = delegate;
+  controller->fd_ = fd;
+  controller->mode_ = mode;
+  controller->persistent_ = persistent;
+
+  if (!UpdateRegistration(entry)) {
+    Unregister(controller);
+    return false;
+  }
+  return true;
+}
+
+// Reentrant!
+void MessagePumpEpoll::Run(Delegate* delegate) {
+  AutoReset<bool> auto_reset_keep_running(&keep_running_, true);
+  AutoReset<bool> auto_reset_in_run(&in_run_, true);
+
+  for (;;) {
+    bool did_work = delegate->DoWork();
+    if (!keep_running_)
+      break;
+
+    did_work |= WaitForEvents(0);
+    if (!keep_running_)
+      break;
+
+    did_work |= delegate->DoDelayedWork(&delayed_work_time_);
+    if (!keep_running_)
+      break;
+
+    if (did_work)
+      continue;
+
+    did_work = delegate->DoIdleWork();
+    if (!keep_running_)
+      break;
+
+    if (did_work)
+      continue;
+
+    if (delayed_work_time_.is_null()) {
+      WaitForEvents(-1);
+    } else {
+      TimeDelta delay = delayed_work_time_ - TimeTicks::Now();
+      if (delay > TimeDelta()) {
+        // Round up so that the loop doesn't spin waking up just short of
+        // |delayed_work_time_|.
+        WaitForEvents(static_cast<int>(
+            std::min<int64_t>(delay.InMillisecondsRoundedUp(),
+                              std::numeric_limits<int>::max())));
+      } else {
+        // It looks like delayed_work_time_ indicates a time in the past, so we
+        // need to call DoDelayedWork now.
+        delayed_work_time_ = TimeTicks();
+      }
+    }
+
+    if (!keep_running_)
+      break;
+  }
+}
+
+void MessagePumpEpoll::Quit() {
+  DCHECK(in_run_) << "Quit was called outside of Run!";
+  keep_running_ = false;
+  ScheduleWork();
+}
+
+void MessagePumpEpoll::ScheduleWork() {
+  // This is free if a wakeup is already pending.
+  wakeup_fd_.Signal();
+}
+
+void MessagePumpEpoll::ScheduleDelayedWork(
+    const TimeTicks& delayed_work_time) {
+  // We know that we can't be blocked in WaitForEvents() right now since this
+  // method can only be called on the same thread as Run, so we only need to
+  // update our record of how long to sleep when we do sleep.
+  delayed_work_time_ = delayed_work_time;
+}
+
+bool MessagePumpEpoll::UpdateRegistration(FdEntry* entry) {
+  uint32_t events = 0;
+  bool all_edge_triggered = true;
+  for (const FdWatchController* controller : entry->controllers) {
+    if (controller->mode_ & WATCH_READ)
+      events |= EPOLLIN;
+    if (controller->mode_ & WATCH_WRITE)
+      events |= EPOLLOUT;
+    if (controller->trigger_ != Trigger::kEdge)
+      all_edge_triggered = false;
+  }
+  if (events && all_edge_triggered)
+    events |= EPOLLET;
+
+  bool success = true;
+  if (events != entry->registered_events)
+    success = UpdateInterest(entry, events);
+
+  if (entry->controllers.empty()) {
+    if (dispatch_depth_ > 0)
+      entries_pending_erasure_.push_back(entry->fd);
+    else
+      entries_.erase(entry->fd);
+  }
+  return success;
+}
+
+bool MessagePumpEpoll::Unregister(FdWatchController* controller) {
+  DCHECK_EQ(this, controller->pump_);
+  auto it = entries_.find(controller->fd_);
+  DCHECK(it != entries_.end());
+  FdEntry* entry = &it->second;
+
+  auto controller_it = std::find(entry->controllers.begin(),
+                                 entry->controllers.end(), controller);
+  DCHECK(controller_it != entry->controllers.end());
+  entry->controllers.erase(controller_it);
+
+  controller->pump_ = nullptr;
+  controller->watcher_ = nullptr;
+  controller->fd_ = -1;
+  controller->mode_ = 0;
+  controller->persistent_ = false;
+
+  return UpdateRegistration(entry);
+}
+
+bool MessagePumpEpoll::UpdateInterest(FdEntry* entry, uint32_t events) {
+  int op = EPOLL_CTL_MOD;
+  if (!entry->registered_events)
+    op = EPOLL_CTL_ADD;
+  else if (!events)
+    op = EPOLL_CTL_DEL;
+
+  epoll_event event = {};
+  event.events = events;
+  event.data.ptr = entry;
+  if (epoll_ctl(epoll_fd_.get(), op, entry->fd, &event) == 0) {
+    entry->registered_events = events;
+    return true;
+  }
+  if (op == EPOLL_CTL_DEL && (errno == EBADF || errno == ENOENT)) {
+    // The fd was closed before its watch was stopped, which already removed
+    // it from the epoll set.
+    entry->registered_events = 0;
+    return true;
+  }
+  DPLOG(ERROR) << "epoll_ctl(fd=" << entry->fd << ")";
+  return false;
+}
+
+bool MessagePumpEpoll::WaitForEvents(int timeout_ms) {
+  // On the stack rather than a member since watchers may run nested loops.
+  epoll_event events[kMaxEventsPerWait];
+  int count = epoll_wait(epoll_fd_.get(), events, kMaxEventsPerWait, timeout_ms);
+  if (count < 0) {
+    DPLOG_IF(ERROR, errno != EINTR) << "epoll_wait";
+    return false;
+  }
+
+  BeginDispatch();
+  for (int i = 0; i < count; ++i) {
+    if (!events[i].data.ptr) {
+      wakeup_fd_.Drain();
+      continue;
+    }
+    DispatchEvents(static_cast<FdEntry*>(events[i].data.ptr), events[i].events);
+  }
+  EndDispatch();
+
+  // A wakeup counts as work so that Run() goes back to DoWork() right away.
+  return count > 0;
+}
+
+void MessagePumpEpoll::BeginDispatch() {
+  ++dispatch_depth_;
+}
+
+void MessagePumpEpoll::EndDispatch() {
+  DCHECK_GT(dispatch_depth_, 0);
+  --dispatch_depth_;
+
+  if (!dispatch_depth_ && !entries_pending_erasure_.empty()) {
+    for (int fd : entries_pending_erasure_) {
+      auto it = entries_.find(fd);
+      // The fd may have been watched again since its last controller left.
+      if (it != entries_.end() && it->second.controllers.empty())
+        entries_.erase(it);
+    }
+    entries_pending_erasure_.clear();
+  }
+}
+
+void MessagePumpEpoll::DispatchEvents(FdEntry* entry, uint32_t events) {
+  // Hangups and errors are reported to both readers and writers, which will
+  // find out about them on their next read()/write(). Watches dropped since
+  // the events were reaped are filtered out through |registered_events|.
+  const bool can_write = (events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) &&
+                         (entry->registered_events & EPOLLOUT);
+  const bool can_read = (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) &&
+                        (entry->registered_events & EPOLLIN);
+
+  const int ready_mode =
+      (can_read ? WATCH_READ : 0) | (can_write ? WATCH_WRITE : 0);
+  if (!ready_mode)
+    return;
+
+  // Like libevent, every controller watching for the events is notified, the
+  // ones watching for both once with both callbacks. The controllers are
+  // looked up again after each notification, which may have changed them.
+  // |entry| itself is kept alive until the end of the batch.
+  const uint64_t dispatch_sequence = ++dispatch_sequence_;
+  while (FdWatchController* controller =
+             FindController(entry, ready_mode, dispatch_sequence)) {
+    controller->dispatch_sequence_ = dispatch_sequence;
+    NotifyController(controller, controller->mode_ & ready_mode);
+  }
+}
+
+MessagePumpEpoll::FdEntry* MessagePumpEpoll::FindEntry(int fd) {
+  auto it = entries_.find(fd);
+  return it != entries_.end() ? &it->second : nullptr;
+}
+
+// static
+MessagePumpEpoll::FdWatchController* MessagePumpEpoll::FindController(
+    FdEntry* entry,
+    int mode,
+    uint64_t dispatch_sequence) {
+  for (FdWatchController* controller : entry->controllers) {
+    if ((controller->mode_ & mode) &&
+        controller->dispatch_sequence_ < dispatch_sequence) {
+      return controller;
+    }
+  }
+  return nullptr;
+}
+
+void MessagePumpEpoll::NotifyController(FdWatchController* controller,
+                                        int mode) {
+  FdWatcher* watcher = controller->watcher_;
+  const int fd = controller->fd_;
+  const bool persistent = controller->persistent_;
+  DCHECK(watcher);
+
+  // A non-persistent watch fires once.
+  if (!persistent)
+    Unregister(controller);
+
+  if (mode == WATCH_READ_WRITE) {
+    // It is necessary to check that |controller| is not destroyed in between
+    // the two callbacks.
+    bool controller_was_destroyed = false;
+    controller->was_destroyed_ = &controller_was_destroyed;
+    watcher->OnFileCanWriteWithoutBlocking(fd);
+    // A persistent watch may have been stopped by the write callback.
+    if (!controller_was_destroyed && persistent)
+      watcher = controller->watcher_;
+    if (!controller_was_destroyed && watcher)
+      watcher->OnFileCanReadWithoutBlocking(fd);
+    if (!controller_was_destroyed)
+      controller->was_destroyed_ = nullptr;
+  } else if (mode == WATCH_WRITE) {
+    watcher->OnFileCanWriteWithoutBlocking(fd);
+  } else {
+    watcher->OnFileCanReadWithoutBlocking(fd);
+  }
+}
+
+}  // namespace base
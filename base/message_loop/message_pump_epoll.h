@@ -0,0 +1,202 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MESSAGE_LOOP_MESSAGE_PUMP_EPOLL_H_
+#define BASE_MESSAGE_LOOP_MESSAGE_PUMP_EPOLL_H_
+
+#include <stdint.h>
+#include <sys/epoll.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/files/scoped_file.h"
+#include "base/macros.h"
+#include "base/message_loop/message_pump.h"
+#include "base/message_loop/wakeup_fd_posix.h"
+#include "base/message_loop/watchable_io_message_pump_posix.h"
+#include "base/threading/thread_checker.h"
+#include "base/time/time.h"
+
+namespace base {
+
+// A MessagePump monitoring file descriptors directly through epoll(7), without
+// going through libevent. Wakeups from ScheduleWork() go through a WakeupFd and
+// delayed work is handled via the epoll_wait() timeout. Registering a watch
+// costs one epoll_ctl() call and dispatching readiness allocates nothing.
+//
+// Subclasses may replace epoll with another readiness backend by overriding
+// UpdateInterest() and WaitForEvents(); see MessagePumpIOUring.
+class BASE_EXPORT MessagePumpEpoll : public MessagePump,
+                                     public WatchableIOMessagePumpPosix {
+ public:
+  // How readiness is reported for a watch.
+  enum class Trigger {
+    // The watcher is notified for as long as the condition holds (the
+    // libevent behavior).
+    kLevel,
+    // The watcher is only notified when the condition becomes true; it must
+    // read/write until EAGAIN before it can expect another notification. Only
+    // honored if every watch on the same fd is edge-triggered.
+    kEdge,
+  };
+
+  class FdWatchController : public FdWatchControllerInterface {
+   public:
+    explicit FdWatchController(const Location& from_here,
+                               Trigger trigger = Trigger::kLevel);
+
+    // Implicitly calls StopWatchingFileDescriptor.
+    ~FdWatchController() override;
+
+    // FdWatchControllerInterface:
+    bool StopWatchingFileDescriptor() override;
+
+   private:
+    friend class MessagePumpEpoll;
+
+    const Trigger trigger_;
+
+    // The pump this controller is registered with, null if not watching.
+    MessagePumpEpoll* pump_ = nullptr;
+    FdWatcher* watcher_ = nullptr;
+    int fd_ = -1;
+    // Bitmask of WatchableIOMessagePumpPosix::Mode.
+    int mode_ = 0;
+    bool persistent_ = false;
+    // The last DispatchEvents() call which notified this controller or was
+    // under way when it started watching, so that each controller on an fd is
+    // notified once per event and only of events reaped after it started.
+    uint64_t dispatch_sequence_ = 0;
+
+    // If this pointer is non-NULL, the pointee is set to true in the
+    // destructor.
+    bool* was_destroyed_ = nullptr;
+
+    DISALLOW_COPY_AND_ASSIGN(FdWatchController);
+  };
+
+  MessagePumpEpoll();
+  ~MessagePumpEpoll() override;
+
+  bool WatchFileDescriptor(int fd,
+                           bool persistent,
+                           int mode,
+                           FdWatchController* controller,
+                           FdWatcher* delegate);
+
+  // MessagePump methods:
+  void Run(Delegate* delegate) override;
+  void Quit() override;
+  void ScheduleWork() override;
+  void ScheduleDelayedWork(const TimeTicks& delayed_work_time) override;
+
+ protected:
+  // Tag for subclasses bringing their own backend: no epoll instance is
+  // created and only |wakeup_fd_| is initialized.
+  struct CustomBackend {};
+  explicit MessagePumpEpoll(CustomBackend);
+
+  // All the watches registered on a single file descriptor, since epoll only
+  // allows one registration per fd. Referenced by epoll_event::data.ptr.
+  struct FdEntry {
+    explicit FdEntry(int fd);
+    ~FdEntry();
+
+    const int fd;
+    // The events currently registered with the backend, 0 if none.
+    uint32_t registered_events = 0;
+    // Identifies the backend request currently watching the fd, for backends
+    // with asynchronous requests. 0 if none.
+    uint64_t backend_request = 0;
+    std::vector<FdWatchController*> controllers;
+  };
+
+  // Maximum number of readiness events dispatched per WaitForEvents() call.
+  static constexpr int kMaxEventsPerWait = 64;
+
+  // Registers |events| (EPOLLIN, EPOLLOUT and EPOLLET bits, 0 to stop
+  // watching) for |entry|, which currently has |entry->registered_events|, and
+  // updates the latter. Returns false on failure.
+  virtual bool UpdateInterest(FdEntry* entry, uint32_t events);
+
+  // Waits up to |timeout_ms| for events (a negative value waits forever) and
+  // dispatches them between BeginDispatch() and EndDispatch(). Returns true if
+  // any event (including a wakeup) was processed.
+  virtual bool WaitForEvents(int timeout_ms);
+
+  // Bracket a batch of DispatchEvents() calls. FdEntries losing their last
+  // controller within a batch are only erased at the end of the outermost one.
+  void BeginDispatch();
+  void EndDispatch();
+
+  // Notifies every watcher on |entry| watching for one of |events|.
+  void DispatchEvents(FdEntry* entry, uint32_t events);
+
+  // Returns the entry watching |fd|, or null.
+  FdEntry* FindEntry(int fd);
+
+  WakeupFd* wakeup_fd() { return &wakeup_fd_; }
+
+ private:
+  // Risky part of constructor.  Returns true on success.
+  bool Init();
+
+  // Brings the registration of |entry| in line with its controllers. Erases
+  // |entry| once it has no controllers left (deferred while dispatching).
+  // Returns false if UpdateInterest() failed.
+  bool UpdateRegistration(FdEntry* entry);
+
+  // Removes |controller| from its FdEntry. Returns false if UpdateInterest()
+  // failed.
+  bool Unregister(FdWatchController* controller);
+
+  // Returns the first controller in |entry| watching for |mode| and not
+  // notified by the DispatchEvents() call |dispatch_sequence| or a later one
+  // yet, or null.
+  static FdWatchController* FindController(FdEntry* entry,
+                                           int mode,
+                                           uint64_t dispatch_sequence);
+
+  // Invokes |controller|'s watcher for |mode| and drops the watch if it isn't
+  // persistent. |controller| may be destroyed by the time this returns.
+  void NotifyController(FdWatchController* controller, int mode);
+
+  // This flag is set to false when Run should return.
+  bool keep_running_ = true;
+
+  // This flag is set when inside Run.
+  bool in_run_ = false;
+
+  // Number of event batches being dispatched (watchers may run nested
+  // loops). Erasing FdEntries is deferred until all batches are done so that
+  // pending events never point to freed memory.
+  int dispatch_depth_ = 0;
+
+  // Numbers the DispatchEvents() calls.
+  uint64_t dispatch_sequence_ = 0;
+
+  // The time at which we should call DoDelayedWork.
+  TimeTicks delayed_work_time_;
+
+  ScopedFD epoll_fd_;
+
+  // Signaled by ScheduleWork() to wake up epoll_wait().
+  WakeupFd wakeup_fd_;
+
+  // Watched file descriptors. The map is node-based so FdEntry pointers handed
+  // to epoll remain stable.
+  std::unordered_map<int, FdEntry> entries_;
+
+  // Fds whose FdEntry lost its last controller during the current dispatch.
+  std::vector<int> entries_pending_erasure_;
+
+  ThreadChecker watch_file_descriptor_caller_checker_;
+  DISALLOW_COPY_AND_ASSIGN(MessagePumpEpoll);
+};
+
+}  // namespace base
+
+#endif  // BASE_MESSAGE_LOOP_MESSAGE_PUMP_EPOLL_H_
@@ -11,7 +11,6 @@
 
 #include "base/lazy_instance.h"
 #include "base/logging.h"
-#include "base/posix/eintr_wrapper.h"
 #include "base/synchronization/lock.h"
 #include "base/threading/platform_thread.h"
 
@@ -170,7 +169,7 @@ struct MessagePumpGlib::RunState {
   int run_depth;
 
   // This keeps the state of whether the pump got signaled that there was new
-  // work to be done. Since we eat the message on the wake up pipe as soon as
+  // work to be done. Since we eat the message on the wakeup fd as soon as
   // we get it, we keep that state here to stay consistent.
   bool has_work;
 };
@@ -179,15 +178,12 @@ MessagePumpGlib::MessagePumpGlib()
     : state_(nullptr),
       context_(g_main_context_default()),
       wakeup_gpollfd_(new GPollFD) {
-  // Create our wakeup pipe, which is used to flag when work was scheduled.
-  int fds[2];
-  int ret = pipe(fds);
-  DCHECK_EQ(ret, 0);
-  (void)ret;  // Prevent warning in release mode.
-
-  wakeup_pipe_read_  = fds[0];
-  wakeup_pipe_write_ = fds[1];
-  wakeup_gpollfd_->fd = wakeup_pipe_read_;
+  // Create our wakeup fd, which is used to flag when work was scheduled.
+  bool success = wakeup_fd_.Init();
+  DCHECK(success);
+  (void)success;  // Prevent warning in release mode.
+
+  wakeup_gpollfd_->fd = wakeup_fd_.fd();
   wakeup_gpollfd_->events = G_IO_IN;
 
   work_source_ = g_source_new(&WorkSourceFuncs, sizeof(WorkSource));
@@ -206,8 +202,6 @@ MessagePumpGlib::~MessagePumpGlib() {
 #endif
   g_source_destroy(work_source_);
   g_source_unref(work_source_);
-  close(wakeup_pipe_read_);
-  close(wakeup_pipe_write_);
 }
 
 // Return the timeout we want passed to poll.
@@ -227,19 +221,10 @@ bool MessagePumpGlib::HandleCheck() {
   if (!state_)  // state_ may be null during tests.
     return false;
 
-  // We usually have a single message on the wakeup pipe, since we are only
-  // signaled when the queue went from empty to non-empty, but there can be
-  // two messages if a task posted a task, hence we read at most two bytes.
-  // The glib poll will tell us whether there was data, so this read
-  // shouldn't block.
+  // Any number of ScheduleWork() calls since the last check are consumed at
+  // once. The glib poll will tell us whether the fd was signaled.
   if (wakeup_gpollfd_->revents & G_IO_IN) {
-    char msg[2];
-    const int num_bytes = HANDLE_EINTR(read(wakeup_pipe_read_, msg, 2));
-    if (num_bytes < 1) {
-      NOTREACHED() << "Error reading from the wakeup pipe.";
-    }
-    DCHECK((num_bytes == 1 && msg[0] == '!') ||
-           (num_bytes == 2 && msg[0] == '!' && msg[1] == '!'));
+    wakeup_fd_.Drain();
     // Since we ate the message, we need to record that we have more work,
     // because HandleCheck() may be called without HandleDispatch being called
     // afterwards.
@@ -263,7 +248,7 @@ void MessagePumpGlib::HandleDispatch() {
   if (state_->delegate->DoWork()) {
     // NOTE: on Windows at this point we would call ScheduleWork (see
     // MessagePumpGlib::HandleWorkMessage in message_pump_win.cc). But here,
-    // instead of posting a message on the wakeup pipe, we can avoid the
+    // instead of signaling the wakeup fd, we can avoid the
     // syscalls and just signal that we have more work.
     state_->has_work = true;
   }
@@ -337,11 +322,9 @@ void MessagePumpGlib::Quit() {
 void MessagePumpGlib::ScheduleWork() {
   // This can be called on any thread, so we don't want to touch any state
   // variables as we would then need locks all over.  This ensures that if
-  // we are sleeping in a poll that we will wake up.
-  char msg = '!';
-  if (HANDLE_EINTR(write(wakeup_pipe_write_, &msg, 1)) != 1) {
-    NOTREACHED() << "Could not write to the UI message loop wakeup pipe!";
-  }
+  // we are sleeping in a poll that we will wake up. It is free if a wakeup is
+  // already pending.
+  wakeup_fd_.Signal();
 }
 
 void MessagePumpGlib::ScheduleDelayedWork(const TimeTicks& delayed_work_time) {
@@ -10,6 +10,7 @@
 #include "base/base_export.h"
 #include "base/macros.h"
 #include "base/message_loop/message_pump.h"
+#include "base/message_loop/wakeup_fd_posix.h"
 #include "base/observer_list.h"
 #include "base/time/time.h"
 
@@ -63,12 +64,11 @@ class BASE_EXPORT MessagePumpGlib : public MessagePump {
   // the message pump is destroyed.
   GSource* work_source_;
 
-  // We use a wakeup pipe to make sure we'll get out of the glib polling phase
+  // We use a wakeup fd to make sure we'll get out of the glib polling phase
   // when another thread has scheduled us to do some work.  There is a glib
   // mechanism g_main_context_wakeup, but this won't guarantee that our event's
   // Dispatch() will be called.
-  int wakeup_pipe_read_;
-  int wakeup_pipe_write_;
+  WakeupFd wakeup_fd_;
   // Use a unique_ptr to avoid needing the definition of GPollFD in the header.
   std::unique_ptr<GPollFD> wakeup_gpollfd_;
 
@@ -0,0 +1,205 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop/message_pump_io_uring.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/epoll.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "build/build_config.h"
+
+namespace base {
+
+// static
+std::unique_ptr<MessagePumpIOUring> MessagePumpIOUring::Create() {
+  std::unique_ptr<MessagePumpIOUring> pump(new MessagePumpIOUring);
+  if (!pump->Init())
+    return nullptr;
+  return pump;
+}
+
+MessagePumpIOUring::MessagePumpIOUring()
+    : MessagePumpEpoll(CustomBackend()) {}
+
+MessagePumpIOUring::~MessagePumpIOUring() = default;
+
+bool MessagePumpIOUring::Init() {
+  if (!ring_.Init(kSubmissionQueueEntries, kCompletionQueueEntries,
+                  IORING_FEAT_EXT_ARG)) {
+    return false;
+  }
+  cqe_skip_supported_ = ring_.features() & IORING_FEAT_CQE_SKIP;
+  return QueuePollAdd(wakeup_fd()->fd(), EPOLLIN, true, kWakeupRequest);
+}
+
+bool MessagePumpIOUring::UpdateInterest(FdEntry* entry, uint32_t events) {
+  if (entry->backend_request) {
+    if (!QueuePollRemove(entry->backend_request))
+      return false;
+    entry->backend_request = 0;
+    entry->registered_events = 0;
+  }
+  if (events && !ArmPoll(entry, events))
+    return false;
+  entry->registered_events = events;
+  return true;
+}
+
+bool MessagePumpIOUring::WaitForEvents(int timeout_ms) {
+  // Only block if there is nothing to reap yet.
+  ring_.SubmitAndWait(timeout_ms && !ring_.CompletionsReady() ? 1 : 0,
+                      timeout_ms);
+
+  // Copied out of the ring before dispatching so that nested loops run by
+  // watchers only see later completions.
+  Completion completions[kMaxEventsPerWait];
+  const uint32_t count =
+      std::min<uint32_t>(ring_.CompletionsReady(), kMaxEventsPerWait);
+  for (uint32_t i = 0; i < count; ++i) {
+    const io_uring_cqe& cqe = ring_.GetCompletion(i);
+    completions[i] = {cqe.user_data, cqe.res, cqe.flags};
+  }
+  ring_.ConsumeCompletions(count);
+
+  BeginDispatch();
+  for (uint32_t i = 0; i < count; ++i) {
+    if (completions[i].user_data == kWakeupRequest)
+      HandleWakeupCompletion(completions[i]);
+    else if (completions[i].user_data >= kFirstPollRequest)
+      HandlePollCompletion(completions[i]);
+  }
+  EndDispatch();
+
+  // A wakeup counts as work so that Run() goes back to DoWork() right away.
+  return count > 0;
+}
+
+bool MessagePumpIOUring::QueuePollAdd(int fd,
+                                      uint32_t events,
+                                      bool multishot,
+                                      uint64_t request) {
+  io_uring_sqe* sqe = ring_.GetSqe();
+  if (!sqe)
+    return false;
+#if defined(ARCH_CPU_BIG_ENDIAN)
+  // The kernel reads the two halves of |poll32_events| swapped.
+  events = (events << 16) | (events >> 16);
+#endif
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = events;
+  if (multishot && multishot_supported_)
+    sqe->len = IORING_POLL_ADD_MULTI;
+  sqe->user_data = request;
+  return true;
+}
+
+bool MessagePumpIOUring::QueuePollRemove(uint64_t request) {
+  io_uring_sqe* sqe = ring_.GetSqe();
+  if (!sqe)
+    return false;
+  sqe->opcode = IORING_OP_POLL_REMOVE;
+  sqe->fd = -1;
+  sqe->addr = request;
+  if (cqe_skip_supported_)
+    sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+  sqe->user_data = kIgnoredRequest;
+  return true;
+}
+
+bool MessagePumpIOUring::ArmPoll(FdEntry* entry, uint32_t events) {
+  DCHECK(!entry->backend_request);
+  const uint64_t request = NewRequest(entry->fd);
+  // A multishot poll reports each new readiness event, which matches the
+  // semantics of EPOLLET.
+  if (!QueuePollAdd(entry->fd, events & ~EPOLLET, events & EPOLLET,
+                    request)) {
+    FreeRequest(request);
+    return false;
+  }
+  entry->backend_request = request;
+  return true;
+}
+
+uint64_t MessagePumpIOUring::NewRequest(int fd) {
+  uint32_t index;
+  if (free_request_indices_.empty()) {
+    index = static_cast<uint32_t>(request_fds_.size());
+    request_fds_.push_back(fd);
+  } else {
+    index = free_request_indices_.back();
+    free_request_indices_.pop_back();
+    request_fds_[index] = fd;
+  }
+  return kFirstPollRequest + index;
+}
+
+void MessagePumpIOUring::FreeRequest(uint64_t request) {
+  DCHECK_GE(request, kFirstPollRequest);
+  const uint32_t index = static_cast<uint32_t>(request - kFirstPollRequest);
+  DCHECK_LT(index, request_fds_.size());
+  request_fds_[index] = -1;
+  free_request_indices_.push_back(index);
+}
+
+void MessagePumpIOUring::HandleWakeupCompletion(const Completion& completion) {
+  if (completion.result == -EINVAL && multishot_supported_) {
+    multishot_supported_ = false;
+  } else {
+    DLOG_IF(ERROR, completion.result < 0)
+        << "wakeup poll failed: " << -completion.result;
+    wakeup_fd()->Drain();
+  }
+  if (!(completion.flags & IORING_CQE_F_MORE) &&
+      !QueuePollAdd(wakeup_fd()->fd(), EPOLLIN, true, kWakeupRequest)) {
+    NOTREACHED();
+  }
+}
+
+void MessagePumpIOUring::HandlePollCompletion(const Completion& completion) {
+  const uint64_t request = completion.user_data;
+  const int fd = request_fds_[request - kFirstPollRequest];
+  const bool final_completion = !(completion.flags & IORING_CQE_F_MORE);
+  if (final_completion)
+    FreeRequest(request);
+
+  // Completions of removed polls are dropped, including those of polls on a
+  // previous file with the same fd number. |entry| stays valid until
+  // EndDispatch().
+  FdEntry* entry = FindEntry(fd);
+  if (!entry || entry->backend_request != request)
+    return;
+  if (final_completion)
+    entry->backend_request = 0;
+
+  const uint32_t registered_events = entry->registered_events;
+  if (completion.result == -EINVAL && (registered_events & EPOLLET) &&
+      multishot_supported_) {
+    // Re-armed as a one-shot poll below.
+    multishot_supported_ = false;
+  } else if (completion.result < 0) {
+    // The watchers will find out about the error on their next read() or
+    // write(). The watch isn't re-armed, it would fail the same way.
+    DLOG(ERROR) << "poll(fd=" << fd << ") failed: " << -completion.result;
+    DispatchEvents(entry, EPOLLERR);
+    if (!entry->backend_request)
+      entry->registered_events = 0;
+    return;
+  } else {
+    DispatchEvents(entry, static_cast<uint32_t>(completion.result));
+  }
+
+  // The watchers may have changed the registration, which would have armed a
+  // new poll.
+  if (!entry->backend_request && entry->registered_events &&
+      !ArmPoll(entry, entry->registered_events)) {
+    entry->registered_events = 0;
+  }
+}
+
+}  // namespace base
@@ -0,0 +1,108 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MESSAGE_LOOP_MESSAGE_PUMP_IO_URING_H_
+#define BASE_MESSAGE_LOOP_MESSAGE_PUMP_IO_URING_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/macros.h"
+#include "base/message_loop/message_pump_epoll.h"
+#include "base/posix/io_uring_linux.h"
+
+namespace base {
+
+// A MessagePumpEpoll whose readiness backend is an io_uring(7) instance
+// instead of epoll: each watch is an IORING_OP_POLL_ADD request.
+//
+// Registration changes and the re-arming of one-shot polls are only queued in
+// the submission ring; they are submitted by the same io_uring_enter() call
+// which waits for completions, and completions are reaped from the shared
+// completion ring in batches. Checking for events while there is other work
+// (WaitForEvents(0)) costs no syscall at all unless requests are queued.
+//
+// Level-triggered watches use one-shot polls, re-armed after every
+// notification, since the kernel checks for readiness when arming a poll.
+// Edge-triggered watches use multishot polls where the kernel supports them.
+//
+// A poll holds a reference to its file until the request is removed, so a
+// file closed while still being watched only goes away once the pump next
+// submits requests.
+//
+// Requires Linux 5.11 (IORING_FEAT_EXT_ARG for wait timeouts). Create()
+// returns null if io_uring is unavailable, e.g. on older kernels or when
+// blocked by a seccomp policy or the kernel.io_uring_disabled sysctl, in which
+// case MessageLoop falls back to MessagePumpEpoll.
+class BASE_EXPORT MessagePumpIOUring : public MessagePumpEpoll {
+ public:
+  // Returns null if io_uring can't be set up.
+  static std::unique_ptr<MessagePumpIOUring> Create();
+
+  ~MessagePumpIOUring() override;
+
+ protected:
+  // MessagePumpEpoll:
+  bool UpdateInterest(FdEntry* entry, uint32_t events) override;
+  bool WaitForEvents(int timeout_ms) override;
+
+ private:
+  struct Completion {
+    uint64_t user_data;
+    int32_t result;
+    uint32_t flags;
+  };
+
+  static constexpr uint32_t kSubmissionQueueEntries = 256;
+  static constexpr uint32_t kCompletionQueueEntries = 1024;
+
+  // |user_data| of requests whose completion is ignored.
+  static constexpr uint64_t kIgnoredRequest = 0;
+  // |user_data| of the poll on the wakeup fd.
+  static constexpr uint64_t kWakeupRequest = 1;
+  // |user_data| of the poll at index i of |request_fds_|.
+  static constexpr uint64_t kFirstPollRequest = 2;
+
+  MessagePumpIOUring();
+
+  // Sets up the rings. Returns false if io_uring is unavailable.
+  bool Init();
+
+  // Queue a poll for |events| on |fd|, multishot if |multishot| and
+  // supported, and the removal of the poll identified by |request|.
+  bool QueuePollAdd(int fd, uint32_t events, bool multishot, uint64_t request);
+  bool QueuePollRemove(uint64_t request);
+
+  // Queues a poll for |events| on |entry| and makes it its backend request.
+  bool ArmPoll(FdEntry* entry, uint32_t events);
+
+  // Allocates and releases poll request identifiers.
+  uint64_t NewRequest(int fd);
+  void FreeRequest(uint64_t request);
+
+  void HandleWakeupCompletion(const Completion& completion);
+  void HandlePollCompletion(const Completion& completion);
+
+  internal::IOUring ring_;
+
+  // Cleared when the kernel rejects IORING_POLL_ADD_MULTI (before 5.13).
+  bool multishot_supported_ = true;
+  // Whether successful removals can skip their completion (Linux 5.17).
+  bool cqe_skip_supported_ = false;
+
+  // The fd watched by each poll request, indexed by request identifier minus
+  // kFirstPollRequest. A request is live from its submission until its final
+  // completion, possibly past the FdEntry it was submitted for.
+  std::vector<int> request_fds_;
+  std::vector<uint32_t> free_request_indices_;
+
+  DISALLOW_COPY_AND_ASSIGN(MessagePumpIOUring);
+};
+
+}  // namespace base
+
+#endif  // BASE_MESSAGE_LOOP_MESSAGE_PUMP_IO_URING_H_
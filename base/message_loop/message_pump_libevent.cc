@@ -4,16 +4,11 @@
 
 #include "base/message_loop/message_pump_libevent.h"
 
-#include <errno.h>
-#include <unistd.h>
-
 #include <utility>
 
 #include "base/auto_reset.h"
 #include "base/compiler_specific.h"
-#include "base/files/file_util.h"
 #include "base/logging.h"
-#include "base/posix/eintr_wrapper.h"
 #include "base/third_party/libevent/event.h"
 #include "base/time/time.h"
 //#include "base/trace_event/trace_event.h"
@@ -101,9 +96,7 @@ MessagePumpLibevent::MessagePumpLibevent()
     : keep_running_(true),
       in_run_(false),
       processed_io_events_(false),
-      event_base_(event_base_new()),
-      wakeup_pipe_in_(-1),
-      wakeup_pipe_out_(-1) {
+      event_base_(event_base_new()) {
   if (!Init())
     NOTREACHED();
 }
@@ -113,14 +106,6 @@ MessagePumpLibevent::~MessagePumpLibevent() {
   DCHECK(event_base_);
   event_del(wakeup_event_);
   delete wakeup_event_;
-  if (wakeup_pipe_in_ >= 0) {
-    if (IGNORE_EINTR(close(wakeup_pipe_in_)) < 0)
-      DPLOG(ERROR) << "close";
-  }
-  if (wakeup_pipe_out_ >= 0) {
-    if (IGNORE_EINTR(close(wakeup_pipe_out_)) < 0)
-      DPLOG(ERROR) << "close";
-  }
   event_base_free(event_base_);
 }
 
@@ -267,10 +252,8 @@ void MessagePumpLibevent::Quit() {
 
 void MessagePumpLibevent::ScheduleWork() {
   // Tell libevent (in a threadsafe way) that it should break out of its loop.
-  char buf = 0;
-  int nwrite = HANDLE_EINTR(write(wakeup_pipe_in_, &buf, 1));
-  DCHECK(nwrite == 1 || errno == EAGAIN)
-      << "[nwrite:" << nwrite << "] [errno:" << errno << "]";
+  // This is free if a wakeup is already pending.
+  wakeup_fd_.Signal();
 }
 
 void MessagePumpLibevent::ScheduleDelayedWork(
@@ -282,17 +265,12 @@ void MessagePumpLibevent::ScheduleDelayedWork(
 }
 
 bool MessagePumpLibevent::Init() {
-  int fds[2];
-  if (!CreateLocalNonBlockingPipe(fds)) {
-    DPLOG(ERROR) << "pipe creation failed";
+  if (!wakeup_fd_.Init())
     return false;
-  }
-  wakeup_pipe_out_ = fds[0];
-  wakeup_pipe_in_ = fds[1];
 
   wakeup_event_ = new event;
-  event_set(wakeup_event_, wakeup_pipe_out_, EV_READ | EV_PERSIST,
-            OnWakeup, this);
+  event_set(wakeup_event_, wakeup_fd_.fd(), EV_READ | EV_PERSIST, OnWakeup,
+            this);
   event_base_set(event_base_, wakeup_event_);
 
   if (event_add(wakeup_event_, nullptr))
@@ -332,16 +310,14 @@ void MessagePumpLibevent::OnLibeventNotification(int fd,
   }
 }
 
-// Called if a byte is received on the wakeup pipe.
+// Called if the wakeup fd was signaled.
 // static
 void MessagePumpLibevent::OnWakeup(int socket, short flags, void* context) {
   MessagePumpLibevent* that = static_cast<MessagePumpLibevent*>(context);
-  DCHECK(that->wakeup_pipe_out_ == socket);
+  DCHECK(that->wakeup_fd_.fd() == socket);
 
-  // Remove and discard the wakeup byte.
-  char buf;
-  int nread = HANDLE_EINTR(read(socket, &buf, 1));
-  DCHECK_EQ(nread, 1);
+  // Consume all pending wakeups at once.
+  that->wakeup_fd_.Drain();
   that->processed_io_events_ = true;
   // Tell libevent to break out of inner loop.
   event_base_loopbreak(that->event_base_);
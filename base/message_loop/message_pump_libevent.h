@@ -10,6 +10,7 @@
 #include "base/compiler_specific.h"
 #include "base/macros.h"
 #include "base/message_loop/message_pump.h"
+#include "base/message_loop/wakeup_fd_posix.h"
 #include "base/message_loop/watchable_io_message_pump_posix.h"
 #include "base/threading/thread_checker.h"
 #include "base/time/time.h"
@@ -87,8 +88,7 @@ class BASE_EXPORT MessagePumpLibevent : public MessagePump,
   // Called by libevent to tell us a registered FD can be read/written to.
   static void OnLibeventNotification(int fd, short flags, void* context);
 
-  // Unix pipe used to implement ScheduleWork()
-  // ... callback; called by libevent inside Run() when pipe is ready to read
+  // Called by libevent inside Run() when |wakeup_fd_| is ready to read.
   static void OnWakeup(int socket, short flags, void* context);
 
   // This flag is set to false when Run should return.
@@ -107,11 +107,10 @@ class BASE_EXPORT MessagePumpLibevent : public MessagePump,
   // readiness callbacks when a socket is ready for I/O.
   event_base* event_base_;
 
-  // ... write end; ScheduleWork() writes a single byte to it
-  int wakeup_pipe_in_;
-  // ... read end; OnWakeup reads it and then breaks Run() out of its sleep
-  int wakeup_pipe_out_;
-  // ... libevent wrapper for read end
+  // Signaled by ScheduleWork(); OnWakeup drains it and then breaks Run() out
+  // of its sleep.
+  WakeupFd wakeup_fd_;
+  // ... libevent wrapper for |wakeup_fd_|
   event* wakeup_event_;
 
   ThreadChecker watch_file_descriptor_caller_checker_;
@@ -0,0 +1,174 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop/pending_task_pool.h"
+
+#include <new>
+#include <utility>
+
+namespace base {
+namespace internal {
+
+namespace {
+
+constexpr uint64_t kFreeListIndexMask = 0xffffffff;
+constexpr uint64_t kFreeListTagIncrement = uint64_t{1} << 32;
+
+}  // namespace
+
+PendingTaskNode::PendingTaskNode() {}
+
+PendingTaskNode::~PendingTaskNode() {}
+
+PendingTaskList::PendingTaskList() = default;
+
+PendingTaskList::~PendingTaskList() {
+  DCHECK(empty());
+}
+
+void PendingTaskList::Push(PendingTaskNode* node) {
+  node->next.store(nullptr, std::memory_order_relaxed);
+  if (tail_)
+    tail_->next.store(node, std::memory_order_relaxed);
+  else
+    head_ = node;
+  tail_ = node;
+  ++size_;
+}
+
+PendingTaskNode* PendingTaskList::PopFront() {
+  DCHECK(head_);
+  PendingTaskNode* node = head_;
+  head_ = node->next.load(std::memory_order_relaxed);
+  if (!head_)
+    tail_ = nullptr;
+  --size_;
+  return node;
+}
+
+void PendingTaskList::Append(PendingTaskList* other) {
+  if (other->empty())
+    return;
+  if (tail_)
+    tail_->next.store(other->head_, std::memory_order_relaxed);
+  else
+    head_ = other->head_;
+  tail_ = other->tail_;
+  size_ += other->size_;
+  other->head_ = other->tail_ = nullptr;
+  other->size_ = 0;
+}
+
+void PendingTaskList::Clear(PendingTaskPool* pool) {
+  while (!empty())
+    pool->Delete(PopFront());
+}
+
+struct PendingTaskPool::Slab {
+  PendingTaskNode nodes[kNodesPerSlab];
+};
+
+PendingTaskPool::PendingTaskPool() = default;
+
+PendingTaskPool::~PendingTaskPool() {
+#if DCHECK_IS_ON()
+  DCHECK_EQ(0, num_live_nodes_.load(std::memory_order_relaxed));
+#endif
+  for (std::atomic<Slab*>& slab : slabs_)
+    delete slab.load(std::memory_order_relaxed);
+}
+
+PendingTaskNode* PendingTaskPool::New(PendingTask pending_task) {
+  PendingTaskNode* node = PopFreeNode();
+  if (!node)
+    node = AllocateSlab();
+  if (!node) {
+    node = new PendingTaskNode;
+    node->index_ = kUnpooledIndex;
+  }
+  new (&node->pending_task) PendingTask(std::move(pending_task));
+#if DCHECK_IS_ON()
+  num_live_nodes_.fetch_add(1, std::memory_order_relaxed);
+#endif
+  return node;
+}
+
+void PendingTaskPool::Delete(PendingTaskNode* node) {
+  node->pending_task.~PendingTask();
+#if DCHECK_IS_ON()
+  num_live_nodes_.fetch_sub(1, std::memory_order_relaxed);
+#endif
+  if (node->index_ == kUnpooledIndex) {
+    delete node;
+    return;
+  }
+  PushFreeNodes(node, node);
+}
+
+PendingTaskNode* PendingTaskPool::NodeAt(uint32_t index) const {
+  const Slab* slab =
+      slabs_[index / kNodesPerSlab].load(std::memory_order_acquire);
+  DCHECK(slab);
+  return const_cast<PendingTaskNode*>(&slab->nodes[index % kNodesPerSlab]);
+}
+
+PendingTaskNode* PendingTaskPool::PopFreeNode() {
+  uint64_t head = free_list_head_.load(std::memory_order_acquire);
+  while (head & kFreeListIndexMask) {
+    PendingTaskNode* node =
+        NodeAt(static_cast<uint32_t>(head & kFreeListIndexMask) - 1);
+    // |node| may be popped and reused by another thread past this point, in
+    // which case the value read is stale but the tag makes the exchange fail.
+    const uint32_t next = node->next_free_.load(std::memory_order_relaxed);
+    const uint64_t new_head = ((head & ~kFreeListIndexMask) +
+                               kFreeListTagIncrement) |
+                              next;
+    if (free_list_head_.compare_exchange_weak(head, new_head,
+                                              std::memory_order_acquire,
+                                              std::memory_order_acquire)) {
+      return node;
+    }
+  }
+  return nullptr;
+}
+
+void PendingTaskPool::PushFreeNodes(PendingTaskNode* first,
+                                    PendingTaskNode* last) {
+  uint64_t head = free_list_head_.load(std::memory_order_relaxed);
+  uint64_t new_head;
+  do {
+    last->next_free_.store(static_cast<uint32_t>(head & kFreeListIndexMask),
+                           std::memory_order_relaxed);
+    new_head = ((head & ~kFreeListIndexMask) + kFreeListTagIncrement) |
+               (first->index_ + 1);
+  } while (!free_list_head_.compare_exchange_weak(head, new_head,
+                                                  std::memory_order_release,
+                                                  std::memory_order_relaxed));
+}
+
+PendingTaskNode* PendingTaskPool::AllocateSlab() {
+  if (num_slabs_.load(std::memory_order_relaxed) >= kMaxSlabs)
+    return nullptr;
+  const uint32_t slab_index =
+      num_slabs_.fetch_add(1, std::memory_order_relaxed);
+  if (slab_index >= kMaxSlabs)
+    return nullptr;
+
+  Slab* slab = new Slab;
+  const uint32_t first_index = slab_index * kNodesPerSlab;
+  for (uint32_t i = 0; i < kNodesPerSlab; ++i) {
+    slab->nodes[i].index_ = first_index + i;
+    // Chains nodes 1 to kNodesPerSlab - 1 for PushFreeNodes().
+    slab->nodes[i].next_free_.store(first_index + i + 2,
+                                    std::memory_order_relaxed);
+  }
+  // Published before any of its nodes can be reached from |free_list_head_|.
+  slabs_[slab_index].store(slab, std::memory_order_release);
+
+  PushFreeNodes(&slab->nodes[1], &slab->nodes[kNodesPerSlab - 1]);
+  return &slab->nodes[0];
+}
+
+}  // namespace internal
+}  // namespace base
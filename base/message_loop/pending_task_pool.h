@@ -0,0 +1,147 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MESSAGE_LOOP_PENDING_TASK_POOL_H_
+#define BASE_MESSAGE_LOOP_PENDING_TASK_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "base/base_export.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/pending_task.h"
+
+namespace base {
+namespace internal {
+
+class PendingTaskPool;
+
+// A PendingTask allocated from a PendingTaskPool, linked into at most one
+// intrusive queue at a time through |next|.
+struct BASE_EXPORT PendingTaskNode {
+  PendingTaskNode();
+  ~PendingTaskNode();
+
+  // Constructed by PendingTaskPool::New(), destroyed by
+  // PendingTaskPool::Delete().
+  union {
+    PendingTask pending_task;
+  };
+
+  // The next node in the queue holding this node. Atomic for
+  // LockFreeTaskQueue, relaxed accesses elsewhere.
+  std::atomic<PendingTaskNode*> next{nullptr};
+
+ private:
+  friend class PendingTaskPool;
+
+  // Index of this node in its pool, or kUnpooledIndex if it was allocated on
+  // the heap because the pool was full.
+  uint32_t index_ = 0;
+
+  // While the node is free, the index + 1 of the next free node, 0 for none.
+  std::atomic<uint32_t> next_free_{0};
+
+  DISALLOW_COPY_AND_ASSIGN(PendingTaskNode);
+};
+
+// A FIFO of PendingTaskNodes linked through their |next| member. Doesn't own
+// the nodes: they must be returned to their pool with Clear() or PopFront()
+// before the list goes away. Not thread-safe.
+class BASE_EXPORT PendingTaskList {
+ public:
+  PendingTaskList();
+  ~PendingTaskList();
+
+  bool empty() const { return !head_; }
+  size_t size() const { return size_; }
+
+  // Returns the oldest node. !empty() is assumed.
+  PendingTaskNode* front() const {
+    DCHECK(head_);
+    return head_;
+  }
+
+  // Appends |node|.
+  void Push(PendingTaskNode* node);
+
+  // Removes and returns the oldest node. !empty() is assumed.
+  PendingTaskNode* PopFront();
+
+  // Moves all nodes of |other| to the end of this list, in O(1).
+  void Append(PendingTaskList* other);
+
+  // Deletes all nodes into |pool|.
+  void Clear(PendingTaskPool* pool);
+
+ private:
+  PendingTaskNode* head_ = nullptr;
+  PendingTaskNode* tail_ = nullptr;
+  size_t size_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(PendingTaskList);
+};
+
+// A slab allocator of PendingTaskNodes. Nodes are carved out of slabs of
+// kNodesPerSlab nodes which are only freed with the pool, so that once the
+// pool has grown to the peak number of pending tasks, posting and running a
+// task doesn't allocate.
+//
+// New() and Delete() are lock-free and may be called from any thread: free
+// nodes form a Treiber stack whose head is tagged with a counter against ABA.
+// Past kMaxSlabs slabs, nodes come from the heap.
+class BASE_EXPORT PendingTaskPool {
+ public:
+  PendingTaskPool();
+
+  // All nodes must have been deleted.
+  ~PendingTaskPool();
+
+  // Returns a node holding |pending_task|.
+  PendingTaskNode* New(PendingTask pending_task);
+
+  // Destroys the task of |node| and returns |node| to the pool.
+  void Delete(PendingTaskNode* node);
+
+ private:
+  static constexpr uint32_t kNodesPerSlab = 64;
+  static constexpr uint32_t kMaxSlabs = 1024;
+  static constexpr uint32_t kUnpooledIndex = ~uint32_t{0};
+
+  struct Slab;
+
+  PendingTaskNode* NodeAt(uint32_t index) const;
+
+  // Returns a free node, or null if there are none.
+  PendingTaskNode* PopFreeNode();
+
+  // Pushes the nodes |first| to |last|, already linked through |next_free_|,
+  // on the free list.
+  void PushFreeNodes(PendingTaskNode* first, PendingTaskNode* last);
+
+  // Returns a free node from a new slab, the rest of which is added to the
+  // free list, or null if the pool has kMaxSlabs slabs.
+  PendingTaskNode* AllocateSlab();
+
+  // The index + 1 of the first free node in the low 32 bits, 0 if none. The
+  // high 32 bits are bumped by every update.
+  std::atomic<uint64_t> free_list_head_{0};
+
+  std::atomic<uint32_t> num_slabs_{0};
+  std::atomic<Slab*> slabs_[kMaxSlabs] = {};
+
+#if DCHECK_IS_ON()
+  std::atomic<int> num_live_nodes_{0};
+#endif
+
+  DISALLOW_COPY_AND_ASSIGN(PendingTaskPool);
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_MESSAGE_LOOP_PENDING_TASK_POOL_H_
@@ -0,0 +1,84 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop/wakeup_fd_posix.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "base/files/file_util.h"
+#include "base/logging.h"
+#include "base/posix/eintr_wrapper.h"
+#include "build/build_config.h"
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include <sys/eventfd.h>
+#endif
+
+namespace base {
+
+WakeupFd::WakeupFd() = default;
+
+WakeupFd::~WakeupFd() = default;
+
+bool WakeupFd::Init() {
+  DCHECK(!read_fd_.is_valid());
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  read_fd_.reset(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+  if (read_fd_.is_valid())
+    return true;
+  DPLOG(ERROR) << "eventfd";
+#endif
+
+  int fds[2];
+  if (!CreateLocalNonBlockingPipe(fds)) {
+    DPLOG(ERROR) << "pipe creation failed";
+    return false;
+  }
+  read_fd_.reset(fds[0]);
+  write_fd_.reset(fds[1]);
+  return true;
+}
+
+void WakeupFd::Signal() {
+  // Skip the syscall if a wakeup is already pending.
+  if (armed_.exchange(true, std::memory_order_acq_rel))
+    return;
+
+  if (!write_fd_.is_valid()) {
+    const uint64_t increment = 1;
+    ssize_t nwrite =
+        HANDLE_EINTR(write(read_fd_.get(), &increment, sizeof(increment)));
+    DCHECK_EQ(nwrite, static_cast<ssize_t>(sizeof(increment)));
+    return;
+  }
+
+  char buf = 0;
+  ssize_t nwrite = HANDLE_EINTR(write(write_fd_.get(), &buf, 1));
+  DCHECK(nwrite == 1 || errno == EAGAIN)
+      << "[nwrite:" << nwrite << "] [errno:" << errno << "]";
+}
+
+void WakeupFd::Drain() {
+  if (!write_fd_.is_valid()) {
+    // Reading an eventfd returns and resets its whole counter.
+    uint64_t value;
+    ssize_t nread = HANDLE_EINTR(read(read_fd_.get(), &value, sizeof(value)));
+    DCHECK(nread == sizeof(value) || errno == EAGAIN)
+        << "[nread:" << nread << "] [errno:" << errno << "]";
+  } else {
+    char buf[64];
+    while (HANDLE_EINTR(read(read_fd_.get(), buf, sizeof(buf))) > 0) {
+    }
+  }
+
+  // Disarm only after emptying the fd, so that it is never left empty while
+  // armed (which would swallow the next Signal()). A Signal() landing in
+  // between is absorbed; the exchange synchronizes with it so that the work it
+  // announced is visible to the caller.
+  armed_.exchange(false, std::memory_order_acq_rel);
+}
+
+}  // namespace base
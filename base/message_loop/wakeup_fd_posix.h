@@ -0,0 +1,59 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MESSAGE_LOOP_WAKEUP_FD_POSIX_H_
+#define BASE_MESSAGE_LOOP_WAKEUP_FD_POSIX_H_
+
+#include <atomic>
+
+#include "base/base_export.h"
+#include "base/files/scoped_file.h"
+#include "base/macros.h"
+
+namespace base {
+
+// A file descriptor which message pumps poll for readability in order to be
+// woken up from other threads. Backed by an eventfd where available and by a
+// pipe otherwise.
+//
+// Signals are coalesced: while a wakeup is pending (signaled but not yet
+// drained), Signal() is a single atomic operation and makes no syscall, and a
+// single Drain() consumes any number of signals.
+class BASE_EXPORT WakeupFd {
+ public:
+  WakeupFd();
+  ~WakeupFd();
+
+  // Creates the underlying file descriptor(s). Returns false on failure.
+  bool Init();
+
+  // The file descriptor to poll for readability.
+  int fd() const { return read_fd_.get(); }
+
+  // Makes fd() readable unless a wakeup is already pending. May be called from
+  // any thread.
+  void Signal();
+
+  // Consumes the pending wakeup. Must be called on the polling thread once
+  // fd() was reported readable, before it does the work it was woken up for:
+  // Signal() calls racing with Drain() may be absorbed, but only in favor of
+  // that work.
+  void Drain();
+
+ private:
+  ScopedFD read_fd_;
+
+  // Write end of the pipe; invalid when backed by an eventfd (|read_fd_| is
+  // used for both ends).
+  ScopedFD write_fd_;
+
+  // True from the first Signal() following a Drain() until the next Drain().
+  std::atomic<bool> armed_{false};
+
+  DISALLOW_COPY_AND_ASSIGN(WakeupFd);
+};
+
+}  // namespace base
+
+#endif  // BASE_MESSAGE_LOOP_WAKEUP_FD_POSIX_H_
@@ -15,7 +15,7 @@
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
 #include "base/logging.h"
-#include "base/synchronization/lock.h"
+#include "base/synchronization/read_write_lock.h"
 #include "build/build_config.h"
 
 namespace base {
@@ -117,7 +117,8 @@ Provider base_provider_posix = {
 
 
 struct PathData {
-  Lock lock;
+  // Held for reading by Get(), which only writes to hold a computed path.
+  ReadWriteLock lock;
   PathMap cache;        // Cache mappings from path key to path value.
   PathMap overrides;    // Track path overrides.
   Provider* providers;  // Linked list of path service providers.
@@ -157,13 +158,14 @@ bool LockedGetFromCache(int key, const PathData* path_data, FilePath* result) {
 }
 
 // Tries to find |key| in the overrides map. |path_data| should be locked by the
-// caller!
-bool LockedGetFromOverrides(int key, PathData* path_data, FilePath* result) {
+// caller, possibly only for reading! Overrides aren't cached: looking them up
+// costs the same.
+bool LockedGetFromOverrides(int key,
+                            const PathData* path_data,
+                            FilePath* result) {
   // check for an overridden version.
   PathMap::const_iterator it = path_data->overrides.find(key);
   if (it != path_data->overrides.end()) {
-    if (!path_data->cache_disabled)
-      path_data->cache[key] = it->second;
     *result = it->second;
     return true;
   }
@@ -188,7 +190,7 @@ bool PathService::Get(int key, FilePath* result) {
 
   Provider* provider = nullptr;
   {
-    AutoLock scoped_lock(path_data->lock);
+    AutoReadLock scoped_lock(path_data->lock);
     if (LockedGetFromCache(key, path_data, result))
       return true;
 
@@ -221,7 +223,7 @@ bool PathService::Get(int key, FilePath* result) {
   }
   *result = path;
 
-  AutoLock scoped_lock(path_data->lock);
+  AutoWriteLock scoped_lock(path_data->lock);
   if (!path_data->cache_disabled)
     path_data->cache[key] = path;
 
@@ -264,7 +266,7 @@ bool PathService::OverrideAndCreateIfNeeded(int key,
   }
   DCHECK(file_path.IsAbsolute());
 
-  AutoLock scoped_lock(path_data->lock);
+  AutoWriteLock scoped_lock(path_data->lock);
 
   // Clear the cache now. Some of its entries could have depended
   // on the value we are overriding, and are now out of sync with reality.
@@ -280,7 +282,7 @@ bool PathService::RemoveOverride(int key) {
   PathData* path_data = GetPathData();
   DCHECK(path_data);
 
-  AutoLock scoped_lock(path_data->lock);
+  AutoWriteLock scoped_lock(path_data->lock);
 
   if (path_data->overrides.find(key) == path_data->overrides.end())
     return false;
@@ -311,7 +313,7 @@ void PathService::RegisterProvider(ProviderFunc func, int key_start,
   p->key_end = key_end;
 #endif
 
-  AutoLock scoped_lock(path_data->lock);
+  AutoWriteLock scoped_lock(path_data->lock);
 
 #ifndef NDEBUG
   Provider *iter = path_data->providers;
@@ -331,7 +333,7 @@ void PathService::DisableCache() {
   PathData* path_data = GetPathData();
   DCHECK(path_data);
 
-  AutoLock scoped_lock(path_data->lock);
+  AutoWriteLock scoped_lock(path_data->lock);
   path_data->cache.clear();
   path_data->cache_disabled = true;
 }
@@ -11,6 +11,7 @@
 #include "base/callback.h"
 #include "base/containers/queue.h"
 #include "base/location.h"
+#include "base/task_scheduler/task_priority.h"
 #include "base/time/time.h"
 
 namespace base {
@@ -44,6 +45,10 @@ struct BASE_EXPORT PendingTask {
   // The time when the task should be run.
   base::TimeTicks delayed_run_time;
 
+  // The time this task was posted. Only set while debug::TaskLatencyStats is
+  // enabled.
+  base::TimeTicks queue_time;
+
   // Chain of up-to-four symbols of the parent tasks which led to this one being
   // posted.
   std::array<const void*, 4> task_backtrace = {};
@@ -56,6 +61,10 @@ struct BASE_EXPORT PendingTask {
 
   // Needs high resolution timers.
   bool is_high_res = false;
+
+  // Order in which a MessageLoop runs this task relative to other immediate
+  // tasks.
+  TaskPriority priority = TaskPriority::USER_VISIBLE;
 };
 
 using TaskQueue = base::queue<PendingTask>;
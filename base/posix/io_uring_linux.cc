@@ -0,0 +1,197 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/posix/io_uring_linux.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "base/atomicops.h"
+#include "base/logging.h"
+
+namespace base {
+namespace internal {
+
+namespace {
+
+// Accessors for the ring indices shared with the kernel.
+uint32_t LoadAcquire(const uint32_t* index) {
+  return static_cast<uint32_t>(subtle::Acquire_Load(
+      reinterpret_cast<volatile const subtle::Atomic32*>(index)));
+}
+
+void StoreRelease(uint32_t* index, uint32_t value) {
+  subtle::Release_Store(reinterpret_cast<volatile subtle::Atomic32*>(index),
+                        static_cast<subtle::Atomic32>(value));
+}
+
+}  // namespace
+
+IOUring::IOUring() = default;
+
+IOUring::~IOUring() {
+  // Closing |ring_fd_| cancels all requests.
+  if (sqes_)
+    munmap(sqes_, sqes_size_);
+  if (ring_)
+    munmap(ring_, ring_size_);
+}
+
+bool IOUring::Init(uint32_t sq_entries,
+                   uint32_t cq_entries,
+                   uint32_t required_features) {
+  DCHECK(!ring_fd_.is_valid());
+  io_uring_params params = {};
+  params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+  params.cq_entries = cq_entries;
+  ring_fd_.reset(
+      static_cast<int>(syscall(__NR_io_uring_setup, sq_entries, &params)));
+  if (!ring_fd_.is_valid()) {
+    DVPLOG(1) << "io_uring_setup";
+    return false;
+  }
+
+  required_features |= IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP;
+  features_ = params.features;
+  if ((features_ & required_features) != required_features) {
+    DVLOG(1) << "io_uring lacks features, has " << features_;
+    return false;
+  }
+
+  ring_size_ = std::max<size_t>(
+      params.sq_off.array + params.sq_entries * sizeof(uint32_t),
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+  void* ring = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_.get(),
+                    IORING_OFF_SQ_RING);
+  if (ring == MAP_FAILED) {
+    DPLOG(ERROR) << "mmap(io_uring rings)";
+    return false;
+  }
+  ring_ = ring;
+
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_.get(), IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    DPLOG(ERROR) << "mmap(io_uring sqes)";
+    return false;
+  }
+  sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+  char* base = static_cast<char*>(ring_);
+  sq_head_ = reinterpret_cast<uint32_t*>(base + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<uint32_t*>(base + params.sq_off.tail);
+  sq_flags_ = reinterpret_cast<uint32_t*>(base + params.sq_off.flags);
+  sq_mask_ = *reinterpret_cast<uint32_t*>(base + params.sq_off.ring_mask);
+  sq_entries_ = params.sq_entries;
+  cq_head_ = reinterpret_cast<uint32_t*>(base + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<uint32_t*>(base + params.cq_off.tail);
+  cq_mask_ = *reinterpret_cast<uint32_t*>(base + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+  sqe_tail_ = *sq_tail_;
+
+  // Slot i of the submission ring always refers to entry i of |sqes_|.
+  uint32_t* sq_array = reinterpret_cast<uint32_t*>(base + params.sq_off.array);
+  for (uint32_t i = 0; i < sq_entries_; ++i)
+    sq_array[i] = i;
+  return true;
+}
+
+io_uring_sqe* IOUring::GetSqe() {
+  if (sqe_tail_ - LoadAcquire(sq_head_) >= sq_entries_) {
+    Submit();
+    if (sqe_tail_ - LoadAcquire(sq_head_) >= sq_entries_) {
+      DLOG(ERROR) << "io_uring submission queue full";
+      return nullptr;
+    }
+  }
+  io_uring_sqe* sqe = &sqes_[sqe_tail_ & sq_mask_];
+  ++sqe_tail_;
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+void IOUring::Submit() {
+  SubmitAndWait(0, 0);
+}
+
+void IOUring::SubmitAndWait(uint32_t min_complete, int timeout_ms) {
+  const uint32_t to_submit = sqe_tail_ - LoadAcquire(sq_head_);
+  // With IORING_FEAT_NODROP, completions which didn't fit in the ring are
+  // only flushed to it by an io_uring_enter() asking for events.
+  const bool cq_overflow = LoadAcquire(sq_flags_) & IORING_SQ_CQ_OVERFLOW;
+  if (!to_submit && !min_complete && !cq_overflow)
+    return;
+  StoreRelease(sq_tail_, sqe_tail_);
+  Enter(to_submit, min_complete, timeout_ms);
+}
+
+void IOUring::Wait(uint32_t min_complete) {
+  Enter(0, min_complete, -1);
+}
+
+uint32_t IOUring::CompletionsReady() const {
+  return LoadAcquire(cq_tail_) - *cq_head_;
+}
+
+const io_uring_cqe& IOUring::GetCompletion(uint32_t index) const {
+  DCHECK_LT(index, CompletionsReady());
+  return cqes_[(*cq_head_ + index) & cq_mask_];
+}
+
+void IOUring::ConsumeCompletions(uint32_t count) {
+  DCHECK_LE(count, CompletionsReady());
+  StoreRelease(cq_head_, *cq_head_ + count);
+}
+
+int IOUring::Register(unsigned int opcode,
+                      const void* arg,
+                      unsigned int nr_args) {
+  const long result = syscall(__NR_io_uring_register, ring_fd_.get(), opcode,
+                              arg, nr_args);
+  return result < 0 ? -errno : static_cast<int>(result);
+}
+
+void IOUring::Enter(uint32_t to_submit,
+                    uint32_t min_complete,
+                    int timeout_ms) {
+  const bool cq_overflow = LoadAcquire(sq_flags_) & IORING_SQ_CQ_OVERFLOW;
+  uint32_t flags = 0;
+  if (min_complete || cq_overflow)
+    flags |= IORING_ENTER_GETEVENTS;
+
+  __kernel_timespec timeout = {};
+  io_uring_getevents_arg arg = {};
+  const void* argp = nullptr;
+  size_t argsz = 0;
+  if (min_complete && timeout_ms >= 0) {
+    DCHECK(features_ & IORING_FEAT_EXT_ARG);
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = reinterpret_cast<uint64_t>(&timeout);
+    flags |= IORING_ENTER_EXT_ARG;
+    argp = &arg;
+    argsz = sizeof(arg);
+  }
+
+  if (syscall(__NR_io_uring_enter, ring_fd_.get(), to_submit, min_complete,
+              flags, argp, argsz) < 0) {
+    DPLOG_IF(ERROR, errno != EINTR && errno != ETIME && errno != EBUSY &&
+                        errno != EAGAIN)
+        << "io_uring_enter";
+  }
+}
+
+}  // namespace internal
+}  // namespace base
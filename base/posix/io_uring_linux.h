@@ -0,0 +1,108 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_POSIX_IO_URING_LINUX_H_
+#define BASE_POSIX_IO_URING_LINUX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "base/base_export.h"
+#include "base/files/scoped_file.h"
+#include "base/macros.h"
+
+struct io_uring_cqe;
+struct io_uring_sqe;
+
+namespace base {
+namespace internal {
+
+// A minimal io_uring(7) instance: the submission and completion rings mapped
+// in memory, driven through raw syscalls.
+//
+// The submission side (GetSqe(), Submit(), SubmitAndWait()) and the
+// completion side (Wait(), GetCompletion(), ConsumeCompletions()) each have to
+// be used by a single thread at a time, but the two sides may be used
+// concurrently by different threads.
+class BASE_EXPORT IOUring {
+ public:
+  IOUring();
+  ~IOUring();
+
+  // Sets up rings of |sq_entries| submission and |cq_entries| completion
+  // entries (clamped to the kernel's limits). Returns false if io_uring or any
+  // of the IORING_FEAT_* |required_features| is unavailable, e.g. before
+  // Linux 5.1, under a seccomp policy blocking it or when disabled by the
+  // kernel.io_uring_disabled sysctl. IORING_FEAT_SINGLE_MMAP (Linux 5.4) and
+  // IORING_FEAT_NODROP (Linux 5.5) are always required.
+  bool Init(uint32_t sq_entries,
+            uint32_t cq_entries,
+            uint32_t required_features);
+
+  int fd() const { return ring_fd_.get(); }
+  uint32_t features() const { return features_; }
+
+  // Returns a zeroed submission queue entry to fill in, submitting queued
+  // entries first if the queue is full. Returns null if none could be freed.
+  io_uring_sqe* GetSqe();
+
+  // Submits the queued entries, if any.
+  void Submit();
+
+  // Submits the queued entries and, if |min_complete| > 0, waits up to
+  // |timeout_ms| (forever if negative) until there are that many
+  // completions. Makes no syscall if there is nothing to do. A timeout
+  // requires IORING_FEAT_EXT_ARG (Linux 5.11).
+  void SubmitAndWait(uint32_t min_complete, int timeout_ms);
+
+  // Waits until there are |min_complete| completions, without submitting.
+  void Wait(uint32_t min_complete);
+
+  // Number of completions ready to be reaped.
+  uint32_t CompletionsReady() const;
+
+  // Returns the |index|-th ready completion, |index| < CompletionsReady().
+  const io_uring_cqe& GetCompletion(uint32_t index) const;
+
+  // Hands the first |count| ready completions back to the kernel.
+  void ConsumeCompletions(uint32_t count);
+
+  // io_uring_register(2). Returns its result, or -errno on failure.
+  int Register(unsigned int opcode, const void* arg, unsigned int nr_args);
+
+ private:
+  // io_uring_enter(2).
+  void Enter(uint32_t to_submit, uint32_t min_complete, int timeout_ms);
+
+  ScopedFD ring_fd_;
+  uint32_t features_ = 0;
+
+  // Holds both the submission and completion rings (IORING_FEAT_SINGLE_MMAP).
+  void* ring_ = nullptr;
+  size_t ring_size_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  size_t sqes_size_ = 0;
+
+  // Shared with the kernel, within |ring_|.
+  uint32_t* sq_head_ = nullptr;
+  uint32_t* sq_tail_ = nullptr;
+  uint32_t* sq_flags_ = nullptr;
+  uint32_t* cq_head_ = nullptr;
+  uint32_t* cq_tail_ = nullptr;
+  io_uring_cqe* cqes_ = nullptr;
+  uint32_t sq_mask_ = 0;
+  uint32_t sq_entries_ = 0;
+  uint32_t cq_mask_ = 0;
+
+  // Tail of the submission queue including entries not yet published to the
+  // kernel through |sq_tail_|.
+  uint32_t sqe_tail_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(IOUring);
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_POSIX_IO_URING_LINUX_H_
@@ -67,9 +67,17 @@
 
 #include "build/build_config.h"
 
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include <stdint.h>
+#include <time.h>
+
+#include <atomic>
+#else
 #include <pthread.h>
+#endif
 
 #include "base/synchronization/lock.h"
+#include "base/time/time.h"
 
 namespace base {
 
@@ -88,6 +96,8 @@ class ConditionVariable {
   // Wait() releases the caller's critical section atomically as it starts to
   // sleep, and the reacquires it when it is signaled.
   void Wait();
+  // Wait() but returns after at most |max_time| even if not signaled.
+  void TimedWait(const TimeDelta& max_time);
 
   // Broadcast() revives all waiting threads.
   void Broadcast();
@@ -95,9 +105,22 @@ class ConditionVariable {
   void Signal();
 
  private:
-
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  // Sleeps until Signal() or Broadcast(), at most |relative_timeout| if not
+  // null.
+  void WaitForSignal(const struct timespec* relative_timeout);
+
+  // Changed by Signal() and Broadcast(), which wake the threads sleeping on
+  // it in the kernel.
+  std::atomic<int32_t> sequence_{0};
+  // Number of threads in Wait() or TimedWait(), so that Signal() and
+  // Broadcast() make no system call when nobody waits.
+  std::atomic<int32_t> waiters_{0};
+  internal::LockImpl* const user_lock_impl_;
+#else
   pthread_cond_t condition_;
   pthread_mutex_t* user_mutex_;
+#endif
 #ifndef NDEBUG
   base::Lock* user_lock_;  // Needed to adjust shadow lock state on wait.
 #endif
@@ -0,0 +1,75 @@
+// Copyright 2018 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/synchronization/condition_variable.h"
+
+#include <limits>
+
+#include "base/check_op.h"
+#include "base/synchronization/futex_linux.h"
+
+namespace base {
+
+ConditionVariable::ConditionVariable(Lock* user_lock)
+    : user_lock_impl_(&user_lock->lock_)
+#ifndef NDEBUG
+    , user_lock_(user_lock)
+#endif
+{
+}
+
+ConditionVariable::~ConditionVariable() {
+  DCHECK_EQ(0, waiters_.load(std::memory_order_relaxed));
+}
+
+void ConditionVariable::Wait() {
+  WaitForSignal(nullptr);
+}
+
+void ConditionVariable::TimedWait(const TimeDelta& max_time) {
+  int64_t usecs = max_time.InMicroseconds();
+  if (usecs < 0)
+    usecs = 0;
+  struct timespec relative_time;
+  relative_time.tv_sec = usecs / Time::kMicrosecondsPerSecond;
+  relative_time.tv_nsec =
+      (usecs % Time::kMicrosecondsPerSecond) * Time::kNanosecondsPerMicrosecond;
+  WaitForSignal(&relative_time);
+}
+
+void ConditionVariable::Broadcast() {
+  if (!waiters_.load(std::memory_order_relaxed))
+    return;
+  sequence_.fetch_add(1, std::memory_order_relaxed);
+  internal::FutexWake(&sequence_, std::numeric_limits<int32_t>::max());
+}
+
+void ConditionVariable::Signal() {
+  if (!waiters_.load(std::memory_order_relaxed))
+    return;
+  sequence_.fetch_add(1, std::memory_order_relaxed);
+  internal::FutexWake(&sequence_, 1);
+}
+
+void ConditionVariable::WaitForSignal(const struct timespec* relative_timeout) {
+#ifndef NDEBUG
+  user_lock_->CheckHeldAndUnmark();
+#endif
+  // A waiter counted under the lock is seen by any thread that changes the
+  // waited for state under the lock and then signals. If the signal comes
+  // between Unlock() and FutexWait(), the changed |sequence_| makes the
+  // latter return right away.
+  const int32_t sequence = sequence_.load(std::memory_order_relaxed);
+  waiters_.fetch_add(1, std::memory_order_relaxed);
+  user_lock_impl_->Unlock();
+  // Timeouts and interruptions are spurious wakeups for the caller.
+  internal::FutexWait(&sequence_, sequence, relative_timeout);
+  user_lock_impl_->Lock();
+  waiters_.fetch_sub(1, std::memory_order_relaxed);
+#ifndef NDEBUG
+  user_lock_->CheckUnheldAndMark();
+#endif
+}
+
+}  // namespace base
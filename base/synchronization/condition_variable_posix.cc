@@ -4,8 +4,16 @@
 
 #include "base/synchronization/condition_variable.h"
 
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+
 #include "base/check_op.h"
 
+// Linux and Android use the futex-based condition variable of
+// condition_variable_linux.cc.
+#if !defined(OS_LINUX) && !defined(OS_ANDROID)
+
 namespace base {
 
 ConditionVariable::ConditionVariable(Lock* user_lock)
@@ -15,7 +23,20 @@ ConditionVariable::ConditionVariable(Lock* user_lock)
 #endif
 {
   int rv = 0;
+#if defined(OS_MACOSX)
+  // macOS lacks pthread_condattr_setclock(), TimedWait() uses
+  // pthread_cond_timedwait_relative_np() instead.
   rv = pthread_cond_init(&condition_, NULL);
+#else
+  // Measure TimedWait() timeouts with the same clock as TimeTicks so that they
+  // aren't affected by changes to the system time.
+  pthread_condattr_t attrs;
+  rv = pthread_condattr_init(&attrs);
+  DCHECK_EQ(0, rv);
+  pthread_condattr_setclock(&attrs, CLOCK_MONOTONIC);
+  rv = pthread_cond_init(&condition_, &attrs);
+  pthread_condattr_destroy(&attrs);
+#endif
   DCHECK_EQ(0, rv);
 }
 
@@ -35,6 +56,40 @@ void ConditionVariable::Wait() {
 #endif
 }
 
+void ConditionVariable::TimedWait(const TimeDelta& max_time) {
+  int64_t usecs = max_time.InMicroseconds();
+  if (usecs < 0)
+    usecs = 0;
+  struct timespec relative_time;
+  relative_time.tv_sec = usecs / Time::kMicrosecondsPerSecond;
+  relative_time.tv_nsec =
+      (usecs % Time::kMicrosecondsPerSecond) * Time::kNanosecondsPerMicrosecond;
+
+#ifndef NDEBUG
+  user_lock_->CheckHeldAndUnmark();
+#endif
+#if defined(OS_MACOSX)
+  int rv = pthread_cond_timedwait_relative_np(&condition_, user_mutex_,
+                                              &relative_time);
+#else
+  struct timespec absolute_time;
+  clock_gettime(CLOCK_MONOTONIC, &absolute_time);
+  absolute_time.tv_sec += relative_time.tv_sec;
+  absolute_time.tv_nsec += relative_time.tv_nsec;
+  absolute_time.tv_sec += absolute_time.tv_nsec / Time::kNanosecondsPerSecond;
+  absolute_time.tv_nsec %= Time::kNanosecondsPerSecond;
+  DCHECK_GE(absolute_time.tv_sec, relative_time.tv_sec);  // Overflow paranoia
+
+  int rv = pthread_cond_timedwait(&condition_, user_mutex_, &absolute_time);
+#endif
+  // On failure, we only expect the CV to timeout. Any other error value means
+  // that we've unexpectedly woken up.
+  DCHECK(rv == 0 || rv == ETIMEDOUT);
+#ifndef NDEBUG
+  user_lock_->CheckUnheldAndMark();
+#endif
+}
+
 void ConditionVariable::Broadcast() {
   int rv = pthread_cond_broadcast(&condition_);
   DCHECK_EQ(0, rv);
@@ -46,3 +101,5 @@ void ConditionVariable::Signal() {
 }
 
 }  // namespace base
+
+#endif  // !defined(OS_LINUX) && !defined(OS_ANDROID)
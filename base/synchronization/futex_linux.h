@@ -0,0 +1,42 @@
+// Copyright 2018 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MINI_CHROMIUM_BASE_SYNCHRONIZATION_FUTEX_LINUX_H_
+#define MINI_CHROMIUM_BASE_SYNCHRONIZATION_FUTEX_LINUX_H_
+
+#include <linux/futex.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+
+namespace base {
+namespace internal {
+
+// Thin wrappers of the futex() system call for the synchronization
+// primitives, on words private to the process.
+
+// Sleeps while |*word| is |expected|, at most |relative_timeout| if not null.
+// Returns 0 when woken, or -1 with errno EAGAIN if |*word| wasn't |expected|,
+// ETIMEDOUT or EINTR. Callers must recheck their condition either way.
+inline int FutexWait(std::atomic<int32_t>* word,
+                     int32_t expected,
+                     const struct timespec* relative_timeout) {
+  return syscall(SYS_futex, reinterpret_cast<int32_t*>(word),
+                 FUTEX_WAIT | FUTEX_PRIVATE_FLAG, expected, relative_timeout,
+                 nullptr, 0);
+}
+
+// Wakes up to |count| threads sleeping on |word|.
+inline void FutexWake(std::atomic<int32_t>* word, int32_t count) {
+  syscall(SYS_futex, reinterpret_cast<int32_t*>(word),
+          FUTEX_WAKE | FUTEX_PRIVATE_FLAG, count, nullptr, nullptr, 0);
+}
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // MINI_CHROMIUM_BASE_SYNCHRONIZATION_FUTEX_LINUX_H_
@@ -10,6 +10,14 @@
 
 #include "base/check_op.h"
 
+namespace base {
+
+Lock::Lock(const Location& location) : Lock() {
+  lock_.EnableContentionTracking(location);
+}
+
+}  // namespace base
+
 #ifndef NDEBUG
 
 namespace base {
@@ -28,6 +28,11 @@ typedef pthread_t ThreadRefType;
 // AssertAcquired() method.
 class Lock {
  public:
+  // Records how often and how long threads wait for this lock in
+  // debug::LockContentionStats, with the other locks constructed at
+  // |location|. Only waiting threads pay for it, so it suits hot locks.
+  explicit Lock(const Location& location);
+
 #ifdef NDEBUG
    // Optimized wrapper implementation
   Lock() : lock_() {}
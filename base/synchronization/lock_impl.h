@@ -9,21 +9,41 @@
 
 #if defined(OS_WIN)
 #include <windows.h>
+#elif defined(OS_LINUX) || defined(OS_ANDROID)
+#include <stdint.h>
+
+#include <atomic>
 #elif defined(OS_POSIX)
 #include <pthread.h>
 #endif
 
 
 namespace base {
+
+class Location;
+
+namespace debug {
+class LockSiteStats;
+}  // namespace debug
+
 namespace internal {
 
 // This class implements the underlying platform-specific spin-lock mechanism
 // used for the Lock class.  Most users should not use LockImpl directly, but
 // should instead use Lock.
+//
+// On Linux and Android, the lock is a futex word rather than a
+// pthread_mutex_t: taking and releasing an uncontended lock is one atomic
+// instruction each, inlined. A contended Lock() spins for a few microseconds,
+// backing off between attempts, before sleeping in the kernel, and Unlock()
+// only makes a system call when a thread sleeps.
 class LockImpl {
  public:
 #if defined(OS_WIN)
   typedef CRITICAL_SECTION NativeHandle;
+#elif defined(OS_LINUX) || defined(OS_ANDROID)
+  // kUnlocked, kLocked or kLockedWithWaiters.
+  typedef std::atomic<int32_t> NativeHandle;
 #elif defined(OS_POSIX)
   typedef pthread_mutex_t NativeHandle;
 #endif
@@ -46,15 +66,55 @@ class LockImpl {
   // a successful call to Try, or a call to Lock.
   void Unlock();
 
+  // Records from now on how often and how long Lock() waits, in the
+  // debug::LockContentionStats of |location|.
+  void EnableContentionTracking(const Location& location);
+
   // Return the native underlying lock.
   // TODO(awalker): refactor lock and condition variables so that this is
   // unnecessary.
   NativeHandle* native_handle() { return &native_handle_; }
 
  private:
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  enum : int32_t {
+    kUnlocked = 0,
+    kLocked = 1,
+    // Threads may be sleeping in the kernel, so Unlock() must wake one.
+    kLockedWithWaiters = 2,
+  };
+
+  // Spins, then sleeps until the lock is taken.
+  void LockSlow();
+  void WakeWaiter();
+#endif
+
   NativeHandle native_handle_;
+
+  // Where contention is recorded, if enabled. Only read while waiting.
+  debug::LockSiteStats* stats_ = nullptr;
 };
 
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+inline bool LockImpl::Try() {
+  int32_t state = kUnlocked;
+  return native_handle_.compare_exchange_strong(
+      state, kLocked, std::memory_order_acquire, std::memory_order_relaxed);
+}
+
+inline void LockImpl::Lock() {
+  if (!Try())
+    LockSlow();
+}
+
+inline void LockImpl::Unlock() {
+  if (native_handle_.exchange(kUnlocked, std::memory_order_release) ==
+      kLockedWithWaiters) {
+    WakeWaiter();
+  }
+}
+#endif
+
 }  // namespace internal
 }  // namespace base
 
@@ -0,0 +1,87 @@
+// Copyright 2018 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/synchronization/lock_impl.h"
+
+#include <unistd.h>
+
+#include "base/check_op.h"
+#include "base/debug/lock_contention_stats.h"
+#include "base/synchronization/futex_linux.h"
+#include "base/time/time.h"
+
+namespace base {
+namespace internal {
+
+namespace {
+
+// Lock() spins for kSpinRounds rounds before sleeping, round i waiting for
+// 2^i pause instructions: a few microseconds in total, about the cost of
+// sleeping and being woken up.
+constexpr int kSpinRounds = 7;
+
+inline void YieldProcessor() {
+#if defined(ARCH_CPU_X86_FAMILY)
+  __asm__ __volatile__("pause");
+#elif defined(ARCH_CPU_ARM_FAMILY)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+// Spinning only helps if the holder of the lock runs meanwhile.
+bool CanSpin() {
+  static const bool can_spin = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+  return can_spin;
+}
+
+}  // namespace
+
+LockImpl::LockImpl() : native_handle_(kUnlocked) {}
+
+LockImpl::~LockImpl() {
+  DCHECK_EQ(native_handle_.load(std::memory_order_relaxed), kUnlocked);
+}
+
+void LockImpl::EnableContentionTracking(const Location& location) {
+  stats_ = debug::LockContentionStats::GetInstance()->GetSite(location);
+}
+
+void LockImpl::LockSlow() {
+  const TimeTicks wait_start = stats_ ? TimeTicks::Now() : TimeTicks();
+
+  // Spin while the lock is held briefly. Sleeping threads mean that it isn't.
+  int32_t state = native_handle_.load(std::memory_order_relaxed);
+  for (int round = 0;
+       round < kSpinRounds && state != kLockedWithWaiters && CanSpin();
+       ++round) {
+    for (int i = 0; i < (1 << round); ++i)
+      YieldProcessor();
+    state = native_handle_.load(std::memory_order_relaxed);
+    if (state == kUnlocked &&
+        native_handle_.compare_exchange_weak(state, kLocked,
+                                             std::memory_order_acquire,
+                                             std::memory_order_relaxed)) {
+      if (stats_)
+        stats_->RecordContention(TimeTicks::Now() - wait_start);
+      return;
+    }
+  }
+
+  // Sleep until the lock is released. Other threads may still be sleeping
+  // once it's taken, so it's taken as kLockedWithWaiters to have Unlock()
+  // wake the next one.
+  while (native_handle_.exchange(kLockedWithWaiters,
+                                 std::memory_order_acquire) != kUnlocked) {
+    FutexWait(&native_handle_, kLockedWithWaiters, nullptr);
+  }
+  if (stats_)
+    stats_->RecordContention(TimeTicks::Now() - wait_start);
+}
+
+void LockImpl::WakeWaiter() {
+  FutexWake(&native_handle_, 1);
+}
+
+}  // namespace internal
+}  // namespace base
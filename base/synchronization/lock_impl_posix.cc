@@ -7,6 +7,11 @@
 #include <errno.h>
 
 #include "base/check_op.h"
+#include "base/debug/lock_contention_stats.h"
+#include "base/time/time.h"
+
+// Linux and Android use the futex-based lock of lock_impl_linux.cc.
+#if !defined(OS_LINUX) && !defined(OS_ANDROID)
 
 namespace base {
 namespace internal {
@@ -41,6 +46,16 @@ bool LockImpl::Try() {
 }
 
 void LockImpl::Lock() {
+  // Tracking locks find out whether they have to wait first.
+  if (stats_) {
+    if (Try())
+      return;
+    const TimeTicks wait_start = TimeTicks::Now();
+    int rv = pthread_mutex_lock(&native_handle_);
+    DCHECK_EQ(rv, 0);
+    stats_->RecordContention(TimeTicks::Now() - wait_start);
+    return;
+  }
   int rv = pthread_mutex_lock(&native_handle_);
   DCHECK_EQ(rv, 0);
 }
@@ -50,5 +65,11 @@ void LockImpl::Unlock() {
   DCHECK_EQ(rv, 0);
 }
 
+void LockImpl::EnableContentionTracking(const Location& location) {
+  stats_ = debug::LockContentionStats::GetInstance()->GetSite(location);
+}
+
 }  // namespace internal
 }  // namespace base
+
+#endif  // !defined(OS_LINUX) && !defined(OS_ANDROID)
@@ -0,0 +1,147 @@
+// Copyright 2018 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MINI_CHROMIUM_BASE_SYNCHRONIZATION_READ_WRITE_LOCK_H_
+#define MINI_CHROMIUM_BASE_SYNCHRONIZATION_READ_WRITE_LOCK_H_
+
+#include "build/build_config.h"
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include <stdint.h>
+
+#include <atomic>
+#elif defined(OS_POSIX)
+#include <pthread.h>
+#endif
+
+#include "base/base_export.h"
+
+namespace base {
+
+// A lock which many readers may hold at once, for read-mostly data such as
+// caches. Writers are preferred: once a writer waits, new readers wait too,
+// so a steady stream of readers can't starve writers.
+//
+// On Linux and Android, the lock is a futex word. Taking and releasing it for
+// reading is one atomic instruction each while no writer is involved, and
+// releasing it only makes a system call when a thread sleeps. Like Lock, it is
+// not recursive: a reader must not take it for reading again, since a writer
+// may be waiting in between.
+class BASE_EXPORT ReadWriteLock {
+ public:
+  ReadWriteLock();
+  ~ReadWriteLock();
+
+  ReadWriteLock(const ReadWriteLock&) = delete;
+  ReadWriteLock& operator=(const ReadWriteLock&) = delete;
+
+  void ReadAcquire();
+  void ReadRelease();
+
+  void WriteAcquire();
+  void WriteRelease();
+
+ private:
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  enum : int32_t {
+    // Held by a writer.
+    kWriteLocked = 1 << 0,
+    // Readers may be sleeping on |state_|.
+    kReadersWaiting = 1 << 1,
+    // Number of writers waiting, in bits 2 to 15.
+    kWriterWaiter = 1 << 2,
+    kWriterWaiterMask = 0xfffc,
+    // Number of readers holding the lock, in bits 16 to 30.
+    kReader = 1 << 16,
+    kReaderMask = 0x7fff0000,
+  };
+
+  void ReadAcquireSlow();
+  void ReadReleaseSlow();
+  void WriteAcquireSlow();
+  void WriteReleaseSlow();
+
+  // Wakes one of the writers sleeping on |writer_wakeups_|.
+  void WakeWriter();
+
+  std::atomic<int32_t> state_{0};
+  // Changed to wake writers, so that waking one doesn't wake the readers.
+  std::atomic<int32_t> writer_wakeups_{0};
+#elif defined(OS_POSIX)
+  pthread_rwlock_t native_handle_;
+#endif
+};
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+inline void ReadWriteLock::ReadAcquire() {
+  int32_t state = state_.load(std::memory_order_relaxed);
+  if ((state & (kWriteLocked | kWriterWaiterMask)) ||
+      !state_.compare_exchange_weak(state, state + kReader,
+                                    std::memory_order_acquire,
+                                    std::memory_order_relaxed)) {
+    ReadAcquireSlow();
+  }
+}
+
+inline void ReadWriteLock::ReadRelease() {
+  const int32_t state =
+      state_.fetch_sub(kReader, std::memory_order_release) - kReader;
+  // The last reader out lets a waiting writer in.
+  if (!(state & kReaderMask) && (state & kWriterWaiterMask))
+    ReadReleaseSlow();
+}
+
+inline void ReadWriteLock::WriteAcquire() {
+  int32_t state = 0;
+  if (!state_.compare_exchange_strong(state, kWriteLocked,
+                                      std::memory_order_acquire,
+                                      std::memory_order_relaxed)) {
+    WriteAcquireSlow();
+  }
+}
+
+inline void ReadWriteLock::WriteRelease() {
+  int32_t state = kWriteLocked;
+  if (!state_.compare_exchange_strong(state, 0, std::memory_order_release,
+                                      std::memory_order_relaxed)) {
+    WriteReleaseSlow();
+  }
+}
+#endif
+
+// Holds |lock| for reading while in scope.
+class AutoReadLock {
+ public:
+  explicit AutoReadLock(ReadWriteLock& lock) : lock_(lock) {
+    lock_.ReadAcquire();
+  }
+
+  AutoReadLock(const AutoReadLock&) = delete;
+  AutoReadLock& operator=(const AutoReadLock&) = delete;
+
+  ~AutoReadLock() { lock_.ReadRelease(); }
+
+ private:
+  ReadWriteLock& lock_;
+};
+
+// Holds |lock| for writing while in scope.
+class AutoWriteLock {
+ public:
+  explicit AutoWriteLock(ReadWriteLock& lock) : lock_(lock) {
+    lock_.WriteAcquire();
+  }
+
+  AutoWriteLock(const AutoWriteLock&) = delete;
+  AutoWriteLock& operator=(const AutoWriteLock&) = delete;
+
+  ~AutoWriteLock() { lock_.WriteRelease(); }
+
+ private:
+  ReadWriteLock& lock_;
+};
+
+}  // namespace base
+
+#endif  // MINI_CHROMIUM_BASE_SYNCHRONIZATION_READ_WRITE_LOCK_H_
@@ -0,0 +1,95 @@
+// Copyright 2018 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/synchronization/read_write_lock.h"
+
+#include <limits>
+
+#include "base/check_op.h"
+#include "base/synchronization/futex_linux.h"
+
+namespace base {
+
+ReadWriteLock::ReadWriteLock() = default;
+
+ReadWriteLock::~ReadWriteLock() {
+  DCHECK_EQ(state_.load(std::memory_order_relaxed), 0);
+}
+
+void ReadWriteLock::ReadAcquireSlow() {
+  int32_t state = state_.load(std::memory_order_relaxed);
+  for (;;) {
+    if (!(state & (kWriteLocked | kWriterWaiterMask))) {
+      DCHECK_NE(state & kReaderMask, kReaderMask) << "too many readers";
+      if (state_.compare_exchange_weak(state, state + kReader,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed)) {
+        return;
+      }
+      continue;
+    }
+    // Sleep until the writers are done. Any change of |state_| in between
+    // makes FutexWait() return right away.
+    if (!(state & kReadersWaiting)) {
+      if (!state_.compare_exchange_weak(state, state | kReadersWaiting,
+                                        std::memory_order_relaxed)) {
+        continue;
+      }
+      state |= kReadersWaiting;
+    }
+    internal::FutexWait(&state_, state, nullptr);
+    state = state_.load(std::memory_order_relaxed);
+  }
+}
+
+void ReadWriteLock::ReadReleaseSlow() {
+  WakeWriter();
+}
+
+void ReadWriteLock::WriteAcquireSlow() {
+  // Counting this writer keeps new readers out.
+  state_.fetch_add(kWriterWaiter);
+  for (;;) {
+    // Read before |state_|, so that a release after the check below changes
+    // |writer_wakeups_| from |wakeups| and FutexWait() doesn't sleep.
+    const int32_t wakeups = writer_wakeups_.load();
+    int32_t state = state_.load();
+    while (!(state & (kWriteLocked | kReaderMask))) {
+      if (state_.compare_exchange_weak(state,
+                                       (state - kWriterWaiter) | kWriteLocked,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed)) {
+        return;
+      }
+    }
+    internal::FutexWait(&writer_wakeups_, wakeups, nullptr);
+  }
+}
+
+void ReadWriteLock::WriteReleaseSlow() {
+  int32_t state = state_.load(std::memory_order_relaxed);
+  int32_t new_state;
+  do {
+    DCHECK(state & kWriteLocked);
+    new_state = state & ~kWriteLocked;
+    // Readers go after the waiting writers.
+    if (!(state & kWriterWaiterMask))
+      new_state &= ~kReadersWaiting;
+  } while (!state_.compare_exchange_weak(state, new_state,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed));
+
+  if (state & kWriterWaiterMask) {
+    WakeWriter();
+  } else if (state & kReadersWaiting) {
+    internal::FutexWake(&state_, std::numeric_limits<int32_t>::max());
+  }
+}
+
+void ReadWriteLock::WakeWriter() {
+  writer_wakeups_.fetch_add(1);
+  internal::FutexWake(&writer_wakeups_, 1);
+}
+
+}  // namespace base
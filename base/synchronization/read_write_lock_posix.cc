@@ -0,0 +1,46 @@
+// Copyright 2018 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/synchronization/read_write_lock.h"
+
+#include "base/check_op.h"
+
+// Linux and Android use the futex-based lock of read_write_lock_linux.cc.
+#if !defined(OS_LINUX) && !defined(OS_ANDROID)
+
+namespace base {
+
+ReadWriteLock::ReadWriteLock() {
+  int rv = pthread_rwlock_init(&native_handle_, nullptr);
+  DCHECK_EQ(rv, 0);
+}
+
+ReadWriteLock::~ReadWriteLock() {
+  int rv = pthread_rwlock_destroy(&native_handle_);
+  DCHECK_EQ(rv, 0);
+}
+
+void ReadWriteLock::ReadAcquire() {
+  int rv = pthread_rwlock_rdlock(&native_handle_);
+  DCHECK_EQ(rv, 0);
+}
+
+void ReadWriteLock::ReadRelease() {
+  int rv = pthread_rwlock_unlock(&native_handle_);
+  DCHECK_EQ(rv, 0);
+}
+
+void ReadWriteLock::WriteAcquire() {
+  int rv = pthread_rwlock_wrlock(&native_handle_);
+  DCHECK_EQ(rv, 0);
+}
+
+void ReadWriteLock::WriteRelease() {
+  int rv = pthread_rwlock_unlock(&native_handle_);
+  DCHECK_EQ(rv, 0);
+}
+
+}  // namespace base
+
+#endif  // !defined(OS_LINUX) && !defined(OS_ANDROID)
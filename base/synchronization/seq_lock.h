@@ -0,0 +1,92 @@
+// Copyright 2018 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MINI_CHROMIUM_BASE_SYNCHRONIZATION_SEQ_LOCK_H_
+#define MINI_CHROMIUM_BASE_SYNCHRONIZATION_SEQ_LOCK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <type_traits>
+
+#include "base/synchronization/lock.h"
+
+namespace base {
+
+// Holds a small, trivially copyable T which many threads read and few write,
+// e.g. a snapshot of a few counters or a configuration struct. Readers never
+// write shared memory: they copy the value and retry if a writer changed it
+// meanwhile, so they scale with cores but spin while a write is in progress.
+// Writers are serialized by a Lock.
+//
+// Example:
+//   struct Bounds { int64_t min; int64_t max; };
+//   SeqLock<Bounds> bounds;
+//   bounds.Write({0, 10});      // On any thread.
+//   Bounds b = bounds.Read();   // On any thread, consistent.
+template <typename T>
+class SeqLock {
+ public:
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SeqLock copies T byte by byte");
+
+  SeqLock() : SeqLock(T()) {}
+  explicit SeqLock(const T& value) { Store(value); }
+
+  SeqLock(const SeqLock&) = delete;
+  SeqLock& operator=(const SeqLock&) = delete;
+
+  T Read() const {
+    Word words[kNumWords];
+    for (;;) {
+      const uint32_t sequence = sequence_.load(std::memory_order_acquire);
+      // Odd while a write is in progress.
+      if (sequence & 1)
+        continue;
+      for (size_t i = 0; i < kNumWords; ++i)
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      // Orders the copy before the check of |sequence_|.
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) == sequence)
+        break;
+    }
+    T value;
+    memcpy(&value, words, sizeof(T));
+    return value;
+  }
+
+  void Write(const T& value) {
+    AutoLock lock(write_lock_);
+    const uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    // Orders the odd |sequence_| before the new words.
+    std::atomic_thread_fence(std::memory_order_release);
+    Store(value);
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+ private:
+  // T is kept in atomic words, so that readers racing with a writer read
+  // torn values rather than have undefined behavior.
+  using Word = uintptr_t;
+  static constexpr size_t kNumWords = (sizeof(T) + sizeof(Word) - 1) /
+                                      sizeof(Word);
+
+  void Store(const T& value) {
+    Word words[kNumWords] = {};
+    memcpy(words, &value, sizeof(T));
+    for (size_t i = 0; i < kNumWords; ++i)
+      words_[i].store(words[i], std::memory_order_relaxed);
+  }
+
+  std::atomic<uint32_t> sequence_{0};
+  std::atomic<Word> words_[kNumWords];
+  Lock write_lock_;
+};
+
+}  // namespace base
+
+#endif  // MINI_CHROMIUM_BASE_SYNCHRONIZATION_SEQ_LOCK_H_
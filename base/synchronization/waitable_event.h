@@ -0,0 +1,136 @@
+// Copyright 2018 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MINI_CHROMIUM_BASE_SYNCHRONIZATION_WAITABLE_EVENT_H_
+#define MINI_CHROMIUM_BASE_SYNCHRONIZATION_WAITABLE_EVENT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "base/base_export.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+
+namespace base {
+
+// A WaitableEvent can be a useful thread synchronization tool when you want to
+// allow one thread to wait for another thread to finish some work, without
+// the Lock and ConditionVariable pair the waited for state would otherwise
+// need.
+//
+// The event is one futex word: Signal(), Reset() and IsSignaled() are one
+// atomic operation each unless a thread waits, and only then make a system
+// call.
+//
+// Only available on Linux and Android.
+class BASE_EXPORT WaitableEvent {
+ public:
+  // Indicates whether a WaitableEvent should automatically reset the event
+  // state after a single waiting thread has been released or remain signaled
+  // until Reset() is manually invoked.
+  enum class ResetPolicy { MANUAL, AUTOMATIC };
+
+  // Indicates whether a new WaitableEvent should start in a signaled state or
+  // not.
+  enum class InitialState { SIGNALED, NOT_SIGNALED };
+
+  WaitableEvent(ResetPolicy reset_policy = ResetPolicy::MANUAL,
+                InitialState initial_state = InitialState::NOT_SIGNALED);
+  ~WaitableEvent();
+
+  WaitableEvent(const WaitableEvent&) = delete;
+  WaitableEvent& operator=(const WaitableEvent&) = delete;
+
+  // Put the event in the un-signaled state.
+  void Reset();
+
+  // Put the event in the signaled state. Causing any thread blocked on Wait
+  // to be woken up.
+  void Signal();
+
+  // Returns true if the event is in the signaled state, else false. If this
+  // is not a manual reset event, then this test will cause a reset.
+  bool IsSignaled();
+
+  // Wait indefinitely for the event to be signaled. Wait's return "happens
+  // after" |Signal| has completed. This means that it's safe for a
+  // WaitableEvent to synchronise its own destruction, like this:
+  //
+  //   WaitableEvent *e = new WaitableEvent;
+  //   SendToOtherThread(e);
+  //   e->Wait();
+  //   delete e;
+  void Wait();
+
+  // Wait up until |wait_delta| has passed for the event to be signaled.
+  // Returns true if the event was signaled. Handles spurious wakeups and
+  // guarantees that |wait_delta| will have elapsed if this returns false.
+  //
+  // TimedWait can synchronise its own destruction like |Wait|.
+  bool TimedWait(const TimeDelta& wait_delta);
+
+  // Wait up until |end_time| deadline has passed for the event to be signaled.
+  // Return true if the event was signaled.
+  //
+  // TimedWaitUntil can synchronise its own destruction like |Wait|.
+  bool TimedWaitUntil(const TimeTicks& end_time);
+
+  // Wait, synchronously, on multiple events.
+  //   waitables: an array of WaitableEvent pointers
+  //   count: the number of elements in @waitables
+  //
+  // returns: the index of a WaitableEvent which has been signaled. If more
+  // than one is signaled, the smallest index is returned, and only that event
+  // is reset if it is an automatic reset one.
+  //
+  // You MUST NOT delete any of the WaitableEvent objects while this wait is
+  // happening, however WaitMany's return "happens after" the |Signal| call
+  // that caused it has completed, like |Wait|.
+  static size_t WaitMany(WaitableEvent** waitables, size_t count);
+
+ private:
+  // Registers a thread in WaitMany() with one of its events. The thread sleeps
+  // on a futex word of its own, since it can't sleep on those of all the
+  // events at once.
+  struct MultiWaiter {
+    // Changed by Signal() to wake the thread.
+    std::atomic<int32_t>* wakeups = nullptr;
+    MultiWaiter* next = nullptr;
+  };
+
+  enum : int32_t {
+    kSignaled = 1 << 0,
+    // |multi_waiters_| isn't empty.
+    kHasMultiWaiters = 1 << 1,
+    // Number of threads sleeping on |state_|, from bit 2 on.
+    kWaiter = 1 << 2,
+    kWaiterMask = ~(kSignaled | kHasMultiWaiters),
+  };
+
+  // Takes the signal if the event is signaled, resetting it unless it is a
+  // manual reset event. Returns whether it was signaled.
+  bool TryConsumeSignal();
+
+  // Waits on |state_| until the event is signaled, until |end_time| unless it
+  // is TimeTicks::Max().
+  bool WaitUntil(TimeTicks end_time);
+
+  void WakeMultiWaiters();
+  void AddMultiWaiter(MultiWaiter* waiter);
+  void RemoveMultiWaiter(MultiWaiter* waiter);
+
+  const bool manual_reset_;
+
+  std::atomic<int32_t> state_;
+
+  // Protects |multi_waiters_|. Only taken when WaitMany() is involved.
+  Lock multi_waiters_lock_;
+  MultiWaiter* multi_waiters_ = nullptr;
+};
+
+}  // namespace base
+
+#endif  // MINI_CHROMIUM_BASE_SYNCHRONIZATION_WAITABLE_EVENT_H_
@@ -0,0 +1,197 @@
+// Copyright 2018 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/synchronization/waitable_event.h"
+
+#include <time.h>
+
+#include <limits>
+#include <vector>
+
+#include "base/check_op.h"
+#include "base/synchronization/futex_linux.h"
+
+namespace base {
+
+namespace {
+
+struct timespec ToTimespec(TimeDelta delta) {
+  const int64_t usecs = delta.InMicroseconds();
+  struct timespec result;
+  result.tv_sec = usecs / Time::kMicrosecondsPerSecond;
+  result.tv_nsec =
+      (usecs % Time::kMicrosecondsPerSecond) * Time::kNanosecondsPerMicrosecond;
+  return result;
+}
+
+}  // namespace
+
+WaitableEvent::WaitableEvent(ResetPolicy reset_policy,
+                             InitialState initial_state)
+    : manual_reset_(reset_policy == ResetPolicy::MANUAL),
+      state_(initial_state == InitialState::SIGNALED ? kSignaled : 0) {}
+
+WaitableEvent::~WaitableEvent() {
+  DCHECK_EQ(state_.load(std::memory_order_relaxed) & ~kSignaled, 0)
+      << "destroyed while waited on";
+}
+
+void WaitableEvent::Reset() {
+  state_.fetch_and(~kSignaled, std::memory_order_relaxed);
+}
+
+void WaitableEvent::Signal() {
+  // The waiter may delete the event as soon as it sees it signaled, so
+  // nothing but the futex word may be touched once it is.
+  const int32_t wake_count =
+      manual_reset_ ? std::numeric_limits<int32_t>::max() : 1;
+
+  int32_t state = state_.load(std::memory_order_relaxed);
+  while (!(state & kHasMultiWaiters)) {
+    if (state & kSignaled)
+      return;
+    if (state_.compare_exchange_weak(state, state | kSignaled,
+                                     std::memory_order_release,
+                                     std::memory_order_relaxed)) {
+      if (state & kWaiterMask)
+        internal::FutexWake(&state_, wake_count);
+      return;
+    }
+  }
+
+  // WaitMany() waits for |multi_waiters_lock_| to return, which keeps the
+  // event alive until the waiters are woken up.
+  AutoLock auto_lock(multi_waiters_lock_);
+  state = state_.fetch_or(kSignaled, std::memory_order_release);
+  if (state & kSignaled)
+    return;
+  if (state & kWaiterMask)
+    internal::FutexWake(&state_, wake_count);
+  WakeMultiWaiters();
+}
+
+bool WaitableEvent::IsSignaled() {
+  return TryConsumeSignal();
+}
+
+void WaitableEvent::Wait() {
+  WaitUntil(TimeTicks::Max());
+}
+
+bool WaitableEvent::TimedWait(const TimeDelta& wait_delta) {
+  if (wait_delta.is_max())
+    return WaitUntil(TimeTicks::Max());
+  return WaitUntil(TimeTicks::Now() + wait_delta);
+}
+
+bool WaitableEvent::TimedWaitUntil(const TimeTicks& end_time) {
+  return WaitUntil(end_time);
+}
+
+// static
+size_t WaitableEvent::WaitMany(WaitableEvent** waitables, size_t count) {
+  DCHECK(count) << "Cannot wait on no events";
+
+  for (size_t i = 0; i < count; ++i) {
+    if (waitables[i]->TryConsumeSignal())
+      return i;
+  }
+
+  // One node per event, since an event may be listed more than once.
+  std::atomic<int32_t> wakeups(0);
+  std::vector<MultiWaiter> waiters(count);
+  for (size_t i = 0; i < count; ++i) {
+    waiters[i].wakeups = &wakeups;
+    waitables[i]->AddMultiWaiter(&waiters[i]);
+  }
+
+  size_t signaled = count;
+  while (signaled == count) {
+    // Pairs with the increment in WakeMultiWaiters(): a wakeup seen here
+    // makes the signal that caused it visible to the checks below.
+    const int32_t seen_wakeups = wakeups.load(std::memory_order_acquire);
+    // Registered before checking, so that a Signal() from now on changes
+    // |wakeups|.
+    for (size_t i = 0; i < count; ++i) {
+      if (waitables[i]->TryConsumeSignal()) {
+        signaled = i;
+        break;
+      }
+    }
+    if (signaled == count)
+      internal::FutexWait(&wakeups, seen_wakeups, nullptr);
+  }
+
+  for (size_t i = 0; i < count; ++i)
+    waitables[i]->RemoveMultiWaiter(&waiters[i]);
+  return signaled;
+}
+
+bool WaitableEvent::TryConsumeSignal() {
+  int32_t state = state_.load(std::memory_order_acquire);
+  if (manual_reset_)
+    return state & kSignaled;
+  while (state & kSignaled) {
+    if (state_.compare_exchange_weak(state, state & ~kSignaled,
+                                     std::memory_order_acquire,
+                                     std::memory_order_relaxed)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool WaitableEvent::WaitUntil(TimeTicks end_time) {
+  if (TryConsumeSignal())
+    return true;
+
+  // Counted so that Signal() knows to wake this thread.
+  state_.fetch_add(kWaiter, std::memory_order_relaxed);
+  bool signaled = false;
+  for (;;) {
+    // Any change of |state_| from here on makes FutexWait() return.
+    const int32_t state = state_.load(std::memory_order_relaxed);
+    if (TryConsumeSignal()) {
+      signaled = true;
+      break;
+    }
+    if (end_time.is_max()) {
+      internal::FutexWait(&state_, state, nullptr);
+      continue;
+    }
+    const TimeDelta remaining = end_time - TimeTicks::Now();
+    if (remaining <= TimeDelta())
+      break;
+    const struct timespec relative_timeout = ToTimespec(remaining);
+    internal::FutexWait(&state_, state, &relative_timeout);
+  }
+  state_.fetch_sub(kWaiter, std::memory_order_relaxed);
+  return signaled;
+}
+
+void WaitableEvent::WakeMultiWaiters() {
+  for (MultiWaiter* waiter = multi_waiters_; waiter; waiter = waiter->next) {
+    waiter->wakeups->fetch_add(1, std::memory_order_release);
+    internal::FutexWake(waiter->wakeups, 1);
+  }
+}
+
+void WaitableEvent::AddMultiWaiter(MultiWaiter* waiter) {
+  AutoLock auto_lock(multi_waiters_lock_);
+  waiter->next = multi_waiters_;
+  multi_waiters_ = waiter;
+  state_.fetch_or(kHasMultiWaiters);
+}
+
+void WaitableEvent::RemoveMultiWaiter(MultiWaiter* waiter) {
+  AutoLock auto_lock(multi_waiters_lock_);
+  MultiWaiter** link = &multi_waiters_;
+  while (*link != waiter)
+    link = &(*link)->next;
+  *link = waiter->next;
+  if (!multi_waiters_)
+    state_.fetch_and(~kHasMultiWaiters);
+}
+
+}  // namespace base
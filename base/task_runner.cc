@@ -44,6 +44,20 @@ bool TaskRunner::PostTask(const Location& from_here, OnceClosure task) {
   return PostDelayedTask(from_here, std::move(task), base::TimeDelta());
 }
 
+bool TaskRunner::PostTaskWithPriority(const Location& from_here,
+                                      TaskPriority priority,
+                                      OnceClosure task) {
+  return PostDelayedTaskWithPriority(from_here, priority, std::move(task),
+                                     base::TimeDelta());
+}
+
+bool TaskRunner::PostDelayedTaskWithPriority(const Location& from_here,
+                                             TaskPriority priority,
+                                             OnceClosure task,
+                                             base::TimeDelta delay) {
+  return PostDelayedTask(from_here, std::move(task), delay);
+}
+
 bool TaskRunner::PostTaskAndReply(const Location& from_here,
                                   OnceClosure task,
                                   OnceClosure reply) {
@@ -11,6 +11,7 @@
 #include "base/callback.h"
 #include "base/location.h"
 #include "base/memory/ref_counted.h"
+#include "base/task_scheduler/task_priority.h"
 #include "base/time/time.h"
 
 namespace base {
@@ -70,6 +71,17 @@ class BASE_EXPORT TaskRunner
                                OnceClosure task,
                                base::TimeDelta delay) = 0;
 
+  // Like PostTask() and PostDelayedTask(), but |priority| tells how urgent the
+  // task is relative to the other tasks posted to this TaskRunner. TaskRunners
+  // without support for priorities run it like any other task.
+  bool PostTaskWithPriority(const Location& from_here,
+                            TaskPriority priority,
+                            OnceClosure task);
+  virtual bool PostDelayedTaskWithPriority(const Location& from_here,
+                                           TaskPriority priority,
+                                           OnceClosure task,
+                                           base::TimeDelta delay);
+
   // Returns true iff tasks posted to this TaskRunner are sequenced
   // with this call.
   //
@@ -0,0 +1,33 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_TASK_SCHEDULER_TASK_PRIORITY_H_
+#define BASE_TASK_SCHEDULER_TASK_PRIORITY_H_
+
+#include <stdint.h>
+
+namespace base {
+
+// Valid priorities supported by the task scheduling APIs. A task runner which
+// supports priorities runs tasks of higher priority first, but doesn't starve
+// lower priority tasks entirely.
+enum class TaskPriority : uint8_t {
+  // This will always be equal to the lowest priority available.
+  LOWEST = 0,
+  // This task will only be run once no more important work is pending, e.g.
+  // cache cleanup or metrics reporting.
+  BEST_EFFORT = LOWEST,
+  // This task affects what the user or a peer sees, but not right away, e.g.
+  // bulk data transfers.
+  USER_VISIBLE,
+  // This task blocks the user or a peer, e.g. health checks, cancellations or
+  // responding to input.
+  USER_BLOCKING,
+  // This will always be equal to the highest priority available.
+  HIGHEST = USER_BLOCKING,
+};
+
+}  // namespace base
+
+#endif  // BASE_TASK_SCHEDULER_TASK_PRIORITY_H_
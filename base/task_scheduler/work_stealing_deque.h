@@ -0,0 +1,165 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_TASK_SCHEDULER_WORK_STEALING_DEQUE_H_
+#define BASE_TASK_SCHEDULER_WORK_STEALING_DEQUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "base/logging.h"
+#include "base/macros.h"
+
+namespace base {
+namespace internal {
+
+// A Chase-Lev work-stealing deque ("Dynamic Circular Work-Stealing Deque",
+// SPAA'05, with the C11 memory orderings of Le et al., PPoPP'13).
+//
+// The owner thread pushes and pops items at the bottom, LIFO, without any
+// read-modify-write in the common case. Any other thread may steal items from
+// the top, FIFO, with a single compare-and-swap. The buffer grows as needed;
+// buffers outgrown are kept until destruction since thieves may still be
+// reading from them.
+//
+// |T| must be trivially copyable (typically a raw pointer whose ownership is
+// transferred through the deque).
+template <typename T>
+class WorkStealingDeque {
+ public:
+  static_assert(std::is_trivially_copyable<T>::value,
+                "WorkStealingDeque items must be trivially copyable.");
+
+  explicit WorkStealingDeque(size_t initial_capacity = 64) {
+    DCHECK(initial_capacity && !(initial_capacity & (initial_capacity - 1)))
+        << "Capacity must be a power of 2.";
+    buffers_.push_back(std::make_unique<Buffer>(initial_capacity));
+    buffer_.store(buffers_.back().get(), std::memory_order_relaxed);
+  }
+
+  ~WorkStealingDeque() = default;
+
+  // Adds |item| at the bottom. Must only be called by the owner.
+  void Push(T item) {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    const int64_t top = top_.load(std::memory_order_acquire);
+    Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+    if (bottom - top >= static_cast<int64_t>(buffer->capacity))
+      buffer = Grow(buffer, top, bottom);
+    buffer->Store(bottom, item);
+    // Publishes |item| to thieves.
+    bottom_.store(bottom + 1, std::memory_order_release);
+  }
+
+  // Removes the bottom item into |*item|. Returns false if the deque is empty
+  // (or its last item was just stolen). Must only be called by the owner.
+  bool Pop(T* item) {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+    bottom_.store(bottom, std::memory_order_relaxed);
+    // Orders the store above before reading |top_|, pairing with Steal().
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+      // Empty.
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return false;
+    }
+
+    *item = buffer->Load(bottom);
+    if (top < bottom)
+      return true;
+
+    // Last item: race thieves for it.
+    const bool won = top_.compare_exchange_strong(
+        top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return won;
+  }
+
+  // Removes the top item into |*item|. Returns false if the deque is empty or
+  // another thread won the race for the top item, in which case the caller
+  // may retry. May be called from any thread.
+  bool Steal(T* item) {
+    int64_t top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t bottom = bottom_.load(std::memory_order_acquire);
+    if (top >= bottom)
+      return false;
+
+    Buffer* buffer = buffer_.load(std::memory_order_acquire);
+    const T stolen = buffer->Load(top);
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return false;
+    }
+    *item = stolen;
+    return true;
+  }
+
+  // Returns true if the deque appeared empty at some point during the call.
+  // May be called from any thread.
+  bool IsEmpty() const {
+    const int64_t top = top_.load(std::memory_order_acquire);
+    const int64_t bottom = bottom_.load(std::memory_order_acquire);
+    return bottom <= top;
+  }
+
+ private:
+  class Buffer {
+   public:
+    explicit Buffer(size_t capacity)
+        : capacity(capacity),
+          items_(new std::atomic<T>[capacity]) {}
+
+    T Load(int64_t index) const {
+      return items_[index & (capacity - 1)].load(std::memory_order_relaxed);
+    }
+
+    void Store(int64_t index, T item) {
+      items_[index & (capacity - 1)].store(item, std::memory_order_relaxed);
+    }
+
+    const size_t capacity;
+
+   private:
+    std::unique_ptr<std::atomic<T>[]> items_;
+
+    DISALLOW_COPY_AND_ASSIGN(Buffer);
+  };
+
+  Buffer* Grow(Buffer* buffer, int64_t top, int64_t bottom) {
+    auto grown = std::make_unique<Buffer>(buffer->capacity * 2);
+    for (int64_t i = top; i < bottom; ++i)
+      grown->Store(i, buffer->Load(i));
+    buffers_.push_back(std::move(grown));
+    buffer_.store(buffers_.back().get(), std::memory_order_release);
+    return buffers_.back().get();
+  }
+
+  // Index of the next item to steal.
+  std::atomic<int64_t> top_{0};
+
+  // Index one past the bottom item. Only written by the owner.
+  std::atomic<int64_t> bottom_{0};
+
+  std::atomic<Buffer*> buffer_;
+
+  // All buffers allocated so far, the current one last. Only accessed by the
+  // owner.
+  std::vector<std::unique_ptr<Buffer>> buffers_;
+
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingDeque);
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_TASK_SCHEDULER_WORK_STEALING_DEQUE_H_
@@ -0,0 +1,567 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/task_scheduler/work_stealing_thread_pool.h"
+
+#include <limits>
+#include <utility>
+
+#include "base/logging.h"
+#include "base/no_destructor.h"
+#include "base/sequence_token.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/task_scheduler/work_stealing_deque.h"
+#include "base/threading/platform_thread.h"
+#include "base/threading/sequence_local_storage_map.h"
+#include "base/threading/sequenced_task_runner_handle.h"
+
+namespace base {
+
+namespace {
+
+constexpr int64_t kNoDelayedRunTime = std::numeric_limits<int64_t>::max();
+
+int64_t ToMicroseconds(TimeTicks time) {
+  return (time - TimeTicks()).InMicroseconds();
+}
+
+}  // namespace
+
+// The unit of scheduling. Holds the tasks of a SequencedTaskRunner, or a
+// single task of a parallel TaskRunner. It is scheduled (in a worker's deque,
+// the injection queue or held by a worker) iff it is non-empty, which makes
+// its tasks run one at a time.
+class WorkStealingThreadPool::Sequence
+    : public RefCountedThreadSafe<Sequence> {
+ public:
+  struct Task {
+    Task(PendingTask pending_task,
+         scoped_refptr<SequencedTaskRunner> sequenced_task_runner)
+        : pending_task(std::move(pending_task)),
+          sequenced_task_runner(std::move(sequenced_task_runner)) {}
+    Task(Task&& other) = default;
+    ~Task() = default;
+
+    Task& operator=(Task&& other) = default;
+
+    PendingTask pending_task;
+    scoped_refptr<SequencedTaskRunner> sequenced_task_runner;
+  };
+
+  Sequence() : token_(SequenceToken::Create()) {}
+
+  // Adds |task| to the sequence. Returns true if the sequence was empty, in
+  // which case the caller must schedule it.
+  bool PushTask(Task task) {
+    AutoLock auto_lock(lock_);
+    const bool was_empty = queue_.empty();
+    queue_.push(std::move(task));
+    return was_empty;
+  }
+
+  // Moves out the next task. The sequence remains non-empty (i.e. it doesn't
+  // get scheduled again by PushTask()) until DidRunTask().
+  Task TakeTask() {
+    AutoLock auto_lock(lock_);
+    DCHECK(!queue_.empty());
+    DCHECK(queue_.front().pending_task.task);
+    return std::move(queue_.front());
+  }
+
+  // Removes the task moved out by TakeTask(). Returns true if the sequence has
+  // more tasks, in which case the caller must keep it scheduled.
+  bool DidRunTask() {
+    AutoLock auto_lock(lock_);
+    DCHECK(!queue_.empty());
+    DCHECK(!queue_.front().pending_task.task);
+    queue_.pop();
+    return !queue_.empty();
+  }
+
+  // Deletes all tasks.
+  void Clear() {
+    base::queue<Task> queue;
+    {
+      AutoLock auto_lock(lock_);
+      std::swap(queue, queue_);
+    }
+    // |queue| is destroyed outside |lock_| since task destructors may post.
+  }
+
+  const SequenceToken& token() const { return token_; }
+
+  internal::SequenceLocalStorageMap* sequence_local_storage() {
+    return &sequence_local_storage_;
+  }
+
+ private:
+  friend class RefCountedThreadSafe<Sequence>;
+
+  ~Sequence() = default;
+
+  const SequenceToken token_;
+
+  // Only accessed by the worker running the sequence.
+  internal::SequenceLocalStorageMap sequence_local_storage_;
+
+  Lock lock_;
+  base::queue<Task> queue_;
+
+  DISALLOW_COPY_AND_ASSIGN(Sequence);
+};
+
+class WorkStealingThreadPool::Worker : public PlatformThread::Delegate {
+ public:
+  Worker(WorkStealingThreadPool* pool, int index)
+      : pool_(pool), index_(index), random_state_(index + 1) {}
+
+  ~Worker() override = default;
+
+  bool Start() {
+    return PlatformThread::Create(0, this, &thread_handle_);
+  }
+
+  void Join() { PlatformThread::Join(thread_handle_); }
+
+  // PlatformThread::Delegate:
+  void ThreadMain() override {
+    PlatformThread::SetName(pool_->thread_name_prefix_ + IntToString(index_));
+    GetCurrentWorkerTLS()->Set(this);
+
+    scoped_refptr<Sequence> sequence;
+    int tasks_run_from_sequence = 0;
+    for (;;) {
+      if (!sequence) {
+        sequence = pool_->GetWork(this);
+        if (!sequence)
+          break;
+        tasks_run_from_sequence = 0;
+      }
+
+      if (!pool_->RunNextTask(sequence.get())) {
+        sequence = nullptr;
+      } else if (++tasks_run_from_sequence == kMaxTasksPerSequenceRun ||
+                 pool_->shutdown_started_.load(std::memory_order_relaxed)) {
+        // Going through the injection queue, as opposed to this worker's
+        // deque, gives every other sequence a chance to run first.
+        pool_->PushToInjectionQueue(std::move(sequence));
+        pool_->WakeUpOneWorker();
+      }
+    }
+
+    GetCurrentWorkerTLS()->Set(nullptr);
+  }
+
+  WorkStealingThreadPool* pool() const { return pool_; }
+
+  // Holds one reference to each sequence in it.
+  internal::WorkStealingDeque<Sequence*>* deque() { return &deque_; }
+
+  // Returns the number of GetWork() calls made by this worker. Only called
+  // from the worker thread.
+  int IncrementGetWorkCount() { return ++get_work_count_; }
+
+  // Returns a pseudo-random number (xorshift32). Only called from the worker
+  // thread.
+  uint32_t NextRandom() {
+    random_state_ ^= random_state_ << 13;
+    random_state_ ^= random_state_ >> 17;
+    random_state_ ^= random_state_ << 5;
+    return random_state_;
+  }
+
+  int index() const { return index_; }
+
+ private:
+  WorkStealingThreadPool* const pool_;
+  const int index_;
+  PlatformThreadHandle thread_handle_;
+  internal::WorkStealingDeque<Sequence*> deque_;
+  int get_work_count_ = 0;
+  uint32_t random_state_;
+
+  DISALLOW_COPY_AND_ASSIGN(Worker);
+};
+
+class WorkStealingThreadPool::PooledTaskRunner : public TaskRunner {
+ public:
+  explicit PooledTaskRunner(scoped_refptr<WorkStealingThreadPool> pool)
+      : pool_(std::move(pool)) {}
+
+  // TaskRunner:
+  bool PostDelayedTask(const Location& from_here,
+                       OnceClosure task,
+                       TimeDelta delay) override {
+    return pool_->PostTaskToSequence(from_here, std::move(task), delay,
+                                     Nestable::kNestable,
+                                     MakeRefCounted<Sequence>(), nullptr);
+  }
+
+  bool RunsTasksInCurrentSequence() const override {
+    // Parallel tasks don't share a sequence, this is the closest equivalent.
+    Worker* worker = GetCurrentWorkerTLS()->Get();
+    return worker && worker->pool() == pool_.get();
+  }
+
+ private:
+  ~PooledTaskRunner() override = default;
+
+  const scoped_refptr<WorkStealingThreadPool> pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(PooledTaskRunner);
+};
+
+class WorkStealingThreadPool::PooledSequencedTaskRunner
+    : public SequencedTaskRunner {
+ public:
+  explicit PooledSequencedTaskRunner(scoped_refptr<WorkStealingThreadPool> pool)
+      : pool_(std::move(pool)), sequence_(MakeRefCounted<Sequence>()) {}
+
+  // SequencedTaskRunner:
+  bool PostDelayedTask(const Location& from_here,
+                       OnceClosure task,
+                       TimeDelta delay) override {
+    return pool_->PostTaskToSequence(from_here, std::move(task), delay,
+                                     Nestable::kNestable, sequence_, this);
+  }
+
+  bool PostNonNestableDelayedTask(const Location& from_here,
+                                  OnceClosure task,
+                                  TimeDelta delay) override {
+    // Tasks never run nested in the pool.
+    return pool_->PostTaskToSequence(from_here, std::move(task), delay,
+                                     Nestable::kNonNestable, sequence_, this);
+  }
+
+  bool RunsTasksInCurrentSequence() const override {
+    return sequence_->token() == SequenceToken::GetForCurrentThread();
+  }
+
+ private:
+  ~PooledSequencedTaskRunner() override = default;
+
+  const scoped_refptr<WorkStealingThreadPool> pool_;
+  const scoped_refptr<Sequence> sequence_;
+
+  DISALLOW_COPY_AND_ASSIGN(PooledSequencedTaskRunner);
+};
+
+WorkStealingThreadPool::DelayedTask::DelayedTask(
+    PendingTask pending_task,
+    scoped_refptr<Sequence> sequence,
+    scoped_refptr<SequencedTaskRunner> sequenced_task_runner)
+    : pending_task(std::move(pending_task)),
+      sequence(std::move(sequence)),
+      sequenced_task_runner(std::move(sequenced_task_runner)) {}
+
+WorkStealingThreadPool::DelayedTask::DelayedTask(DelayedTask&& other) = default;
+
+WorkStealingThreadPool::DelayedTask::~DelayedTask() = default;
+
+WorkStealingThreadPool::DelayedTask& WorkStealingThreadPool::DelayedTask::
+operator=(DelayedTask&& other) = default;
+
+WorkStealingThreadPool::WorkStealingThreadPool(
+    const std::string& thread_name_prefix)
+    : thread_name_prefix_(thread_name_prefix),
+      next_delayed_run_time_(kNoDelayedRunTime),
+      idle_cv_(&lock_) {}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+  DCHECK(workers_.empty() || shutdown_started_.load())
+      << "Shutdown() must be called before destroying a started pool.";
+}
+
+void WorkStealingThreadPool::Start(int num_workers) {
+  DCHECK_GT(num_workers, 0);
+  DCHECK(workers_.empty());
+  DCHECK(!shutdown_started_.load());
+
+  // All workers must exist before any of them starts stealing.
+  for (int i = 0; i < num_workers; ++i)
+    workers_.push_back(std::make_unique<Worker>(this, i));
+  for (auto& worker : workers_) {
+    if (!worker->Start())
+      NOTREACHED() << "Failed to start worker " << worker->index();
+  }
+}
+
+scoped_refptr<TaskRunner> WorkStealingThreadPool::CreateTaskRunner() {
+  return MakeRefCounted<PooledTaskRunner>(this);
+}
+
+scoped_refptr<SequencedTaskRunner>
+WorkStealingThreadPool::CreateSequencedTaskRunner() {
+  return MakeRefCounted<PooledSequencedTaskRunner>(this);
+}
+
+void WorkStealingThreadPool::Shutdown() {
+  Worker* current_worker = GetCurrentWorkerTLS()->Get();
+  DCHECK(!current_worker || current_worker->pool() != this)
+      << "Shutdown() can't be called from a worker.";
+
+  shutdown_started_.store(true);
+  {
+    AutoLock auto_lock(lock_);
+    idle_cv_.Broadcast();
+  }
+  for (auto& worker : workers_)
+    worker->Join();
+
+  // Delete the tasks that didn't run. Tasks posted from their destructors are
+  // rejected.
+  std::vector<scoped_refptr<Sequence>> sequences;
+  for (auto& worker : workers_) {
+    Sequence* raw_sequence;
+    while (worker->deque()->Pop(&raw_sequence)) {
+      sequences.emplace_back(raw_sequence);
+      raw_sequence->Release();
+    }
+  }
+  base::queue<scoped_refptr<Sequence>> injection_queue;
+  std::priority_queue<DelayedTask> delayed_tasks;
+  {
+    AutoLock auto_lock(lock_);
+    std::swap(injection_queue, injection_queue_);
+    std::swap(delayed_tasks, delayed_tasks_);
+    injection_queue_size_.store(0, std::memory_order_relaxed);
+    next_delayed_run_time_.store(kNoDelayedRunTime, std::memory_order_relaxed);
+  }
+  for (; !injection_queue.empty(); injection_queue.pop())
+    sequences.push_back(std::move(injection_queue.front()));
+  for (auto& sequence : sequences)
+    sequence->Clear();
+}
+
+// static
+ThreadLocalPointer<WorkStealingThreadPool::Worker>*
+WorkStealingThreadPool::GetCurrentWorkerTLS() {
+  static NoDestructor<ThreadLocalPointer<Worker>> current_worker_tls;
+  return current_worker_tls.get();
+}
+
+bool WorkStealingThreadPool::PostTaskToSequence(
+    const Location& from_here,
+    OnceClosure task,
+    TimeDelta delay,
+    Nestable nestable,
+    scoped_refptr<Sequence> sequence,
+    scoped_refptr<SequencedTaskRunner> sequenced_task_runner) {
+  CHECK(task);
+  if (shutdown_started_.load(std::memory_order_acquire))
+    return false;
+
+  TimeTicks delayed_run_time;
+  if (delay > TimeDelta())
+    delayed_run_time = TimeTicks::Now() + delay;
+  PendingTask pending_task(from_here, std::move(task), delayed_run_time,
+                           nestable);
+  task_annotator_.WillQueueTask("WorkStealingThreadPool::PostTask",
+                                &pending_task);
+
+  if (delayed_run_time.is_null()) {
+    PushTaskToSequence(std::move(pending_task), std::move(sequence),
+                       std::move(sequenced_task_runner));
+    return true;
+  }
+
+  pending_task.sequence_num =
+      next_sequence_num_.fetch_add(1, std::memory_order_relaxed);
+  AutoLock auto_lock(lock_);
+  delayed_tasks_.emplace(std::move(pending_task), std::move(sequence),
+                         std::move(sequenced_task_runner));
+  const int64_t next_delayed_run_time =
+      ToMicroseconds(delayed_tasks_.top().pending_task.delayed_run_time);
+  if (next_delayed_run_time !=
+      next_delayed_run_time_.load(std::memory_order_relaxed)) {
+    next_delayed_run_time_.store(next_delayed_run_time,
+                                 std::memory_order_relaxed);
+    // Lets a sleeping worker shorten its wait.
+    if (num_idle_workers_.load(std::memory_order_relaxed))
+      idle_cv_.Signal();
+  }
+  return true;
+}
+
+void WorkStealingThreadPool::PushTaskToSequence(
+    PendingTask pending_task,
+    scoped_refptr<Sequence> sequence,
+    scoped_refptr<SequencedTaskRunner> sequenced_task_runner) {
+  if (sequence->PushTask(Sequence::Task(std::move(pending_task),
+                                        std::move(sequenced_task_runner)))) {
+    ScheduleSequence(std::move(sequence));
+  }
+}
+
+void WorkStealingThreadPool::ScheduleSequence(
+    scoped_refptr<Sequence> sequence) {
+  Worker* worker = GetCurrentWorkerTLS()->Get();
+  if (worker && worker->pool() == this) {
+    // The deque holds a reference to the sequence.
+    Sequence* raw_sequence = sequence.get();
+    raw_sequence->AddRef();
+    sequence = nullptr;
+    worker->deque()->Push(raw_sequence);
+  } else {
+    PushToInjectionQueue(std::move(sequence));
+  }
+  WakeUpOneWorker();
+}
+
+void WorkStealingThreadPool::PushToInjectionQueue(
+    scoped_refptr<Sequence> sequence) {
+  AutoLock auto_lock(lock_);
+  injection_queue_.push(std::move(sequence));
+  injection_queue_size_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void WorkStealingThreadPool::WakeUpOneWorker() {
+  // Pairs with the fence in GetWork(): either this sees the worker going idle
+  // or the worker sees the work made available before this call.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!num_idle_workers_.load(std::memory_order_relaxed))
+    return;
+  AutoLock auto_lock(lock_);
+  idle_cv_.Signal();
+}
+
+scoped_refptr<WorkStealingThreadPool::Sequence> WorkStealingThreadPool::GetWork(
+    Worker* worker) {
+  for (;;) {
+    if (shutdown_started_.load(std::memory_order_acquire))
+      return nullptr;
+
+    ScheduleRipeDelayedTasks();
+
+    scoped_refptr<Sequence> sequence;
+    if (worker->IncrementGetWorkCount() % kInjectionQueueCheckInterval == 0)
+      sequence = PopFromInjectionQueue();
+    Sequence* raw_sequence;
+    if (!sequence && worker->deque()->Pop(&raw_sequence)) {
+      sequence = raw_sequence;
+      raw_sequence->Release();
+    }
+    if (!sequence)
+      sequence = PopFromInjectionQueue();
+    if (!sequence)
+      sequence = Steal(worker);
+    if (sequence)
+      return sequence;
+
+    AutoLock auto_lock(lock_);
+    num_idle_workers_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!shutdown_started_.load(std::memory_order_relaxed) &&
+        !HasWorkLockRequired()) {
+      if (delayed_tasks_.empty()) {
+        idle_cv_.Wait();
+      } else {
+        idle_cv_.TimedWait(delayed_tasks_.top().pending_task.delayed_run_time -
+                           TimeTicks::Now());
+      }
+    }
+    num_idle_workers_.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+scoped_refptr<WorkStealingThreadPool::Sequence>
+WorkStealingThreadPool::PopFromInjectionQueue() {
+  if (!injection_queue_size_.load(std::memory_order_relaxed))
+    return nullptr;
+  AutoLock auto_lock(lock_);
+  if (injection_queue_.empty())
+    return nullptr;
+  scoped_refptr<Sequence> sequence = std::move(injection_queue_.front());
+  injection_queue_.pop();
+  injection_queue_size_.fetch_sub(1, std::memory_order_relaxed);
+  return sequence;
+}
+
+scoped_refptr<WorkStealingThreadPool::Sequence> WorkStealingThreadPool::Steal(
+    Worker* thief) {
+  const int num_workers = static_cast<int>(workers_.size());
+  const int first_victim = static_cast<int>(thief->NextRandom() % num_workers);
+  for (int i = 0; i < num_workers; ++i) {
+    Worker* victim = workers_[(first_victim + i) % num_workers].get();
+    if (victim == thief)
+      continue;
+    Sequence* raw_sequence;
+    if (victim->deque()->Steal(&raw_sequence)) {
+      scoped_refptr<Sequence> sequence(raw_sequence);
+      raw_sequence->Release();
+      return sequence;
+    }
+  }
+  return nullptr;
+}
+
+bool WorkStealingThreadPool::HasWorkLockRequired() {
+  lock_.AssertAcquired();
+  if (!injection_queue_.empty())
+    return true;
+  if (!delayed_tasks_.empty() &&
+      delayed_tasks_.top().pending_task.delayed_run_time <= TimeTicks::Now()) {
+    return true;
+  }
+  for (auto& worker : workers_) {
+    if (!worker->deque()->IsEmpty())
+      return true;
+  }
+  return false;
+}
+
+void WorkStealingThreadPool::ScheduleRipeDelayedTasks() {
+  if (next_delayed_run_time_.load(std::memory_order_relaxed) ==
+      kNoDelayedRunTime) {
+    return;
+  }
+  const TimeTicks now = TimeTicks::Now();
+  if (ToMicroseconds(now) <
+      next_delayed_run_time_.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  std::vector<DelayedTask> ripe_tasks;
+  {
+    AutoLock auto_lock(lock_);
+    while (!delayed_tasks_.empty() &&
+           delayed_tasks_.top().pending_task.delayed_run_time <= now) {
+      ripe_tasks.push_back(
+          std::move(const_cast<DelayedTask&>(delayed_tasks_.top())));
+      delayed_tasks_.pop();
+    }
+    next_delayed_run_time_.store(
+        delayed_tasks_.empty()
+            ? kNoDelayedRunTime
+            : ToMicroseconds(delayed_tasks_.top().pending_task.delayed_run_time),
+        std::memory_order_relaxed);
+  }
+
+  for (DelayedTask& delayed_task : ripe_tasks) {
+    PushTaskToSequence(std::move(delayed_task.pending_task),
+                       std::move(delayed_task.sequence),
+                       std::move(delayed_task.sequenced_task_runner));
+  }
+}
+
+bool WorkStealingThreadPool::RunNextTask(Sequence* sequence) {
+  Sequence::Task task = sequence->TakeTask();
+  {
+    ScopedSetSequenceTokenForCurrentThread scoped_sequence_token(
+        sequence->token());
+    internal::ScopedSetSequenceLocalStorageMapForCurrentThread
+        scoped_sequence_local_storage(sequence->sequence_local_storage());
+    std::unique_ptr<SequencedTaskRunnerHandle> sequenced_task_runner_handle;
+    if (task.sequenced_task_runner) {
+      sequenced_task_runner_handle =
+          std::make_unique<SequencedTaskRunnerHandle>(
+              std::move(task.sequenced_task_runner));
+    }
+    task_annotator_.RunTask("WorkStealingThreadPool::PostTask",
+                            &task.pending_task);
+  }
+  return sequence->DidRunTask();
+}
+
+}  // namespace base
@@ -0,0 +1,206 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_TASK_SCHEDULER_WORK_STEALING_THREAD_POOL_H_
+#define BASE_TASK_SCHEDULER_WORK_STEALING_THREAD_POOL_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/containers/queue.h"
+#include "base/debug/task_annotator.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/pending_task.h"
+#include "base/sequenced_task_runner.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/task_runner.h"
+#include "base/threading/thread_local.h"
+#include "base/time/time.h"
+
+namespace base {
+
+// A pool of worker threads running the tasks posted to the TaskRunners and
+// SequencedTaskRunners it creates.
+//
+// Tasks are grouped in sequences: each SequencedTaskRunner feeds one sequence
+// and each task posted to a parallel TaskRunner gets a sequence of its own. A
+// sequence is scheduled while it has tasks and runs one task at a time, in
+// posting order, on whichever worker picked it up; between two tasks it may
+// migrate to another worker. Tasks run with the sequence's SequenceToken,
+// SequenceLocalStorageMap and (for SequencedTaskRunners)
+// SequencedTaskRunnerHandle set, so that sequence-affine code works as it does
+// on a MessageLoop.
+//
+// Each worker schedules sequences on its own work-stealing deque; sequences
+// made ready from outside the pool go through a global injection queue. Idle
+// workers steal from the top of other workers' deques before going to sleep.
+//
+// Typical usage:
+//   scoped_refptr<WorkStealingThreadPool> pool =
+//       MakeRefCounted<WorkStealingThreadPool>("Worker");
+//   pool->Start(4);
+//   pool->CreateSequencedTaskRunner()->PostTask(FROM_HERE, ...);
+//   ...
+//   pool->Shutdown();
+class BASE_EXPORT WorkStealingThreadPool
+    : public RefCountedThreadSafe<WorkStealingThreadPool> {
+ public:
+  // Worker threads are named |thread_name_prefix| followed by their index.
+  explicit WorkStealingThreadPool(const std::string& thread_name_prefix);
+
+  // Starts |num_workers| worker threads. Tasks posted before Start() are
+  // scheduled once it is called. Must be called at most once.
+  void Start(int num_workers);
+
+  // Returns a TaskRunner whose tasks may run in parallel, in any order.
+  scoped_refptr<TaskRunner> CreateTaskRunner();
+
+  // Returns a SequencedTaskRunner whose tasks run one at a time, in posting
+  // order.
+  scoped_refptr<SequencedTaskRunner> CreateSequencedTaskRunner();
+
+  // Stops accepting tasks, waits for the tasks currently running to complete,
+  // joins the workers and deletes the tasks that didn't run. Must be called
+  // before the last reference to the pool goes away (TaskRunners keep the pool
+  // alive), and not from a worker.
+  void Shutdown();
+
+ private:
+  friend class RefCountedThreadSafe<WorkStealingThreadPool>;
+
+  class Sequence;
+  class Worker;
+  class PooledTaskRunner;
+  class PooledSequencedTaskRunner;
+
+  // A delayed task waiting for its run time before being pushed to its
+  // sequence.
+  struct DelayedTask {
+    DelayedTask(PendingTask pending_task,
+                scoped_refptr<Sequence> sequence,
+                scoped_refptr<SequencedTaskRunner> sequenced_task_runner);
+    DelayedTask(DelayedTask&& other);
+    ~DelayedTask();
+
+    DelayedTask& operator=(DelayedTask&& other);
+
+    // Inverted like PendingTask::operator< for std::priority_queue.
+    bool operator<(const DelayedTask& other) const {
+      return pending_task < other.pending_task;
+    }
+
+    PendingTask pending_task;
+    scoped_refptr<Sequence> sequence;
+    scoped_refptr<SequencedTaskRunner> sequenced_task_runner;
+  };
+
+  // Workers look at the injection queue before their own deque every this many
+  // sequences, so that external posts aren't starved by busy workers.
+  static constexpr int kInjectionQueueCheckInterval = 61;
+
+  // A worker runs up to this many tasks in a row from a sequence before
+  // sending it to the back of the injection queue, so that a sequence which
+  // keeps posting to itself doesn't starve the others.
+  static constexpr int kMaxTasksPerSequenceRun = 32;
+
+  // Returns the worker running on the current thread, if any.
+  static ThreadLocalPointer<Worker>* GetCurrentWorkerTLS();
+
+  ~WorkStealingThreadPool();
+
+  // Posts |task| to |sequence|. |sequenced_task_runner| is set as the
+  // SequencedTaskRunnerHandle while the task runs, if non-null.
+  bool PostTaskToSequence(
+      const Location& from_here,
+      OnceClosure task,
+      TimeDelta delay,
+      Nestable nestable,
+      scoped_refptr<Sequence> sequence,
+      scoped_refptr<SequencedTaskRunner> sequenced_task_runner);
+
+  // Pushes |pending_task| to |sequence| and schedules the sequence if it was
+  // empty.
+  void PushTaskToSequence(
+      PendingTask pending_task,
+      scoped_refptr<Sequence> sequence,
+      scoped_refptr<SequencedTaskRunner> sequenced_task_runner);
+
+  // Makes |sequence| available to the workers: on the current worker's deque
+  // if called from a worker of this pool, on the injection queue otherwise.
+  void ScheduleSequence(scoped_refptr<Sequence> sequence);
+
+  void PushToInjectionQueue(scoped_refptr<Sequence> sequence);
+
+  // Wakes up a sleeping worker, if any. Called after making work available.
+  void WakeUpOneWorker();
+
+  // Returns the next sequence for |worker| to run a task from, sleeping until
+  // there is one. Returns null once the pool is shutting down.
+  scoped_refptr<Sequence> GetWork(Worker* worker);
+
+  // Returns a sequence from the injection queue, or null.
+  scoped_refptr<Sequence> PopFromInjectionQueue();
+
+  // Returns a sequence stolen from a worker other than |thief|, or null.
+  scoped_refptr<Sequence> Steal(Worker* thief);
+
+  // Returns true if work is available to a worker looking for some.
+  bool HasWorkLockRequired();
+
+  // Moves the delayed tasks that are due to their sequences.
+  void ScheduleRipeDelayedTasks();
+
+  // Runs the next task of |sequence|. Returns true if |sequence| has more
+  // tasks, in which case it is up to the caller to run or reschedule it.
+  bool RunNextTask(Sequence* sequence);
+
+  const std::string thread_name_prefix_;
+
+  // Set when Shutdown() starts. Tasks are rejected from then on.
+  std::atomic<bool> shutdown_started_{false};
+
+  // The workers. Only modified in Start() and Shutdown(), read without
+  // synchronization by the workers themselves in between.
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  // Used to order delayed tasks with the same run time.
+  std::atomic<int> next_sequence_num_{0};
+
+  // Number of sequences in |injection_queue_|, readable without |lock_|.
+  std::atomic<int> injection_queue_size_{0};
+
+  // Number of workers waiting on |idle_cv_|.
+  std::atomic<int> num_idle_workers_{0};
+
+  // The run time of the first task in |delayed_tasks_| in microseconds since
+  // TimeTicks(), readable without |lock_|. INT64_MAX if there are none.
+  std::atomic<int64_t> next_delayed_run_time_;
+
+  debug::TaskAnnotator task_annotator_;
+
+  // Synchronizes access to all members below this line.
+  Lock lock_;
+
+  // Signaled to wake up idle workers.
+  ConditionVariable idle_cv_;
+
+  // Sequences made ready from outside the pool.
+  base::queue<scoped_refptr<Sequence>> injection_queue_;
+
+  std::priority_queue<DelayedTask> delayed_tasks_;
+
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingThreadPool);
+};
+
+}  // namespace base
+
+#endif  // BASE_TASK_SCHEDULER_WORK_STEALING_THREAD_POOL_H_
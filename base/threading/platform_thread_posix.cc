@@ -190,7 +190,8 @@ void PlatformThread::Sleep(TimeDelta duration) {
 
 // static
 const char* PlatformThread::GetName() {
-  return ThreadIdNameManager::GetInstance()->GetName(CurrentId());
+  // The name is cached in TLS: logging calls this for every message.
+  return ThreadIdNameManager::GetInstance()->GetNameForCurrentThread();
 }
 
 // static
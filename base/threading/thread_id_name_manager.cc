@@ -7,6 +7,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+
 #include "base/logging.h"
 #include "base/memory/singleton.h"
 #include "base/no_destructor.h"
@@ -21,18 +23,30 @@ namespace {
 static const char kDefaultName[] = "";
 static std::string* g_default_name;
 
+// Enough for the threads of most processes without replacing the table.
+constexpr size_t kInitialThreadTableCapacity = 64;
+
 ThreadLocalStorage::Slot& GetThreadNameTLS() {
   static base::NoDestructor<base::ThreadLocalStorage::Slot> thread_name_tls;
   return *thread_name_tls;
 }
 }
 
+ThreadIdNameManager::ThreadTable::ThreadTable(size_t capacity)
+    : capacity(capacity), entries(new SeqLock<ThreadEntry>[capacity]) {
+  DCHECK_EQ(capacity & (capacity - 1), 0u);
+}
+
+ThreadIdNameManager::ThreadTable::~ThreadTable() = default;
+
 ThreadIdNameManager::ThreadIdNameManager()
     : main_process_name_(nullptr), main_process_id_(kInvalidThreadId) {
   g_default_name = new std::string(kDefaultName);
 
   AutoLock locked(lock_);
   name_to_interned_name_[kDefaultName] = g_default_name;
+  current_table_ = std::make_unique<ThreadTable>(kInitialThreadTableCapacity);
+  thread_table_.store(current_table_.get(), std::memory_order_release);
 }
 
 ThreadIdNameManager::~ThreadIdNameManager() = default;
@@ -49,9 +63,7 @@ const char* ThreadIdNameManager::GetDefaultInternedString() {
 void ThreadIdNameManager::RegisterThread(PlatformThreadHandle::Handle handle,
                                          PlatformThreadId id) {
   AutoLock locked(lock_);
-  thread_id_to_handle_[id] = handle;
-  thread_handle_to_interned_name_[handle] =
-      name_to_interned_name_[kDefaultName];
+  SetEntryLockRequired({id, handle, g_default_name});
 }
 
 void ThreadIdNameManager::InstallSetNameCallback(SetNameCallback callback) {
@@ -72,8 +84,8 @@ void ThreadIdNameManager::SetName(const std::string& name) {
       name_to_interned_name_[name] = leaked_str;
     }
 
-    ThreadIdToHandleMap::iterator id_to_handle_iter =
-        thread_id_to_handle_.find(id);
+    const ThreadTable* table = current_table_.get();
+    ThreadEntry entry = table->entries[FindEntry(*table, id)].Read();
 
     GetThreadNameTLS().Set(const_cast<char*>(leaked_str->c_str()));
     if (set_name_callback_) {
@@ -82,12 +94,14 @@ void ThreadIdNameManager::SetName(const std::string& name) {
 
     // The main thread of a process will not be created as a Thread object which
     // means there is no PlatformThreadHandler registered.
-    if (id_to_handle_iter == thread_id_to_handle_.end()) {
-      main_process_name_ = leaked_str;
-      main_process_id_ = id;
+    if (entry.id != id || !entry.name) {
+      main_process_name_.store(leaked_str, std::memory_order_relaxed);
+      // Publishes |main_process_name_| to GetName().
+      main_process_id_.store(id, std::memory_order_release);
       return;
     }
-    thread_handle_to_interned_name_[id_to_handle_iter->second] = leaked_str;
+    entry.name = leaked_str;
+    SetEntryLockRequired(entry);
   }
 
   // Add the leaked thread name to heap profiler context tracker. The name added
@@ -101,19 +115,29 @@ void ThreadIdNameManager::SetName(const std::string& name) {
 }
 
 const char* ThreadIdNameManager::GetName(PlatformThreadId id) {
-  AutoLock locked(lock_);
-
-  if (id == main_process_id_)
-    return main_process_name_->c_str();
-
-  ThreadIdToHandleMap::iterator id_to_handle_iter =
-      thread_id_to_handle_.find(id);
-  if (id_to_handle_iter == thread_id_to_handle_.end())
-    return name_to_interned_name_[kDefaultName]->c_str();
+  if (id == main_process_id_.load(std::memory_order_acquire))
+    return main_process_name_.load(std::memory_order_relaxed)->c_str();
+
+  // Keep the table from being deleted while reading it. Either the check of
+  // |thread_table_| sees a replacement, or the writer which replaced it sees
+  // this reader.
+  const ThreadTable* table = thread_table_.load(std::memory_order_acquire);
+  for (;;) {
+    table->num_readers.fetch_add(1);
+    const ThreadTable* current_table = thread_table_.load();
+    if (current_table == table)
+      break;
+    table->num_readers.fetch_sub(1, std::memory_order_release);
+    table = current_table;
+  }
 
-  ThreadHandleToInternedNameMap::iterator handle_to_name_iter =
-      thread_handle_to_interned_name_.find(id_to_handle_iter->second);
-  return handle_to_name_iter->second->c_str();
+  // Lookups racing with a change of the entry of |id| see the old or the new
+  // name, as they would have before or after taking a lock.
+  const ThreadEntry entry = table->entries[FindEntry(*table, id)].Read();
+  table->num_readers.fetch_sub(1, std::memory_order_release);
+  if (entry.id != id || !entry.name)
+    return g_default_name->c_str();
+  return entry.name->c_str();
 }
 
 const char* ThreadIdNameManager::GetNameForCurrentThread() {
@@ -124,21 +148,106 @@ const char* ThreadIdNameManager::GetNameForCurrentThread() {
 void ThreadIdNameManager::RemoveName(PlatformThreadHandle::Handle handle,
                                      PlatformThreadId id) {
   AutoLock locked(lock_);
-  ThreadHandleToInternedNameMap::iterator handle_to_name_iter =
-      thread_handle_to_interned_name_.find(handle);
-
-  DCHECK(handle_to_name_iter != thread_handle_to_interned_name_.end());
-  thread_handle_to_interned_name_.erase(handle_to_name_iter);
-
-  ThreadIdToHandleMap::iterator id_to_handle_iter =
-      thread_id_to_handle_.find(id);
-  DCHECK((id_to_handle_iter!= thread_id_to_handle_.end()));
+  const ThreadTable* table = current_table_.get();
+  ThreadEntry entry = table->entries[FindEntry(*table, id)].Read();
+  DCHECK(entry.id == id && entry.name);
   // The given |id| may have been re-used by the system. Make sure the
   // mapping points to the provided |handle| before removal.
-  if (id_to_handle_iter->second != handle)
+  if (entry.handle != handle)
     return;
 
-  thread_id_to_handle_.erase(id_to_handle_iter);
+  entry.name = nullptr;
+  SetEntryLockRequired(entry);
+}
+
+// static
+size_t ThreadIdNameManager::FindEntry(const ThreadTable& table,
+                                      PlatformThreadId id) {
+  DCHECK_NE(id, kInvalidThreadId);
+  const size_t mask = table.capacity - 1;
+  // Fibonacci hashing spreads consecutive ids.
+  size_t index = (static_cast<uint32_t>(id) * 2654435761u) & mask;
+  // Tombstones of other ids can be reused if |id| isn't further along.
+  size_t first_tombstone = table.capacity;
+  for (size_t probes = 0; probes < table.capacity; ++probes) {
+    const ThreadEntry entry = table.entries[index].Read();
+    if (entry.id == id || entry.id == kInvalidThreadId)
+      return entry.id == id || first_tombstone == table.capacity
+                 ? index
+                 : first_tombstone;
+    if (!entry.name && first_tombstone == table.capacity)
+      first_tombstone = index;
+    index = (index + 1) & mask;
+  }
+  // Tables are kept at most three quarters full.
+  NOTREACHED();
+  return first_tombstone;
+}
+
+void ThreadIdNameManager::SetEntryLockRequired(const ThreadEntry& entry) {
+  DeleteRetiredTablesLockRequired();
+
+  ThreadTable* table = current_table_.get();
+  size_t index = FindEntry(*table, entry.id);
+  ThreadEntry old_entry = table->entries[index].Read();
+
+  const bool adds_entry = old_entry.id == kInvalidThreadId;
+  if (adds_entry && (table->num_used + 1) * 4 > table->capacity * 3) {
+    // Keep the new table at most half full, dropping the tombstones.
+    size_t capacity = kInitialThreadTableCapacity;
+    while ((table->num_live + 1) * 2 > capacity)
+      capacity *= 2;
+    std::unique_ptr<ThreadTable> new_table =
+        std::make_unique<ThreadTable>(capacity);
+    for (size_t i = 0; i < table->capacity; ++i) {
+      const ThreadEntry live_entry = table->entries[i].Read();
+      if (live_entry.id == kInvalidThreadId || !live_entry.name)
+        continue;
+      new_table->entries[FindEntry(*new_table, live_entry.id)].Write(
+          live_entry);
+      ++new_table->num_used;
+      ++new_table->num_live;
+    }
+    table = new_table.get();
+    thread_table_.store(table);
+    retired_tables_.push_back(std::move(current_table_));
+    current_table_ = std::move(new_table);
+
+    index = FindEntry(*table, entry.id);
+    old_entry = table->entries[index].Read();
+  }
+
+  if (old_entry.id == kInvalidThreadId)
+    ++table->num_used;
+  if (old_entry.id == entry.id && old_entry.name)
+    --table->num_live;
+  if (entry.name)
+    ++table->num_live;
+  table->entries[index].Write(entry);
+
+  // A tombstone followed by an empty entry is in no probe sequence, nor are
+  // the tombstones right before it: empty them for later insertions.
+  const size_t mask = table->capacity - 1;
+  while (!entry.name &&
+         table->entries[(index + 1) & mask].Read().id == kInvalidThreadId) {
+    const ThreadEntry tombstone = table->entries[index].Read();
+    if (tombstone.id == kInvalidThreadId || tombstone.name)
+      break;
+    table->entries[index].Write(ThreadEntry());
+    --table->num_used;
+    index = (index - 1) & mask;
+  }
+}
+
+void ThreadIdNameManager::DeleteRetiredTablesLockRequired() {
+  // Pairs with the check of |thread_table_| in GetName(): readers counted
+  // after this may only read the current table.
+  retired_tables_.erase(
+      std::remove_if(retired_tables_.begin(), retired_tables_.end(),
+                     [](const std::unique_ptr<ThreadTable>& table) {
+                       return !table->num_readers.load();
+                     }),
+      retired_tables_.end());
 }
 
 }  // namespace base
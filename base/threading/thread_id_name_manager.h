@@ -5,13 +5,19 @@
 #ifndef BASE_THREADING_THREAD_ID_NAME_MANAGER_H_
 #define BASE_THREADING_THREAD_ID_NAME_MANAGER_H_
 
-#include <map>
+#include <stddef.h>
+
+#include <atomic>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "base/base_export.h"
 #include "base/callback.h"
+#include "base/containers/flat_map.h"
 #include "base/macros.h"
 #include "base/synchronization/lock.h"
+#include "base/synchronization/seq_lock.h"
 #include "base/threading/platform_thread.h"
 
 namespace base {
@@ -37,10 +43,10 @@ class BASE_EXPORT ThreadIdNameManager {
   // Set the name for the current thread.
   void SetName(const std::string& name);
 
-  // Get the name for the given id.
+  // Get the name for the given id. Doesn't take |lock_|.
   const char* GetName(PlatformThreadId id);
 
-  // Unlike |GetName|, this method using TLS and avoids touching |lock_|.
+  // Unlike |GetName|, this method using TLS and avoids looking the id up.
   const char* GetNameForCurrentThread();
 
   // Remove the name for the given id.
@@ -49,26 +55,61 @@ class BASE_EXPORT ThreadIdNameManager {
  private:
   friend struct DefaultSingletonTraits<ThreadIdNameManager>;
 
-  typedef std::map<PlatformThreadId, PlatformThreadHandle::Handle>
-      ThreadIdToHandleMap;
-  typedef std::map<PlatformThreadHandle::Handle, std::string*>
-      ThreadHandleToInternedNameMap;
-  typedef std::map<std::string, std::string*> NameToInternedNameMap;
+  typedef base::flat_map<std::string, std::string*> NameToInternedNameMap;
+
+  // A registered thread. |name| is null once the thread is removed: the
+  // entry stays as a tombstone until the table is replaced.
+  struct ThreadEntry {
+    PlatformThreadId id;
+    PlatformThreadHandle::Handle handle;
+    const std::string* name;
+  };
+
+  // Open-addressed table of the registered threads by id, probed linearly.
+  // GetName() reads it without |lock_|, so entries are updated in place and a
+  // full table is replaced rather than resized. A replaced table is deleted
+  // once no GetName() reads it anymore.
+  struct ThreadTable {
+    explicit ThreadTable(size_t capacity);
+    ~ThreadTable();
+
+    // A power of two.
+    const size_t capacity;
+    std::unique_ptr<SeqLock<ThreadEntry>[]> entries;
+    // Entries with an id, tombstones included.
+    size_t num_used = 0;
+    size_t num_live = 0;
+    // Number of GetName() calls reading the table.
+    mutable std::atomic<int> num_readers{0};
+  };
 
   ThreadIdNameManager();
   ~ThreadIdNameManager();
 
-  // lock_ protects the name_to_interned_name_, thread_id_to_handle_ and
-  // thread_handle_to_interned_name_ maps.
+  // Returns the index in |table| of the entry of |id|, or of the entry to
+  // store it in if |table| has none.
+  static size_t FindEntry(const ThreadTable& table, PlatformThreadId id);
+
+  // Stores |entry| in the table, replacing the table first if it is full.
+  void SetEntryLockRequired(const ThreadEntry& entry);
+
+  // Deletes the replaced tables which GetName() no longer reads.
+  void DeleteRetiredTablesLockRequired();
+
+  // lock_ protects the name_to_interned_name_ map and all the writes.
   Lock lock_;
 
   NameToInternedNameMap name_to_interned_name_;
-  ThreadIdToHandleMap thread_id_to_handle_;
-  ThreadHandleToInternedNameMap thread_handle_to_interned_name_;
+
+  // The current table of the registered threads, owned by |current_table_|.
+  std::atomic<const ThreadTable*> thread_table_;
+  std::unique_ptr<ThreadTable> current_table_;
+  // Replaced tables which GetName() may still read.
+  std::vector<std::unique_ptr<ThreadTable>> retired_tables_;
 
   // Treat the main process specially as there is no PlatformThreadHandle.
-  std::string* main_process_name_;
-  PlatformThreadId main_process_id_;
+  std::atomic<const std::string*> main_process_name_;
+  std::atomic<PlatformThreadId> main_process_id_;
 
   SetNameCallback set_name_callback_;
 
@@ -7,6 +7,7 @@
 #include <string.h>
 
 #include "base/check_op.h"
+#include "base/compiler_specific.h"
 #include "base/notreached.h"
 #include "base/atomicops.h"
 
@@ -53,6 +54,36 @@ const int kMaxDestructorIterations = kThreadLocalStorageSize;
 volatile base::ThreadLocalStorage::TLSDestructorFunc
     g_tls_destructors[kThreadLocalStorageSize];
 
+// On Linux, the pointer to the table of the current thread is also kept in a
+// compiler thread_local variable, so that StaticSlot::Get() and Set() are a
+// load from a fixed offset of the thread pointer rather than a call to
+// pthread_getspecific(). The native TLS slot is still used, as its destructor
+// runs OnThreadExitInternal(). Initial-exec TLS can't be used by libraries
+// loaded with dlopen(), hence not in component builds.
+#if defined(OS_LINUX) && !defined(COMPONENT_BUILD)
+#define TLS_VECTOR_IN_STATIC_TLS
+thread_local void** g_tls_vector __attribute__((tls_model("initial-exec"))) =
+    nullptr;
+#endif
+
+// Returns the table of the current thread, or null if it has none yet.
+ALWAYS_INLINE void** GetTlsVector() {
+#if defined(TLS_VECTOR_IN_STATIC_TLS)
+  return g_tls_vector;
+#else
+  return static_cast<void**>(PlatformThreadLocalStorage::GetTLSValue(
+      base::subtle::NoBarrier_Load(&g_native_tls_key)));
+#endif
+}
+
+// Makes |tls_data| the table of the current thread.
+void SetTlsVector(PlatformThreadLocalStorage::TLSKey key, void** tls_data) {
+  PlatformThreadLocalStorage::SetTLSValue(key, tls_data);
+#if defined(TLS_VECTOR_IN_STATIC_TLS)
+  g_tls_vector = tls_data;
+#endif
+}
+
 // This function is called to initialize our entire Chromium TLS system.
 // It may be called very early, and we need to complete most all of the setup
 // (initialization) before calling *any* memory allocator functions, which may
@@ -103,12 +134,12 @@ void** ConstructTlsVector() {
   void* stack_allocated_tls_data[kThreadLocalStorageSize];
   memset(stack_allocated_tls_data, 0, sizeof(stack_allocated_tls_data));
   // Ensure that any rentrant calls change the temp version.
-  PlatformThreadLocalStorage::SetTLSValue(key, stack_allocated_tls_data);
+  SetTlsVector(key, stack_allocated_tls_data);
 
   // Allocate an array to store our data.
   void** tls_data = new void*[kThreadLocalStorageSize];
   memcpy(tls_data, stack_allocated_tls_data, sizeof(stack_allocated_tls_data));
-  PlatformThreadLocalStorage::SetTLSValue(key, tls_data);
+  SetTlsVector(key, tls_data);
   return tls_data;
 }
 
@@ -129,7 +160,7 @@ void OnThreadExitInternal(void* value) {
   // Ensure that any re-entrant calls change the temp version.
   PlatformThreadLocalStorage::TLSKey key =
       base::subtle::NoBarrier_Load(&g_native_tls_key);
-  PlatformThreadLocalStorage::SetTLSValue(key, stack_allocated_tls_data);
+  SetTlsVector(key, stack_allocated_tls_data);
   delete[] tls_data;  // Our last dependence on an allocator.
 
   int remaining_attempts = kMaxDestructorIterations;
@@ -167,7 +198,7 @@ void OnThreadExitInternal(void* value) {
   }
 
   // Remove our stack allocated vector.
-  PlatformThreadLocalStorage::SetTLSValue(key, NULL);
+  SetTlsVector(key, NULL);
 }
 
 }  // namespace
@@ -230,10 +261,8 @@ void ThreadLocalStorage::StaticSlot::Free() {
 }
 
 void* ThreadLocalStorage::StaticSlot::Get() const {
-  void** tls_data = static_cast<void**>(
-      PlatformThreadLocalStorage::GetTLSValue(
-          base::subtle::NoBarrier_Load(&g_native_tls_key)));
-  if (!tls_data)
+  void** tls_data = GetTlsVector();
+  if (UNLIKELY(!tls_data))
     tls_data = ConstructTlsVector();
   DCHECK_GT(slot_, 0);
   DCHECK_LT(slot_, kThreadLocalStorageSize);
@@ -241,10 +270,8 @@ void* ThreadLocalStorage::StaticSlot::Get() const {
 }
 
 void ThreadLocalStorage::StaticSlot::Set(void* value) {
-  void** tls_data = static_cast<void**>(
-      PlatformThreadLocalStorage::GetTLSValue(
-          base::subtle::NoBarrier_Load(&g_native_tls_key)));
-  if (!tls_data)
+  void** tls_data = GetTlsVector();
+  if (UNLIKELY(!tls_data))
     tls_data = ConstructTlsVector();
   DCHECK_GT(slot_, 0);
   DCHECK_LT(slot_, kThreadLocalStorageSize);